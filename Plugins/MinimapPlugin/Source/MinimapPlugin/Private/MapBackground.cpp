@@ -3,6 +3,7 @@
 #include "MapBackground.h"
 #include "MinimapPluginPrivatePCH.h"
 #include "MapTrackerComponent.h"
+#include "MapTrackerSubsystem.h"
 #include "MapViewComponent.h"
 #include "MapFunctionLibrary.h"
 
@@ -110,13 +111,22 @@ void AMapBackground::BeginPlay()
 	// Precompute some background related values and take a snapshot if required
 	ApplyBackgroundTexture();
 	
-	// Register self to tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
-		Tracker->RegisterMapBackground(this);
-
 	// Initialize animation start time
 	AnimStartTime = GetWorld()->GetTimeSeconds();
+
+	// Register self to tracker, which waits for the GameState if it doesn't exist yet
+	if (UMapTrackerSubsystem* Subsystem = GetWorld()->GetSubsystem<UMapTrackerSubsystem>())
+		Subsystem->CallWhenMapTrackerReady(FMapTrackerReadyDelegate::CreateUObject(this, &AMapBackground::RegisterWithMapTracker));
+}
+
+void AMapBackground::RegisterWithMapTracker(UMapTrackerComponent* Tracker)
+{
+	// Also called from BeginPlay itself, before the actor counts as having begun play
+	if ((!HasActorBegunPlay() && !IsActorBeginningPlay()) || IsActorBeingDestroyed() || MapTracker == Tracker)
+		return;
+
+	TrackerHandle = Tracker->RegisterMapBackground(this);
+	MapTracker = Tracker;
 }
 
 void AMapBackground::EndPlay(const EEndPlayReason::Type EndPlayReason)
@@ -127,9 +137,10 @@ void AMapBackground::EndPlay(const EEndPlayReason::Type EndPlayReason)
 		return;
 	
 	// Unregister self from tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
-		Tracker->UnregisterMapBackground(this);
+	if (MapTracker)
+		MapTracker->UnregisterMapBackground(TrackerHandle);
+	MapTracker = nullptr;
+	TrackerHandle = FMapRegistryHandle();
 }
 
 void AMapBackground::SetBackgroundMaterialForUMG(UMaterialInterface* NewMaterial)
@@ -205,6 +216,8 @@ int32 AMapBackground::GetBackgroundPriority() const
 void AMapBackground::SetBackgroundZOrder(const int32 NewBackgroundZOrder)
 {
 	BackgroundZOrder = NewBackgroundZOrder;
+	if (MapTracker)
+		MapTracker->MarkMapBackgroundDrawOrderDirty();
 	OnMapBackgroundAppearanceChanged.Broadcast(this);
 }
 
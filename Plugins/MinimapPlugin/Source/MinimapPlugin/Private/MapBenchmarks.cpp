@@ -0,0 +1,367 @@
+// Journeyman's Minimap by ZKShao.
+
+// Console commands that measure the cost of the plugin's data structures on synthetic data.
+// They don't require a world, so they can be run from any build with the console enabled.
+
+#include "MinimapPluginPrivatePCH.h"
+#include "MapSpatialHash.h"
+#include "MapIconCulling.h"
+#include "MapIconRenderCache.h"
+#include "MapFogGrid.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+
+#if !UE_BUILD_SHIPPING
+
+namespace MinimapBenchmarks
+{
+	// Runs Body Iterations times and returns the average duration of a single run in microseconds
+	template<typename BodyType>
+	static double TimeMicroseconds(const int32 Iterations, BodyType Body)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; ++i)
+			Body();
+		return (FPlatformTime::Seconds() - StartTime) * 1000000.0 / Iterations;
+	}
+
+	// Compares a linear scan over all icons against a spatial grid query, for a growing total
+	// icon count while the number of icons inside the view stays constant.
+	static void BenchmarkIconGrid(const TArray<FString>& Args)
+	{
+		const int32 VisibleCount = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 500;
+		const float CellSize = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 4096.0f;
+		const float WorldExtent = 200000.0f;
+		const FVector2D ViewExtent(5000.0f, 5000.0f);
+		const FVector2D ViewCenter(0.0f, 0.0f);
+		const int32 Iterations = 200;
+		const int32 TotalCounts[] = { 1000, 5000, 20000, 80000 };
+
+		UE_LOG(MinimapLog, Display, TEXT("Icon grid benchmark: %d icons in view, cell size %.0f"), VisibleCount, CellSize);
+		for (const int32 TotalCount : TotalCounts)
+		{
+			// Place VisibleCount icons inside the view and scatter the rest outside of it
+			FRandomStream Random(TotalCount);
+			TArray<FVector2D> Positions;
+			Positions.Reserve(TotalCount);
+			for (int32 i = 0; i < TotalCount; ++i)
+			{
+				if (i < VisibleCount)
+				{
+					Positions.Add(ViewCenter + FVector2D(Random.FRandRange(-ViewExtent.X, ViewExtent.X), Random.FRandRange(-ViewExtent.Y, ViewExtent.Y)));
+					continue;
+				}
+				FVector2D Position;
+				do
+				{
+					Position = FVector2D(Random.FRandRange(-WorldExtent, WorldExtent), Random.FRandRange(-WorldExtent, WorldExtent));
+				} while (FMath::Abs(Position.X - ViewCenter.X) < 2.0f * ViewExtent.X && FMath::Abs(Position.Y - ViewCenter.Y) < 2.0f * ViewExtent.Y);
+				Positions.Add(Position);
+			}
+
+			TMapSpatialHash<int32> Grid(CellSize);
+			for (int32 i = 0; i < TotalCount; ++i)
+				Grid.Add(i, Positions[i]);
+
+			// Linear scan using the same broad circle test as UMapViewComponent::ViewContains
+			int32 LinearFound = 0;
+			const float ViewRadiusSquared = ViewExtent.SizeSquared();
+			const double LinearTime = TimeMicroseconds(Iterations, [&]()
+			{
+				LinearFound = 0;
+				for (const FVector2D& Position : Positions)
+					if (FVector2D::DistSquared(Position, ViewCenter) < ViewRadiusSquared)
+						++LinearFound;
+			});
+
+			// Grid query followed by the same exact test on the candidates only
+			int32 GridFound = 0;
+			TArray<int32> Candidates;
+			const double GridTime = TimeMicroseconds(Iterations, [&]()
+			{
+				Candidates.Reset();
+				Grid.QueryBox(ViewCenter, FVector2D(1, 0), FVector2D(0, 1), ViewExtent, Candidates);
+				GridFound = 0;
+				for (const int32 Candidate : Candidates)
+					if (FVector2D::DistSquared(Positions[Candidate], ViewCenter) < ViewRadiusSquared)
+						++GridFound;
+			});
+
+			UE_LOG(MinimapLog, Display, TEXT("  %6d icons: linear %8.1f us (%d found), grid %8.1f us (%d candidates, %d found)"),
+				TotalCount, LinearTime, LinearFound, GridTime, Candidates.Num(), GridFound);
+		}
+	}
+
+	static FAutoConsoleCommand BenchmarkIconGridCommand(
+		TEXT("Minimap.Benchmark.IconGrid"),
+		TEXT("Measures icon culling cost against total icon count at a constant visible count. Args: [VisibleCount=500] [CellSize=4096]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkIconGrid));
+
+	// Compares culling with a single grid and a per icon category check against per-category grids
+	// that skip hidden categories as a whole, with most icons in hidden categories.
+	static void BenchmarkIconCategories(const TArray<FString>& Args)
+	{
+		const int32 TotalCount = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20000;
+		const float HiddenFraction = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 0.8f;
+		const float CellSize = 4096.0f;
+		const float WorldExtent = 50000.0f;
+		const FVector2D ViewExtent(20000.0f, 20000.0f);
+		const FVector2D ViewCenter(0.0f, 0.0f);
+		const int32 Iterations = 200;
+
+		// One visible category and four hidden ones that share the hidden fraction
+		const TArray<FName> Categories = { TEXT("Units"), TEXT("Creeps"), TEXT("Trees"), TEXT("Resources"), TEXT("Props") };
+		const int32 NumCategories = Categories.Num();
+		TSet<FName> HiddenCategories;
+		for (int32 Category = 1; Category < NumCategories; ++Category)
+			HiddenCategories.Add(Categories[Category]);
+
+		FRandomStream Random(TotalCount);
+		TArray<FVector2D> Positions;
+		TArray<int32> IconCategories;
+		Positions.Reserve(TotalCount);
+		IconCategories.Reserve(TotalCount);
+		for (int32 i = 0; i < TotalCount; ++i)
+		{
+			Positions.Add(FVector2D(Random.FRandRange(-WorldExtent, WorldExtent), Random.FRandRange(-WorldExtent, WorldExtent)));
+			IconCategories.Add(Random.FRand() < HiddenFraction ? Random.RandRange(1, NumCategories - 1) : 0);
+		}
+
+		TMapSpatialHash<int32> SingleGrid(CellSize);
+		TArray<TMapSpatialHash<int32>> CategoryGrids;
+		CategoryGrids.Init(TMapSpatialHash<int32>(CellSize), NumCategories);
+		for (int32 i = 0; i < TotalCount; ++i)
+		{
+			SingleGrid.Add(i, Positions[i]);
+			CategoryGrids[IconCategories[i]].Add(i, Positions[i]);
+		}
+
+		// Single grid, then a hidden category lookup per candidate like UMapViewComponent::IsIconCategoryVisible
+		int32 SingleFound = 0;
+		TArray<int32> Candidates;
+		const double SingleTime = TimeMicroseconds(Iterations, [&]()
+		{
+			Candidates.Reset();
+			SingleGrid.QueryBox(ViewCenter, FVector2D(1, 0), FVector2D(0, 1), ViewExtent, Candidates);
+			SingleFound = 0;
+			for (const int32 Candidate : Candidates)
+				if (!HiddenCategories.Contains(Categories[IconCategories[Candidate]]))
+					++SingleFound;
+		});
+		const int32 SingleCandidates = Candidates.Num();
+
+		// Per-category grids, where hidden categories are skipped before visiting any icon
+		const double BucketTime = TimeMicroseconds(Iterations, [&]()
+		{
+			Candidates.Reset();
+			for (int32 Category = 0; Category < NumCategories; ++Category)
+				if (!HiddenCategories.Contains(Categories[Category]))
+					CategoryGrids[Category].QueryBox(ViewCenter, FVector2D(1, 0), FVector2D(0, 1), ViewExtent, Candidates);
+		});
+
+		UE_LOG(MinimapLog, Display, TEXT("Icon category benchmark: %d icons, %.0f%% in hidden categories"), TotalCount, HiddenFraction * 100.0f);
+		UE_LOG(MinimapLog, Display, TEXT("  single grid %8.1f us (%d candidates, %d visible), category buckets %8.1f us (%d candidates)"),
+			SingleTime, SingleCandidates, SingleFound, BucketTime, Candidates.Num());
+	}
+
+	static FAutoConsoleCommand BenchmarkIconCategoriesCommand(
+		TEXT("Minimap.Benchmark.IconCategories"),
+		TEXT("Measures icon culling cost when most icons are in hidden categories. Args: [TotalCount=20000] [HiddenFraction=0.8]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkIconCategories));
+
+	// Measures icon culling with 1, 2, 4 and 8 workers at growing icon counts. Half of the icons are
+	// tested against a fog buffer, and about half of them are in view.
+	static void BenchmarkIconCulling(const TArray<FString>& Args)
+	{
+		const int32 Iterations = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100);
+		const float WorldExtent = 50000.0f;
+		const int32 FogSize = 256;
+		const int32 TotalCounts[] = { 5000, 20000, 50000 };
+		const int32 WorkerCounts[] = { 1, 2, 4, 8 };
+
+		// A fog covering the whole world with random revealed values
+		FRandomStream Random(FogSize);
+		TArray<uint8> FogCells;
+		FogCells.SetNumUninitialized(FogSize * FogSize);
+		for (uint8& Cell : FogCells)
+			Cell = static_cast<uint8>(Random.RandHelper(256));
+
+		FMapIconCullParams Params;
+		Params.View.ScaledExtent = FVector2D(0.7f * WorldExtent, 0.7f * WorldExtent);
+		Params.View.InverseViewSize = FVector2D(0.5f / Params.View.ScaledExtent.X, 0.5f / Params.View.ScaledExtent.Y);
+		FMapFogSnapshot& Fog = Params.Fogs.AddDefaulted_GetRef();
+		Fog.View.ScaledExtent = FVector2D(WorldExtent, WorldExtent);
+		Fog.View.InverseViewSize = FVector2D(0.5f / WorldExtent, 0.5f / WorldExtent);
+		Fog.Size = FogSize;
+		Fog.PermanentCells = FogCells.GetData();
+		Fog.CurrentlyRevealingCells = FogCells.GetData();
+
+		UE_LOG(MinimapLog, Display, TEXT("Icon culling benchmark: %d task graph workers available"), FTaskGraphInterface::Get().GetNumWorkerThreads());
+		for (const int32 TotalCount : TotalCounts)
+		{
+			FMapIconRenderCache Cache;
+			Cache.Reserve(TotalCount);
+			TArray<int32> Candidates;
+			Candidates.Reserve(TotalCount);
+			for (int32 i = 0; i < TotalCount; ++i)
+			{
+				const int32 Index = Cache.AddDefaulted();
+				Cache.Locations[Index] = FVector2D(Random.FRandRange(-WorldExtent, WorldExtent), Random.FRandRange(-WorldExtent, WorldExtent));
+				Cache.Sizes[Index] = 24.0f;
+				Cache.SizeUnits[Index] = EIconSizeUnit::ScreenSpace;
+				Cache.Flags[Index] = EMapIconRenderFlags::Visible;
+				Cache.MaterialSlots[Index] = 0;
+				Cache.FogInteractions[Index] = Random.FRand() < 0.5f ? EIconFogInteraction::OnlyRenderWhenExplored : EIconFogInteraction::AlwaysRenderAboveFog;
+				Cache.FogRevealThresholds[Index] = 0.5f;
+				Cache.BackgroundInteractions[Index] = EIconBackgroundInteraction::AlwaysRender;
+				Candidates.Add(Index);
+			}
+
+			FMapIconCuller Culler;
+			FMapIconCullResult Result;
+			double SingleWorkerTime = 0.0;
+			for (const int32 NumWorkers : WorkerCounts)
+			{
+				const double Time = TimeMicroseconds(Iterations, [&]()
+				{
+					Culler.Cull(Cache, Candidates, Params, NumWorkers, Result);
+				});
+				if (NumWorkers == 1)
+					SingleWorkerTime = Time;
+				UE_LOG(MinimapLog, Display, TEXT("  %6d icons, %d workers: %8.1f us (%.2fx), %d visible"),
+					TotalCount, NumWorkers, Time, SingleWorkerTime / Time, Result.Visible.Num());
+			}
+		}
+	}
+
+	static FAutoConsoleCommand BenchmarkIconCullingCommand(
+		TEXT("Minimap.Benchmark.IconCulling"),
+		TEXT("Measures parallel icon culling scaling over 1, 2, 4 and 8 workers at 5k, 20k and 50k icons. Args: [Iterations=100]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkIconCulling));
+
+	// Compares sorting icons in view with a comparison sort on z-order against the radix sort on draw keys,
+	// for icons spread over a few z-orders in the order a grid query would return them.
+	static void BenchmarkIconDrawOrder(const TArray<FString>& Args)
+	{
+		const int32 Iterations = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100);
+		const int32 NumZOrders = 8;
+		const int32 VisibleCounts[] = { 500, 5000, 50000 };
+
+		FRandomStream Random(NumZOrders);
+		for (const int32 VisibleCount : VisibleCounts)
+		{
+			FMapIconRenderCache Cache;
+			Cache.Reserve(VisibleCount);
+			TArray<int32> Visible;
+			Visible.Reserve(VisibleCount);
+			for (int32 i = 0; i < VisibleCount; ++i)
+			{
+				const int32 Index = Cache.AddDefaulted();
+				Cache.ZOrders[Index] = Random.RandHelper(NumZOrders);
+				Cache.DrawKeys[Index] = (static_cast<uint64>(Cache.ZOrders[Index]) << 32) | i;
+				Visible.Add(Index);
+			}
+			// Shuffle, since sorting already sorted icons flatters both sorts
+			for (int32 i = VisibleCount - 1; i > 0; --i)
+				Visible.Swap(i, Random.RandHelper(i + 1));
+
+			TArray<int32> Sorted, Scratch;
+			const double ComparisonTime = TimeMicroseconds(Iterations, [&]()
+			{
+				Sorted = Visible;
+				Sorted.Sort([&Cache](const int32 A, const int32 B)
+				{
+					return Cache.ZOrders[A] < Cache.ZOrders[B];
+				});
+			});
+			const double RadixTime = TimeMicroseconds(Iterations, [&]()
+			{
+				Sorted = Visible;
+				Cache.SortByDrawOrder(Sorted, Scratch);
+			});
+			UE_LOG(MinimapLog, Display, TEXT("Icon draw order, %6d icons: comparison sort %8.1f us, radix sort %8.1f us (%.2fx)"),
+				VisibleCount, ComparisonTime, RadixTime, ComparisonTime / RadixTime);
+		}
+	}
+
+	static FAutoConsoleCommand BenchmarkIconDrawOrderCommand(
+		TEXT("Minimap.Benchmark.IconDrawOrder"),
+		TEXT("Compares per-frame icon sorting with a comparison sort against the radix sort on draw keys. Args: [Iterations=100]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkIconDrawOrder));
+
+	// Measures fog grid updates for 500 revealers on a 512 x 512 grid scattered with walls, first without occluders and then with line of sight
+	// over 1, 2, 4 and 8 workers. Revealers and walls don't move between updates, so this is the cost of a frame where every revealer moved.
+	static void BenchmarkFogLineOfSight(const TArray<FString>& Args)
+	{
+		const int32 Iterations = FMath::Max(1, Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 20);
+		const float RevealRadius = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 16.0f;
+		const int32 GridSize = 512;
+		const int32 NumRevealers = 500;
+		const int32 NumWalls = 2000;
+		const int32 WorkerCounts[] = { 1, 2, 4, 8 };
+
+		// Flat ground with short horizontal and vertical walls that are higher than the revealers' eyes
+		FRandomStream Random(GridSize);
+		TArray<float> Heights;
+		Heights.SetNumZeroed(GridSize * GridSize);
+		for (int32 Wall = 0; Wall < NumWalls; ++Wall)
+		{
+			const bool bHorizontal = Random.FRand() < 0.5f;
+			const int32 Length = 4 + Random.RandHelper(12);
+			int32 X = Random.RandHelper(GridSize);
+			int32 Y = Random.RandHelper(GridSize);
+			for (int32 i = 0; i < Length && X < GridSize && Y < GridSize; ++i)
+			{
+				Heights[Y * GridSize + X] = 500.0f;
+				if (bHorizontal)
+					++X;
+				else
+					++Y;
+			}
+		}
+
+		TArray<FMapFogRevealStamp> Stamps;
+		for (int32 i = 0; i < NumRevealers; ++i)
+		{
+			FMapFogRevealStamp& Stamp = Stamps.AddDefaulted_GetRef();
+			Stamp.Center = FVector2D(Random.FRandRange(0.0f, GridSize), Random.FRandRange(0.0f, GridSize));
+			Stamp.Extent = FVector2D(RevealRadius, RevealRadius);
+			Stamp.DropOff = 4.0f;
+			Stamp.bPermanent = i % 2 == 0;
+			Stamp.bLineOfSight = true;
+			Stamp.EyeHeight = 150.0f;
+		}
+
+		UE_LOG(MinimapLog, Display, TEXT("Fog line of sight benchmark: %d revealers of radius %.0f on %dx%d cells, %d task graph workers available"),
+			NumRevealers, RevealRadius, GridSize, GridSize, FTaskGraphInterface::Get().GetNumWorkerThreads());
+
+		FMapFogGrid Grid;
+		Grid.Init(GridSize);
+		const double UnoccludedTime = TimeMicroseconds(Iterations, [&]()
+		{
+			Grid.Update(Stamps, 1);
+		});
+		UE_LOG(MinimapLog, Display, TEXT("  without occluders, 1 worker: %8.1f us"), UnoccludedTime);
+
+		Grid.SetOccluderHeights(MoveTemp(Heights));
+		double SingleWorkerTime = 0.0;
+		for (const int32 NumWorkers : WorkerCounts)
+		{
+			const double Time = TimeMicroseconds(Iterations, [&]()
+			{
+				Grid.Update(Stamps, NumWorkers);
+			});
+			if (NumWorkers == 1)
+				SingleWorkerTime = Time;
+			UE_LOG(MinimapLog, Display, TEXT("  line of sight, %d workers: %8.1f us (%.2fx)"), NumWorkers, Time, SingleWorkerTime / Time);
+		}
+	}
+
+	static FAutoConsoleCommand BenchmarkFogLineOfSightCommand(
+		TEXT("Minimap.Benchmark.FogLineOfSight"),
+		TEXT("Measures fog grid updates with shadowcast line of sight for 500 revealers on a 512x512 grid over 1, 2, 4 and 8 workers. Args: [Iterations=20] [RevealRadius=16]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkFogLineOfSight));
+}
+
+#endif
@@ -4,11 +4,30 @@
 #include "MinimapPluginPrivatePCH.h"
 #include "MapFunctionLibrary.h"
 #include "MapTrackerComponent.h"
+#include "MapTrackerSubsystem.h"
 #include "MapRevealerComponent.h"
 #include "MapViewComponent.h"
+#include "MapIconCulling.h"
+#include "MapFogReadback.h"
+#include "MapFogState.h"
+#include "Components/BoxComponent.h"
 #include "Engine/PostProcessVolume.h"
+#include "Engine/Texture2D.h"
+#include "Engine/World.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Kismet/KismetRenderingLibrary.h"
+#include "Misc/App.h"
+#include "RenderingThread.h"
+#include "TextureResource.h"
+
+DECLARE_CYCLE_STAT(TEXT("Upload Fog Rows"), STAT_MinimapUploadFogRows, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fog Rows Uploaded"), STAT_MinimapFogRowsUploaded, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Bake Fog Occluders"), STAT_MinimapBakeFogOccluders, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Save Fog State"), STAT_MinimapSaveFogState, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Load Fog State"), STAT_MinimapLoadFogState, STATGROUP_Minimap);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Permanent Fog Readback Age (ms)"), STAT_MinimapPermanentFogReadbackAge, STATGROUP_Minimap);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Revealing Fog Readback Age (ms)"), STAT_MinimapRevealingFogReadbackAge, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fog Readbacks In Flight"), STAT_MinimapFogReadbacksInFlight, STATGROUP_Minimap);
 
 AMapFog::AMapFog()
 {
@@ -44,37 +63,74 @@ void AMapFog::BeginPlay()
 		return;
 	}
 
-	// Possibly set up world fog
-	InitializeWorldFog();
-	
-	// Create dynamic render targets to hold permanent and temporary revealed locations
-	const int32 RenderTargetSize = FMath::Max(2, FogRenderTargetSize);
-	PermanentRevealRT_A = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetSize, RenderTargetSize);
-	PermanentRevealRT_B = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetSize, RenderTargetSize);
-	RevealRT_Staging = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetSize, RenderTargetSize);
-	
-	// Register self to tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
+	const int32 RenderTargetSize = GetFogGridSize();
+	if (FogBackend == EMapFogBackend::CPU)
 	{
-		Tracker->RegisterMapFog(this);
-		Tracker->OnMapRevealerRegistered.AddUniqueDynamic(this, &AMapFog::OnMapRevealerRegistered);
-		Tracker->OnMapRevealerUnregistered.AddUniqueDynamic(this, &AMapFog::OnMapRevealerUnregistered);
-		
-		// Register initial revealers
-		TArray<UMapRevealerComponent*> Revealers = Tracker->GetMapRevealers();
-		for (UMapRevealerComponent* Revealer : Revealers)
-			OnMapRevealerRegistered(Revealer);
+		// Keep the fog in a grid, uploaded to a texture that fog materials sample instead of the render targets
+		FogGrid.Init(RenderTargetSize);
+		BakeFogOccluders();
+		if (FApp::CanEverRender())
+		{
+			const EPixelFormat TextureFormat = FogTextureFormat == EMapFogTextureFormat::RG8 ? PF_R8G8 : PF_B8G8R8A8;
+			FogTexture = UTexture2D::CreateTransient(RenderTargetSize, RenderTargetSize, TextureFormat);
+			FogTexture->SRGB = false;
+			FogTexture->AddressX = TA_Clamp;
+			FogTexture->AddressY = TA_Clamp;
+			FogTexture->UpdateResource();
+		}
 	}
+	else
+	{
+		// Create dynamic render targets to hold permanent and temporary revealed locations
+		const ETextureRenderTargetFormat RenderTargetFormat = FogTextureFormat == EMapFogTextureFormat::RG8 ? RTF_RG8 : RTF_RGBA16f;
+		PermanentRevealRT_A = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetSize, RenderTargetSize, RenderTargetFormat);
+		PermanentRevealRT_B = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetSize, RenderTargetSize, RenderTargetFormat);
+		RevealRT_Staging = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetSize, RenderTargetSize, RenderTargetFormat);
+
+		// Queries see fully hidden fog until the buffers are first read back
+		const bool bPackedBits = FogReadbackFormat == EMapFogReadbackFormat::Bit;
+		const int32 NumBufferBytes = FMapFogSnapshot::GetNumBytes(RenderTargetSize * RenderTargetSize, bPackedBits);
+		PermanentRT_Buffer.SetNumZeroed(NumBufferBytes);
+		StagingRT_Buffer.SetNumZeroed(NumBufferBytes);
+		if (bAsyncFogReadback)
+		{
+			PermanentRT_Readback = MakeShared<FMapFogReadback, ESPMode::ThreadSafe>(bPackedBits);
+			StagingRT_Readback = MakeShared<FMapFogReadback, ESPMode::ThreadSafe>(bPackedBits);
+		}
+	}
+
+	// Possibly set up world fog
+	InitializeWorldFog();
 	
 	// Initialize animation start time
 	AnimStartTime = GetWorld()->GetTimeSeconds();
 
-	if (FogCombineMaterial)
+	if (FogCombineMaterial && FogBackend == EMapFogBackend::GPU)
 	{
 		FogCombineMatInst = UMaterialInstanceDynamic::Create(FogCombineMaterial, this);
 		FogCombineMatInst->SetTextureParameterValue(TEXT("NewFog"), RevealRT_Staging);
 	}
+
+	// Register self to tracker, which waits for the GameState if it doesn't exist yet
+	if (UMapTrackerSubsystem* Subsystem = GetWorld()->GetSubsystem<UMapTrackerSubsystem>())
+		Subsystem->CallWhenMapTrackerReady(FMapTrackerReadyDelegate::CreateUObject(this, &AMapFog::RegisterWithMapTracker));
+}
+
+void AMapFog::RegisterWithMapTracker(UMapTrackerComponent* Tracker)
+{
+	// BeginPlay calls this right away if the tracker exists, while the actor is still beginning play
+	if ((!HasActorBegunPlay() && !IsActorBeginningPlay()) || IsActorBeingDestroyed() || MapTracker == Tracker)
+		return;
+
+	TrackerHandle = Tracker->RegisterMapFog(this);
+	MapTracker = Tracker;
+	Tracker->OnMapRevealerRegistered.AddUniqueDynamic(this, &AMapFog::OnMapRevealerRegistered);
+	Tracker->OnMapRevealerUnregistered.AddUniqueDynamic(this, &AMapFog::OnMapRevealerUnregistered);
+	
+	// Register initial revealers
+	TArray<UMapRevealerComponent*> Revealers = Tracker->GetMapRevealers();
+	for (UMapRevealerComponent* Revealer : Revealers)
+		OnMapRevealerRegistered(Revealer);
 }
 
 void AMapFog::EndPlay(const EEndPlayReason::Type EndPlayReason)
@@ -85,18 +141,27 @@ void AMapFog::EndPlay(const EEndPlayReason::Type EndPlayReason)
 		return;
 
 	// Unregister self from tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
+	if (MapTracker)
 	{
-		Tracker->UnregisterMapFog(this);
-		Tracker->OnMapRevealerRegistered.RemoveDynamic(this, &AMapFog::OnMapRevealerRegistered);
-		Tracker->OnMapRevealerUnregistered.RemoveDynamic(this, &AMapFog::OnMapRevealerUnregistered);
+		MapTracker->UnregisterMapFog(TrackerHandle);
+		MapTracker->OnMapRevealerRegistered.RemoveDynamic(this, &AMapFog::OnMapRevealerRegistered);
+		MapTracker->OnMapRevealerUnregistered.RemoveDynamic(this, &AMapFog::OnMapRevealerUnregistered);
 	}
+	MapTracker = nullptr;
+	TrackerHandle = FMapRegistryHandle();
 }
 
 void AMapFog::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+
+	if (FogBackend == EMapFogBackend::CPU)
+	{
+		if (NextOccluderBakeRow != INDEX_NONE)
+			UpdateOccluderBake();
+		UpdateFogGrid();
+		return;
+	}
 	
 	// Clear the temporary vision render target
 	UKismetRenderingLibrary::ClearRenderTarget2D(this, RevealRT_Staging, FLinearColor::Black);
@@ -135,8 +200,13 @@ void AMapFog::Tick(float DeltaTime)
 		UKismetRenderingLibrary::DrawMaterialToRenderTarget(this, NewRT, FogCombineMatInst);
 		
 		// If using a fog post process effect, update the active buffer reference
-		if (FogPostProcessMatInst)
-			FogPostProcessMatInst->SetTextureParameterValue(TEXT("FogRenderTarget"), GetDestinationFogRenderTarget());
+		UpdateFogTextureParameters();
+	}
+
+	if (bAsyncFogReadback)
+	{
+		UpdateFogReadbacks();
+		return;
 	}
 
 	// Mark render target contents retrieved from GPU as dirty
@@ -147,40 +217,406 @@ void AMapFog::Tick(float DeltaTime)
 		bPermanentRT_Read = false;
 }
 
+void AMapFog::UpdateFogReadbacks()
+{
+	const float Time = GetWorld()->GetTimeSeconds();
+	int32 NumInFlight = 0;
+	for (const bool bCurrentlyRevealing : { false, true })
+	{
+		FMapFogReadback* Readback = bCurrentlyRevealing ? StagingRT_Readback.Get() : PermanentRT_Readback.Get();
+		if (!Readback)
+			continue;
+		TArray<uint8>& RelevantBuffer = bCurrentlyRevealing ? StagingRT_Buffer : PermanentRT_Buffer;
+		float& RelevantLastReadTime = bCurrentlyRevealing ? StagingRT_LastReadTime : PermanentRT_LastReadTime;
+		float& RelevantLastRequestTime = bCurrentlyRevealing ? StagingRT_LastRequestTime : PermanentRT_LastRequestTime;
+		bool& bRelevantWanted = bCurrentlyRevealing ? bStagingRT_Wanted : bPermanentRT_Wanted;
+
+		// Swapping in a finished copy here, rather than when it is queried, keeps snapshots valid until the next tick
+		float RequestTime;
+		if (Readback->Consume(RelevantBuffer, RequestTime))
+			RelevantLastReadTime = RequestTime;
+
+		// Only copy buffers that were queried since the last copy. The permanent one is copied from the render target that was just combined into.
+		const bool bRequestCopy = bRelevantWanted && Time - RelevantLastRequestTime >= FogCacheLifetime;
+		Readback->Tick(bCurrentlyRevealing ? RevealRT_Staging : GetSourceFogRenderTarget(), bRequestCopy, Time);
+		if (bRequestCopy)
+		{
+			bRelevantWanted = false;
+			RelevantLastRequestTime = Time;
+		}
+		NumInFlight += Readback->GetNumInFlight();
+	}
+
+	SET_FLOAT_STAT(STAT_MinimapPermanentFogReadbackAge, 1000.0f * GetFogReadbackAge(false));
+	SET_FLOAT_STAT(STAT_MinimapRevealingFogReadbackAge, 1000.0f * GetFogReadbackAge(true));
+	SET_DWORD_STAT(STAT_MinimapFogReadbacksInFlight, NumInFlight);
+}
+
+void AMapFog::UpdateFogGrid()
+{
+	// Revealers only describe their footprint here. Stamping them is spread over worker threads by the grid.
+	RevealStamps.Reset();
+	for (UMapRevealerComponent* Revealer : MapRevealers)
+	{
+		if (Revealer->GetRevealMode() == EMapFogRevealMode::Off)
+			continue;
+		FMapFogRevealStamp Stamp;
+		if (Revealer->GetFogRevealStamp(this, Stamp))
+			RevealStamps.Add(Stamp);
+	}
+	FogGrid.Update(RevealStamps);
+	UploadDirtyFogRows();
+}
+
+void AMapFog::UploadDirtyFogRows()
+{
+	if (!FogGrid.HasDirtyRows())
+		return;
+	if (!FogTexture)
+	{
+		// Nothing to upload to without rendering
+		FogGrid.ClearDirtyRows();
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_MinimapUploadFogRows);
+
+	// Find the rows to copy, and merge each run of changed rows into one region spanning all of their changed columns
+	const int32 Size = FogGrid.GetSize();
+	const TArray<FIntPoint>& DirtyRowSpans = FogGrid.GetDirtyRowSpans();
+	int32 FirstRow = INDEX_NONE, LastRow = INDEX_NONE, NumRegions = 0;
+	for (int32 Row = 0; Row < Size; ++Row)
+	{
+		if (DirtyRowSpans[Row].X > DirtyRowSpans[Row].Y)
+			continue;
+		if (FirstRow == INDEX_NONE)
+			FirstRow = Row;
+		if (LastRow != Row - 1)
+			++NumRegions;
+		LastRow = Row;
+	}
+	if (FirstRow == INDEX_NONE)
+	{
+		FogGrid.ClearDirtyRows();
+		return;
+	}
+
+	// The render thread reads the copy later, so it is handed over and freed once uploaded
+	const int32 NumRows = LastRow - FirstRow + 1;
+	const bool bRG8 = FogTexture->GetPixelFormat() == PF_R8G8;
+	const int32 BytesPerTexel = bRG8 ? 2 : sizeof(FColor);
+	uint8* SrcData = new uint8[NumRows * Size * BytesPerTexel];
+	FUpdateTextureRegion2D* Regions = new FUpdateTextureRegion2D[NumRegions];
+	const uint8* PermanentCells = FogGrid.GetPermanentCells().GetData();
+	const uint8* RevealingCells = FogGrid.GetRevealingCells().GetData();
+	int32 Region = -1;
+	for (int32 Row = FirstRow; Row <= LastRow; ++Row)
+	{
+		const FIntPoint& Span = DirtyRowSpans[Row];
+		if (Span.X > Span.Y)
+			continue;
+
+		if (Region < 0 || static_cast<int32>(Regions[Region].DestY + Regions[Region].Height) != Row)
+		{
+			++Region;
+			Regions[Region] = FUpdateTextureRegion2D(Span.X, Row, Span.X, Row - FirstRow, Span.Y - Span.X + 1, 1);
+		}
+		else
+		{
+			// Widen the region to also cover this row's span. Whole regions are filled from the grid below.
+			FUpdateTextureRegion2D& Merged = Regions[Region];
+			const int32 MinX = FMath::Min<int32>(Merged.DestX, Span.X);
+			const int32 MaxX = FMath::Max<int32>(Merged.DestX + Merged.Width - 1, Span.Y);
+			Merged.DestX = Merged.SrcX = MinX;
+			Merged.Width = MaxX - MinX + 1;
+			++Merged.Height;
+		}
+	}
+
+	// Fill the source rows within each region. R-channel is permanently revealed, G-channel is currently revealing.
+	for (int32 i = 0; i < NumRegions; ++i)
+	{
+		const FUpdateTextureRegion2D& Merged = Regions[i];
+		const int32 EndRow = Merged.DestY + Merged.Height;
+		const int32 EndX = Merged.DestX + Merged.Width;
+		for (int32 Row = Merged.DestY; Row < EndRow; ++Row)
+		{
+			uint8* RowData = SrcData + (Row - FirstRow) * Size * BytesPerTexel;
+			if (bRG8)
+			{
+				for (int32 X = Merged.DestX; X < EndX; ++X)
+				{
+					RowData[2 * X] = PermanentCells[Row * Size + X];
+					RowData[2 * X + 1] = RevealingCells[Row * Size + X];
+				}
+			}
+			else
+			{
+				FColor* Texels = reinterpret_cast<FColor*>(RowData);
+				for (int32 X = Merged.DestX; X < EndX; ++X)
+					Texels[X] = FColor(PermanentCells[Row * Size + X], RevealingCells[Row * Size + X], 0, 255);
+			}
+		}
+	}
+	SET_DWORD_STAT(STAT_MinimapFogRowsUploaded, NumRows);
+
+	FogTexture->UpdateTextureRegions(0, NumRegions, Regions, Size * BytesPerTexel, BytesPerTexel, SrcData,
+		[](uint8* InSrcData, const FUpdateTextureRegion2D* InRegions)
+	{
+		delete[] InSrcData;
+		delete[] InRegions;
+	});
+	FogGrid.ClearDirtyRows();
+}
+
+void AMapFog::UpdateFogTextureParameters()
+{
+	if (FogPostProcessMatInst)
+		FogPostProcessMatInst->SetTextureParameterValue(TEXT("FogRenderTarget"), GetFogTexture());
+}
+
 bool AMapFog::GetFogAtLocation(const FVector& WorldLocation, const bool bRequireCurrentlyRevealing, float& RevealFactor)
 {
 	float U, V;
 	if (FogRenderTargetSize <= 0 || !GetMapView()->GetViewCoordinates(WorldLocation, false, U, V))
 		return false;
+
+	if (FogBackend == EMapFogBackend::CPU)
+	{
+		const TArray<uint8>& Cells = bRequireCurrentlyRevealing ? FogGrid.GetRevealingCells() : FogGrid.GetPermanentCells();
+		RevealFactor = FMapFogSnapshot::SampleCells(Cells.GetData(), FogGrid.GetSize(), U, V);
+		return true;
+	}
 	
+	const TArray<uint8>& Buffer = ReadFogBuffer(bRequireCurrentlyRevealing);
+	const int32 Size = GetFogGridSize();
+	RevealFactor = FogReadbackFormat == EMapFogReadbackFormat::Bit ? FMapFogSnapshot::SampleBits(Buffer.GetData(), Size, U, V) : FMapFogSnapshot::SampleCells(Buffer.GetData(), Size, U, V);
+	return true;
+}
+
+void AMapFog::GetFogSnapshot(const bool bPermanent, const bool bCurrentlyRevealing, FMapFogSnapshot& OutSnapshot)
+{
+	GetMapView()->GetViewSnapshot(OutSnapshot.View);
+	if (FogBackend == EMapFogBackend::CPU)
+	{
+		// The grid is only written while the fog ticks, so it can be sampled directly
+		OutSnapshot.Size = FogGrid.GetSize();
+		OutSnapshot.PermanentCells = bPermanent ? FogGrid.GetPermanentCells().GetData() : nullptr;
+		OutSnapshot.CurrentlyRevealingCells = bCurrentlyRevealing ? FogGrid.GetRevealingCells().GetData() : nullptr;
+		return;
+	}
+	OutSnapshot.Size = GetFogGridSize();
+	OutSnapshot.bPackedBits = FogReadbackFormat == EMapFogReadbackFormat::Bit;
+	OutSnapshot.PermanentCells = bPermanent && FogRenderTargetSize > 0 ? ReadFogBuffer(false).GetData() : nullptr;
+	OutSnapshot.CurrentlyRevealingCells = bCurrentlyRevealing && FogRenderTargetSize > 0 ? ReadFogBuffer(true).GetData() : nullptr;
+}
+
+const TArray<uint8>& AMapFog::ReadFogBuffer(const bool bCurrentlyRevealing)
+{
+	// Never wait on the GPU. Until the first copy finishes the buffer is zeroed, which samples as hidden in fog.
+	if (bAsyncFogReadback)
+	{
+		bool& bRelevantWanted = bCurrentlyRevealing ? bStagingRT_Wanted : bPermanentRT_Wanted;
+		bRelevantWanted = true;
+		return bCurrentlyRevealing ? StagingRT_Buffer : PermanentRT_Buffer;
+	}
+
 	// Read fog render target contents from the GPU, this is done at max once per frame
-	bool& bRelevantReadFlag = bRequireCurrentlyRevealing ? bStagingRT_Read : bPermanentRT_Read;
-	TArray<FLinearColor>& RelevantBuffer = bRequireCurrentlyRevealing ? StagingRT_Buffer : PermanentRT_Buffer;
-	float& RelevantLastReadTime = bRequireCurrentlyRevealing ? StagingRT_LastReadTime : PermanentRT_LastReadTime;
+	bool& bRelevantReadFlag = bCurrentlyRevealing ? bStagingRT_Read : bPermanentRT_Read;
+	TArray<uint8>& RelevantBuffer = bCurrentlyRevealing ? StagingRT_Buffer : PermanentRT_Buffer;
+	float& RelevantLastReadTime = bCurrentlyRevealing ? StagingRT_LastReadTime : PermanentRT_LastReadTime;
 	if (!bRelevantReadFlag)
 	{
-		// Read the render target into the buffer
-		UTextureRenderTarget2D* RelevantRenderTarget = bRequireCurrentlyRevealing ? RevealRT_Staging : PermanentRevealRT_A;
-		FTextureRenderTarget2DResource* TextureResource = static_cast<FTextureRenderTarget2DResource*>(RelevantRenderTarget->GetResource());
-		TextureResource->ReadLinearColorPixels(RelevantBuffer);
-		checkf(RelevantBuffer.Num() > 0, TEXT("Expected pixels to be retrieved"));
+		// Read the render target, and keep the larger of each texel's R and G channels in the buffer.
+		// Read the same way as the asynchronous copies, since linear color reads don't support RG8 render targets.
+		UTextureRenderTarget2D* RelevantRenderTarget = bCurrentlyRevealing ? RevealRT_Staging : PermanentRevealRT_A;
+		const bool bPackedBits = FogReadbackFormat == EMapFogReadbackFormat::Bit;
+		RelevantBuffer.SetNumUninitialized(FMapFogSnapshot::GetNumBytes(RelevantRenderTarget->SizeX * RelevantRenderTarget->SizeY, bPackedBits), false);
+		const bool bRead = FMapFogReadback::ReadBlocking(RelevantRenderTarget, [&RelevantBuffer, bPackedBits](const int32 Index, const float R, const float G)
+		{
+			FMapFogSnapshot::WriteCell(RelevantBuffer.GetData(), Index, FMath::Max(R, G), bPackedBits);
+		});
+		checkf(bRead, TEXT("Expected pixels to be retrieved"));
 		
 		// Remember that this buffer is read for this frame
 		bRelevantReadFlag = true;
 		RelevantLastReadTime = GetWorld()->GetTimeSeconds();
 	}
+	return RelevantBuffer;
+}
+
+UTexture* AMapFog::GetFogTexture() const
+{
+	if (FogBackend == EMapFogBackend::CPU)
+		return FogTexture;
+	return GetDestinationFogRenderTarget();
+}
+
+EMapFogBackend AMapFog::GetFogBackend() const
+{
+	return FogBackend;
+}
+
+int32 AMapFog::GetFogGridSize() const
+{
+	return FMath::Max(2, FogRenderTargetSize);
+}
+
+const FMapFogGrid& AMapFog::GetFogGrid() const
+{
+	return FogGrid;
+}
+
+bool AMapFog::SaveFogState(TArray<uint8>& OutData)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapSaveFogState);
+
+	if (FogBackend == EMapFogBackend::CPU)
+	{
+		if (FogGrid.GetSize() <= 0)
+			return false;
+		FMapFogState::Encode(FogGrid.GetPermanentCells().GetData(), FogGrid.GetSize(), OutData);
+		return true;
+	}
+
+	// After ticking, the source render target is the one this frame's explored areas were combined into. R-channel is permanently revealed.
+	UTextureRenderTarget2D* RenderTarget = GetSourceFogRenderTarget();
+	if (!RenderTarget)
+		return false;
+	const int32 Size = RenderTarget->SizeX;
+	if (RenderTarget->SizeY != Size)
+		return false;
+
+	// Read like gameplay queries do, since linear color reads don't support RG8 render targets
+	TArray<uint8> Cells;
+	Cells.SetNumUninitialized(Size * Size);
+	const bool bRead = FMapFogReadback::ReadBlocking(RenderTarget, [&Cells](const int32 Index, const float R, const float G)
+	{
+		Cells[Index] = static_cast<uint8>(FMath::RoundToInt(255.0f * FMath::Clamp(R, 0.0f, 1.0f)));
+	});
+	if (!bRead)
+		return false;
+	FMapFogState::Encode(Cells.GetData(), Size, OutData);
+	return true;
+}
+
+bool AMapFog::LoadFogState(const TArray<uint8>& Data)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapLoadFogState);
+
+	int32 SavedSize;
+	TArray<uint8> Cells;
+	if (!FMapFogState::Decode(Data, SavedSize, Cells))
+		return false;
+	const int32 Size = GetFogGridSize();
+	if (SavedSize != Size)
+	{
+		TArray<uint8> Resampled;
+		FMapFogState::Resample(Cells, SavedSize, Size, Resampled);
+		Cells = MoveTemp(Resampled);
+	}
 
-	// Convert the view coordinates to a 1D index
-	const int32 i = FMath::RoundToInt(U * FogRenderTargetSize);
-	const int32 j = FMath::RoundToInt(V * FogRenderTargetSize);
-	const int32 PixelIndex = FMath::Clamp(j * FogRenderTargetSize + i, 0, RelevantBuffer.Num() - 1);
+	if (FogBackend == EMapFogBackend::CPU)
+	{
+		if (FogGrid.GetSize() != Size)
+			return false;
+		FogGrid.SetPermanentCells(Cells);
+		return true;
+	}
+	if (!PermanentRevealRT_A || !PermanentRevealRT_B)
+		return false;
 
-	// R-channel = permanently revealed. G-channel = temporarily revealed.
-	const FLinearColor PixelValue = RelevantBuffer[PixelIndex];
-	RevealFactor = FMath::Clamp(FMath::Max(PixelValue.R, PixelValue.G), 0.0f, 1.0f);
+	// Write both permanent render targets, since the next combine pass reads the one written last
+	const bool bRG8 = FogTextureFormat == EMapFogTextureFormat::RG8;
+	const int32 BytesPerTexel = bRG8 ? 2 : sizeof(FFloat16Color);
+	TArray<uint8> Texels;
+	Texels.SetNumZeroed(Cells.Num() * BytesPerTexel);
+	for (int32 i = 0; i < Cells.Num(); ++i)
+	{
+		if (bRG8)
+			Texels[2 * i] = Cells[i];
+		else
+			reinterpret_cast<FFloat16Color*>(Texels.GetData())[i] = FFloat16Color(FLinearColor(Cells[i] / 255.0f, 0.0f, 0.0f, 1.0f));
+	}
+	FTextureRenderTargetResource* ResourceA = PermanentRevealRT_A->GameThread_GetRenderTargetResource();
+	FTextureRenderTargetResource* ResourceB = PermanentRevealRT_B->GameThread_GetRenderTargetResource();
+	ENQUEUE_RENDER_COMMAND(MapFogLoadState)([ResourceA, ResourceB, Texels = MoveTemp(Texels), Size, BytesPerTexel](FRHICommandListImmediate& RHICmdList)
+	{
+		const FUpdateTextureRegion2D Region(0, 0, 0, 0, Size, Size);
+		RHICmdList.UpdateTexture2D(ResourceA->GetRenderTargetTexture(), 0, Region, Size * BytesPerTexel, Texels.GetData());
+		RHICmdList.UpdateTexture2D(ResourceB->GetRenderTargetTexture(), 0, Region, Size * BytesPerTexel, Texels.GetData());
+	});
+
+	// Queries see the loaded state right away. Copies still in flight were taken before the load, so they are dropped
+	// along with their readback, which stays alive until its render commands ran. The next copy is of the loaded state.
+	const bool bPackedBits = FogReadbackFormat == EMapFogReadbackFormat::Bit;
+	if (PermanentRT_Readback)
+		PermanentRT_Readback = MakeShared<FMapFogReadback, ESPMode::ThreadSafe>(bPackedBits);
+	PermanentRT_Buffer.SetNumZeroed(FMapFogSnapshot::GetNumBytes(Cells.Num(), bPackedBits), false);
+	for (int32 i = 0; i < Cells.Num(); ++i)
+		FMapFogSnapshot::WriteCell(PermanentRT_Buffer.GetData(), i, Cells[i] / 255.0f, bPackedBits);
+	bPermanentRT_Read = true;
+	bPermanentRT_Wanted = true;
+	PermanentRT_LastReadTime = GetWorld()->GetTimeSeconds();
 	return true;
 }
 
+void AMapFog::BakeFogOccluders()
+{
+	if (FogBackend != EMapFogBackend::CPU || !bLineOfSight || FogGrid.GetSize() <= 0)
+		return;
+
+	// Tracing every cell at once would hitch, so the rows are traced over the following ticks. Restarts a bake in progress.
+	const int32 Size = FogGrid.GetSize();
+	PendingOccluderHeights.SetNumUninitialized(Size * Size);
+	NextOccluderBakeRow = 0;
+}
+
+void AMapFog::UpdateOccluderBake()
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapBakeFogOccluders);
+
+	const int32 Size = FogGrid.GetSize();
+	if (PendingOccluderHeights.Num() != Size * Size)
+	{
+		PendingOccluderHeights.Empty();
+		NextOccluderBakeRow = INDEX_NONE;
+		return;
+	}
+
+	// Cells without geometry never block sight
+	const FVector TraceOffset(0.0f, 0.0f, GetAreaBounds()->GetScaledBoxExtent().Z);
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(MapFogOccluders), false, this);
+	const int32 EndRow = FMath::Min(Size, NextOccluderBakeRow + FMath::Max(1, OccluderBakeRowsPerFrame));
+	for (int32 Y = NextOccluderBakeRow; Y < EndRow; ++Y)
+	{
+		for (int32 X = 0; X < Size; ++X)
+		{
+			FVector CellCenter;
+			GetMapView()->DeprojectViewToWorld((X + 0.5f) / Size, (Y + 0.5f) / Size, CellCenter);
+			FHitResult Hit;
+			const bool bHit = GetWorld()->LineTraceSingleByObjectType(Hit, CellCenter + TraceOffset, CellCenter - TraceOffset, ObjectParams, QueryParams);
+			PendingOccluderHeights[Y * Size + X] = bHit ? Hit.ImpactPoint.Z : -BIG_NUMBER;
+		}
+	}
+	NextOccluderBakeRow = EndRow;
+
+	if (NextOccluderBakeRow == Size)
+	{
+		FogGrid.SetOccluderHeights(MoveTemp(PendingOccluderHeights));
+		PendingOccluderHeights.Empty();
+		NextOccluderBakeRow = INDEX_NONE;
+	}
+}
+
+float AMapFog::GetFogReadbackAge(const bool bCurrentlyRevealing) const
+{
+	if (FogBackend == EMapFogBackend::CPU || !GetWorld())
+		return 0.0f;
+	return GetWorld()->GetTimeSeconds() - (bCurrentlyRevealing ? StagingRT_LastReadTime : PermanentRT_LastReadTime);
+}
+
 UTextureRenderTarget2D* AMapFog::GetDestinationFogRenderTarget() const
 {
 	return bUseBufferA ? PermanentRevealRT_B : PermanentRevealRT_A;
@@ -240,7 +676,7 @@ UMaterialInstanceDynamic* AMapFog::GetFogMaterialInstanceForCanvas(UMapRendererC
 	// Return the existing material instance after updating the material instance's Time parameter for animations
 	UMaterialInstanceDynamic* MatInst = MaterialInstances[Renderer];
 	MatInst->SetScalarParameterValue(TEXT("Time"), GetWorld()->GetTimeSeconds() - AnimStartTime);
-	MatInst->SetTextureParameterValue(TEXT("FogRenderTarget"), GetDestinationFogRenderTarget());
+	MatInst->SetTextureParameterValue(TEXT("FogRenderTarget"), GetFogTexture());
 	return MatInst;
 }
 
@@ -293,7 +729,7 @@ void AMapFog::InitializeWorldFog()
 	FogPostProcessMatInst = UMaterialInstanceDynamic::Create(FogPostProcessMaterial, this);
 
 	// Pass reference to this fog's render target
-	FogPostProcessMatInst->SetTextureParameterValue(TEXT("FogRenderTarget"), GetDestinationFogRenderTarget());
+	UpdateFogTextureParameters();
 
 	// Pass this fog's location
 	const FVector FogLocation = GetActorLocation();
@@ -317,5 +753,5 @@ void AMapFog::OnMapRevealerRegistered(UMapRevealerComponent* MapRevealer)
 
 void AMapFog::OnMapRevealerUnregistered(UMapRevealerComponent* MapRevealer)
 {
-	MapRevealers.RemoveSingle(MapRevealer);
+	MapRevealers.Remove(MapRevealer);
 }
\ No newline at end of file
@@ -0,0 +1,332 @@
+// Journeyman's Minimap by ZKShao.
+
+#include "MapFogGrid.h"
+#include "MinimapPluginPrivatePCH.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Update Fog Grid"), STAT_MinimapUpdateFogGrid, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fog Grid Workers"), STAT_MinimapFogGridWorkers, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Fog Line Of Sight"), STAT_MinimapFogLineOfSight, STATGROUP_Minimap);
+
+const int32 FMapFogGrid::MinRowsPerWorker;
+
+// Recursive shadowcasting from a cell over the eight octants around it, marking the cells within Bounds that it can see.
+// Cells outside of Bounds are treated as transparent: within an octant, their shadows only fall further outside of Bounds.
+struct FMapFogShadowcaster
+{
+	const float* Heights;
+	int32 GridSize;
+	float EyeHeight;
+	FIntRect Bounds;
+	FIntPoint Origin;
+	int32 Radius;
+	uint8* Visible;
+
+	void Cast()
+	{
+		// Maps each octant's row and column to grid axes
+		static const int32 OctantTransforms[4][8] = {
+			{ 1, 0, 0, -1, -1, 0, 0, 1 },
+			{ 0, 1, -1, 0, 0, -1, 1, 0 },
+			{ 0, 1, 1, 0, 0, -1, -1, 0 },
+			{ 1, 0, 0, 1, -1, 0, 0, -1 },
+		};
+		MarkVisible(Origin.X, Origin.Y);
+		for (int32 Octant = 0; Octant < 8; ++Octant)
+			CastLight(1, 1.0f, 0.0f, OctantTransforms[0][Octant], OctantTransforms[1][Octant], OctantTransforms[2][Octant], OctantTransforms[3][Octant]);
+	}
+
+	void MarkVisible(const int32 X, const int32 Y)
+	{
+		Visible[(Y - Bounds.Min.Y) * Bounds.Width() + X - Bounds.Min.X] = 1;
+	}
+
+	// Scans rows outward from Row between two slopes, recursing into the light that passes each run of occluders
+	void CastLight(const int32 Row, float StartSlope, const float EndSlope, const int32 XX, const int32 XY, const int32 YX, const int32 YY)
+	{
+		if (StartSlope < EndSlope)
+			return;
+
+		float NewStartSlope = 0.0f;
+		for (int32 Distance = Row; Distance <= Radius; ++Distance)
+		{
+			const int32 DY = -Distance;
+			bool bBlocked = false;
+			for (int32 DX = -Distance; DX <= 0; ++DX)
+			{
+				const float LeftSlope = (DX - 0.5f) / (DY + 0.5f);
+				const float RightSlope = (DX + 0.5f) / (DY - 0.5f);
+				if (StartSlope < RightSlope)
+					continue;
+				if (EndSlope > LeftSlope)
+					break;
+
+				const int32 X = Origin.X + DX * XX + DY * XY;
+				const int32 Y = Origin.Y + DX * YX + DY * YY;
+				const bool bInBounds = Bounds.Contains(FIntPoint(X, Y));
+				if (bInBounds)
+					MarkVisible(X, Y);
+
+				// Occluders themselves are visible, like the face of a cliff
+				const bool bOccluder = bInBounds && Heights[Y * GridSize + X] > EyeHeight;
+				if (bBlocked)
+				{
+					if (bOccluder)
+					{
+						NewStartSlope = RightSlope;
+						continue;
+					}
+					bBlocked = false;
+					StartSlope = NewStartSlope;
+				}
+				else if (bOccluder && Distance < Radius)
+				{
+					bBlocked = true;
+					CastLight(Distance + 1, StartSlope, LeftSlope, XX, XY, YX, YY);
+					NewStartSlope = RightSlope;
+				}
+			}
+			if (bBlocked)
+				break;
+		}
+	}
+};
+
+bool FMapFogRevealStamp::GetCellBounds(const int32 GridSize, FIntRect& OutBounds) const
+{
+	// Half size of the rotated footprint's bounding box
+	const FVector2D Outer = Extent + DropOff;
+	const float HalfWidth = FMath::Abs(Cos) * Outer.X + FMath::Abs(Sin) * Outer.Y;
+	const float HalfHeight = FMath::Abs(Sin) * Outer.X + FMath::Abs(Cos) * Outer.Y;
+
+	OutBounds.Min.X = FMath::Max(0, FMath::FloorToInt(Center.X - HalfWidth));
+	OutBounds.Min.Y = FMath::Max(0, FMath::FloorToInt(Center.Y - HalfHeight));
+	OutBounds.Max.X = FMath::Min(GridSize, FMath::CeilToInt(Center.X + HalfWidth));
+	OutBounds.Max.Y = FMath::Min(GridSize, FMath::CeilToInt(Center.Y + HalfHeight));
+	return OutBounds.Min.X < OutBounds.Max.X && OutBounds.Min.Y < OutBounds.Max.Y;
+}
+
+uint8 FMapFogRevealStamp::GetRevealAt(const float CellX, const float CellY) const
+{
+	// Transform to the footprint's local space, relative to its outer edge
+	const FVector2D Outer = Extent + DropOff;
+	if (Outer.X <= 0.0f || Outer.Y <= 0.0f)
+		return 0;
+	const float DX = CellX - Center.X;
+	const float DY = CellY - Center.Y;
+	const float LocalX = (Cos * DX + Sin * DY) / Outer.X;
+	const float LocalY = (Cos * DY - Sin * DX) / Outer.Y;
+
+	// Same as the reveal materials: fully revealed within Extent, fading out linearly over DropOff
+	float Reveal;
+	if (bCircular)
+	{
+		const float Inner = Extent.X / Outer.X;
+		const float Distance = FMath::Sqrt(LocalX * LocalX + LocalY * LocalY);
+		Reveal = Inner < 1.0f ? (1.0f - Distance) / (1.0f - Inner) : (Distance <= 1.0f ? 1.0f : 0.0f);
+	}
+	else
+	{
+		const float InnerX = Extent.X / Outer.X;
+		const float InnerY = Extent.Y / Outer.Y;
+		const float RevealX = InnerX < 1.0f ? (1.0f - FMath::Abs(LocalX)) / (1.0f - InnerX) : (FMath::Abs(LocalX) <= 1.0f ? 1.0f : 0.0f);
+		const float RevealY = InnerY < 1.0f ? (1.0f - FMath::Abs(LocalY)) / (1.0f - InnerY) : (FMath::Abs(LocalY) <= 1.0f ? 1.0f : 0.0f);
+		Reveal = FMath::Min(RevealX, RevealY);
+	}
+	return static_cast<uint8>(FMath::RoundToInt(255.0f * FMath::Clamp(Reveal, 0.0f, 1.0f)));
+}
+
+void FMapFogGrid::Init(const int32 InSize)
+{
+	Size = FMath::Max(0, InSize);
+	const int32 NumCells = Size * Size;
+	PermanentCells.SetNumZeroed(NumCells);
+	RevealingCells.SetNumZeroed(NumCells);
+	PreviousRevealingCells.SetNumZeroed(NumCells);
+	DirtyRowSpans.SetNumUninitialized(Size);
+	if (OccluderHeights.Num() != NumCells)
+		OccluderHeights.Reset();
+	MarkAllDirty();
+}
+
+void FMapFogGrid::SetPermanentCells(const TArray<uint8>& Cells)
+{
+	if (!ensureMsgf(Cells.Num() == Size * Size, TEXT("Expected %d explored cells, got %d"), Size * Size, Cells.Num()))
+		return;
+	PermanentCells = Cells;
+	MarkAllDirty();
+}
+
+void FMapFogGrid::SetOccluderHeights(TArray<float>&& Heights)
+{
+	if (Heights.Num() != 0 && !ensureMsgf(Heights.Num() == Size * Size, TEXT("Expected %d occluder heights, got %d"), Size * Size, Heights.Num()))
+		return;
+	OccluderHeights = MoveTemp(Heights);
+}
+
+void FMapFogGrid::Update(const TArray<FMapFogRevealStamp>& Stamps, int32 NumWorkers)
+{
+	if (Size <= 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_MinimapUpdateFogGrid);
+
+	// Stamp bounds are shared by all workers, so compute them once. Stamps outside of the grid get an empty rect.
+	StampBounds.SetNumUninitialized(Stamps.Num(), false);
+	for (int32 StampIndex = 0; StampIndex < Stamps.Num(); ++StampIndex)
+		if (!Stamps[StampIndex].GetCellBounds(Size, StampBounds[StampIndex]))
+			StampBounds[StampIndex] = FIntRect();
+
+	// The last update's revealing layer becomes the reference to compare against
+	Swap(RevealingCells, PreviousRevealingCells);
+
+	if (NumWorkers <= 0)
+		NumWorkers = GetDefaultNumWorkers(Size, Stamps.Num());
+	NumWorkers = FMath::Clamp(NumWorkers, 1, Size);
+	SET_DWORD_STAT(STAT_MinimapFogGridWorkers, NumWorkers);
+
+	// Stamps' visibility doesn't depend on each other, so it is computed per stamp. Interleaving the stamps balances
+	// the workers better than handing out runs, since nearby revealers tend to be registered together.
+	StampVisibility.SetNum(Stamps.Num(), false);
+	if (OccluderHeights.Num() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_MinimapFogLineOfSight);
+		const int32 NumVisibilityWorkers = FMath::Min(NumWorkers, Stamps.Num());
+		ParallelFor(NumVisibilityWorkers, [&](const int32 Worker)
+		{
+			for (int32 StampIndex = Worker; StampIndex < Stamps.Num(); StampIndex += NumVisibilityWorkers)
+			{
+				if (Stamps[StampIndex].bLineOfSight)
+					ComputeStampVisibility(Stamps[StampIndex], StampBounds[StampIndex], StampVisibility[StampIndex]);
+				else
+					StampVisibility[StampIndex].Reset();
+			}
+		}, NumVisibilityWorkers <= 1);
+	}
+	else
+	{
+		for (TArray<uint8>& Visibility : StampVisibility)
+			Visibility.Reset();
+	}
+
+	const int32 RowsPerWorker = FMath::DivideAndRoundUp(Size, NumWorkers);
+	ParallelFor(NumWorkers, [&](const int32 Worker)
+	{
+		const int32 FirstRow = Worker * RowsPerWorker;
+		const int32 EndRow = FMath::Min(FirstRow + RowsPerWorker, Size);
+		if (FirstRow < EndRow)
+			UpdateRows(FirstRow, EndRow, Stamps, StampBounds);
+	}, NumWorkers == 1);
+
+	for (const FIntPoint& Span : DirtyRowSpans)
+	{
+		if (Span.X <= Span.Y)
+		{
+			bHasDirtyRows = true;
+			break;
+		}
+	}
+}
+
+void FMapFogGrid::UpdateRows(const int32 FirstRow, const int32 EndRow, const TArray<FMapFogRevealStamp>& Stamps, const TArray<FIntRect>& Bounds)
+{
+	// Rebuild the revealing layer from scratch, since revealers that moved away must stop revealing
+	FMemory::Memzero(RevealingCells.GetData() + FirstRow * Size, (EndRow - FirstRow) * Size);
+
+	for (int32 StampIndex = 0; StampIndex < Stamps.Num(); ++StampIndex)
+	{
+		const FMapFogRevealStamp& Stamp = Stamps[StampIndex];
+		const FIntRect& StampRect = Bounds[StampIndex];
+		const TArray<uint8>& Visibility = StampVisibility[StampIndex];
+		const int32 MinY = FMath::Max(FirstRow, StampRect.Min.Y);
+		const int32 MaxY = FMath::Min(EndRow, StampRect.Max.Y);
+		for (int32 Y = MinY; Y < MaxY; ++Y)
+		{
+			uint8* RevealingRow = RevealingCells.GetData() + Y * Size;
+			uint8* PermanentRow = PermanentCells.GetData() + Y * Size;
+			const uint8* VisibleRow = Visibility.Num() > 0 ? Visibility.GetData() + (Y - StampRect.Min.Y) * StampRect.Width() : nullptr;
+			int32 PermanentMinX = MAX_int32, PermanentMaxX = -1;
+			for (int32 X = StampRect.Min.X; X < StampRect.Max.X; ++X)
+			{
+				if (VisibleRow && !VisibleRow[X - StampRect.Min.X])
+					continue;
+				const uint8 Reveal = Stamp.GetRevealAt(X + 0.5f, Y + 0.5f);
+				RevealingRow[X] = FMath::Max(RevealingRow[X], Reveal);
+				if (Stamp.bPermanent && Reveal > PermanentRow[X])
+				{
+					PermanentRow[X] = Reveal;
+					PermanentMinX = FMath::Min(PermanentMinX, X);
+					PermanentMaxX = X;
+				}
+			}
+			if (PermanentMinX <= PermanentMaxX)
+				MarkRowDirty(Y, PermanentMinX, PermanentMaxX);
+		}
+	}
+
+	// Compare against the last update to find the revealing cells that changed
+	for (int32 Y = FirstRow; Y < EndRow; ++Y)
+	{
+		const uint8* Row = RevealingCells.GetData() + Y * Size;
+		const uint8* PreviousRow = PreviousRevealingCells.GetData() + Y * Size;
+		if (FMemory::Memcmp(Row, PreviousRow, Size) == 0)
+			continue;
+		int32 MinX = 0, MaxX = Size - 1;
+		while (Row[MinX] == PreviousRow[MinX])
+			++MinX;
+		while (Row[MaxX] == PreviousRow[MaxX])
+			--MaxX;
+		MarkRowDirty(Y, MinX, MaxX);
+	}
+}
+
+void FMapFogGrid::MarkRowDirty(const int32 Row, const int32 MinX, const int32 MaxX)
+{
+	FIntPoint& Span = DirtyRowSpans[Row];
+	Span.X = FMath::Min(Span.X, MinX);
+	Span.Y = FMath::Max(Span.Y, MaxX);
+}
+
+void FMapFogGrid::ClearDirtyRows()
+{
+	for (FIntPoint& Span : DirtyRowSpans)
+		Span = FIntPoint(MAX_int32, -1);
+	bHasDirtyRows = false;
+}
+
+void FMapFogGrid::MarkAllDirty()
+{
+	for (FIntPoint& Span : DirtyRowSpans)
+		Span = FIntPoint(0, Size - 1);
+	bHasDirtyRows = Size > 0;
+}
+
+void FMapFogGrid::ComputeStampVisibility(const FMapFogRevealStamp& Stamp, const FIntRect& Bounds, TArray<uint8>& OutVisible) const
+{
+	const FIntPoint Origin(FMath::FloorToInt(Stamp.Center.X), FMath::FloorToInt(Stamp.Center.Y));
+	if (!Bounds.Contains(Origin))
+	{
+		OutVisible.Reset();
+		return;
+	}
+	OutVisible.SetNumZeroed(Bounds.Area(), false);
+
+	FMapFogShadowcaster Shadowcaster;
+	Shadowcaster.Heights = OccluderHeights.GetData();
+	Shadowcaster.GridSize = Size;
+	Shadowcaster.EyeHeight = Stamp.EyeHeight;
+	Shadowcaster.Bounds = Bounds;
+	Shadowcaster.Origin = Origin;
+	Shadowcaster.Radius = FMath::Max(FMath::Max(Origin.X - Bounds.Min.X, Bounds.Max.X - 1 - Origin.X), FMath::Max(Origin.Y - Bounds.Min.Y, Bounds.Max.Y - 1 - Origin.Y));
+	Shadowcaster.Visible = OutVisible.GetData();
+	Shadowcaster.Cast();
+}
+
+int32 FMapFogGrid::GetDefaultNumWorkers(const int32 GridSize, const int32 NumStamps)
+{
+	// Without stamps, a worker only clears and compares rows, which isn't worth spreading
+	if (NumStamps == 0)
+		return 1;
+	const int32 MaxWorkers = FApp::ShouldUseThreadingForPerformance() ? FTaskGraphInterface::Get().GetNumWorkerThreads() + 1 : 1;
+	return FMath::Clamp(GridSize / MinRowsPerWorker, 1, MaxWorkers);
+}
@@ -0,0 +1,172 @@
+// Journeyman's Minimap by ZKShao.
+
+#include "MapFogReadback.h"
+#include "MinimapPluginPrivatePCH.h"
+#include "MapIconCulling.h"
+#include "RHIGPUReadback.h"
+#include "RenderingThread.h"
+#include "TextureResource.h"
+
+// Calls Visitor with the index, R and G channels of each texel, from 0 to 1. Rows may be padded, so texels are visited row by row.
+// Returns false for formats that fog render targets don't use.
+template<typename VisitorType>
+static bool VisitFogTexels(const void* Data, const int32 RowPitchInPixels, const FIntPoint& Size, const EPixelFormat Format, VisitorType Visitor)
+{
+	if (Format != PF_FloatRGBA && Format != PF_R8G8)
+	{
+		ensureMsgf(false, TEXT("Unsupported fog render target format %d"), static_cast<int32>(Format));
+		return false;
+	}
+	for (int32 Y = 0; Y < Size.Y; ++Y)
+	{
+		for (int32 X = 0; X < Size.X; ++X)
+		{
+			const int32 TexelIndex = Y * RowPitchInPixels + X;
+			if (Format == PF_R8G8)
+			{
+				const uint8* Texel = static_cast<const uint8*>(Data) + 2 * TexelIndex;
+				Visitor(Y * Size.X + X, Texel[0] / 255.0f, Texel[1] / 255.0f);
+			}
+			else
+			{
+				const FFloat16Color& Texel = static_cast<const FFloat16Color*>(Data)[TexelIndex];
+				Visitor(Y * Size.X + X, Texel.R.GetFloat(), Texel.G.GetFloat());
+			}
+		}
+	}
+	return true;
+}
+
+FMapFogReadback::FMapFogReadback(const bool bInPackedBits)
+	: bPackedBits(bInPackedBits)
+{
+}
+
+FMapFogReadback::~FMapFogReadback()
+{
+}
+
+void FMapFogReadback::Tick(UTextureRenderTarget2D* RenderTarget, const bool bRequestCopy, const float RequestTime)
+{
+	FTextureRenderTargetResource* Resource = bRequestCopy && RenderTarget ? RenderTarget->GameThread_GetRenderTargetResource() : nullptr;
+	if (!Resource && NumInFlight.GetValue() == 0)
+		return;
+
+	// Counted here rather than on the render thread, so that copies enqueued but not started yet are still polled next tick
+	if (Resource)
+		NumInFlight.Increment();
+
+	TSharedRef<FMapFogReadback, ESPMode::ThreadSafe> This = AsShared();
+	ENQUEUE_RENDER_COMMAND(MapFogReadback)([This, Resource, RequestTime](FRHICommandListImmediate& RHICmdList)
+	{
+		This->Poll_RenderThread(RHICmdList);
+		if (Resource)
+			This->EnqueueCopy_RenderThread(RHICmdList, Resource->GetRenderTargetTexture(), RequestTime);
+	});
+}
+
+bool FMapFogReadback::Consume(TArray<uint8>& OutBuffer, float& OutRequestTime)
+{
+	FScopeLock Lock(&CompletedLock);
+	if (!bHasCompleted)
+		return false;
+
+	// Swap rather than copy, so that the buffers are reused by later copies
+	Swap(OutBuffer, CompletedBuffer);
+	OutRequestTime = CompletedRequestTime;
+	bHasCompleted = false;
+	return true;
+}
+
+void FMapFogReadback::EnqueueCopy_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* Texture, const float RequestTime)
+{
+	FSlot* FreeSlot = nullptr;
+	for (FSlot& Slot : Slots)
+		if (!Slot.bInFlight)
+			FreeSlot = &Slot;
+	if (!FreeSlot || !Texture)
+	{
+		NumInFlight.Decrement();
+		return;
+	}
+
+	if (!FreeSlot->Readback)
+		FreeSlot->Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("MapFogReadback"));
+	FreeSlot->Readback->EnqueueCopy(RHICmdList, Texture);
+	FreeSlot->RequestTime = RequestTime;
+	const FIntVector TextureSize = Texture->GetSizeXYZ();
+	FreeSlot->Size = FIntPoint(TextureSize.X, TextureSize.Y);
+	FreeSlot->Format = Texture->GetFormat();
+	FreeSlot->bInFlight = true;
+}
+
+void FMapFogReadback::Poll_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	for (FSlot& Slot : Slots)
+	{
+		if (!Slot.bInFlight || !Slot.Readback->IsReady())
+			continue;
+
+		// Each cell keeps the larger of the R and G channels
+		void* Data = nullptr;
+		int32 RowPitchInPixels = 0;
+		Slot.Readback->LockTexture(RHICmdList, Data, RowPitchInPixels);
+		if (Data)
+		{
+			ConvertBuffer.SetNumUninitialized(FMapFogSnapshot::GetNumBytes(Slot.Size.X * Slot.Size.Y, bPackedBits), false);
+			const bool bConverted = VisitFogTexels(Data, RowPitchInPixels, Slot.Size, Slot.Format, [this](const int32 Index, const float R, const float G)
+			{
+				FMapFogSnapshot::WriteCell(ConvertBuffer.GetData(), Index, FMath::Max(R, G), bPackedBits);
+			});
+			if (!bConverted)
+				Data = nullptr;
+		}
+		Slot.Readback->Unlock();
+		Slot.bInFlight = false;
+		NumInFlight.Decrement();
+
+		// Hand over the copy, unless a newer one was handed over already
+		if (Data)
+		{
+			FScopeLock Lock(&CompletedLock);
+			if (!bHasCompleted || Slot.RequestTime >= CompletedRequestTime)
+			{
+				Swap(ConvertBuffer, CompletedBuffer);
+				CompletedRequestTime = Slot.RequestTime;
+				bHasCompleted = true;
+			}
+		}
+	}
+}
+
+bool FMapFogReadback::ReadBlocking(UTextureRenderTarget2D* RenderTarget, TFunctionRef<void(int32, float, float)> Visitor)
+{
+	FTextureRenderTargetResource* Resource = RenderTarget ? RenderTarget->GameThread_GetRenderTargetResource() : nullptr;
+	if (!Resource)
+		return false;
+
+	// Copied and converted like the asynchronous copies, since surface reads can't convert every format fog render targets use.
+	// The game thread waits for the command below, so it can refer to the visitor and the result.
+	bool bSuccess = false;
+	ENQUEUE_RENDER_COMMAND(MapFogReadBlocking)([Resource, &Visitor, &bSuccess](FRHICommandListImmediate& RHICmdList)
+	{
+		FRHITexture* Texture = Resource->GetRenderTargetTexture();
+		if (!Texture)
+			return;
+		FRHIGPUTextureReadback Readback(TEXT("MapFogReadBlocking"));
+		Readback.EnqueueCopy(RHICmdList, Texture);
+		RHICmdList.BlockUntilGPUIdle();
+
+		void* Data = nullptr;
+		int32 RowPitchInPixels = 0;
+		Readback.LockTexture(RHICmdList, Data, RowPitchInPixels);
+		if (Data)
+		{
+			const FIntVector TextureSize = Texture->GetSizeXYZ();
+			bSuccess = VisitFogTexels(Data, RowPitchInPixels, FIntPoint(TextureSize.X, TextureSize.Y), Texture->GetFormat(), Visitor);
+		}
+		Readback.Unlock();
+	});
+	FlushRenderingCommands();
+	return bSuccess;
+}
@@ -0,0 +1,131 @@
+// Journeyman's Minimap by ZKShao.
+
+#include "MapFogState.h"
+#include "MinimapPluginPrivatePCH.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+const uint32 FMapFogState::Magic;
+const uint16 FMapFogState::Version;
+
+void FMapFogState::Encode(const uint8* Cells, const int32 Size, TArray<uint8>& OutData)
+{
+	// Runs as the cell value followed by the run length minus one, 7 bits per byte with the high bit set on all but the last byte
+	const int32 NumCells = Size * Size;
+	TArray<uint8> Runs;
+	for (int32 RunStart = 0; RunStart < NumCells;)
+	{
+		const uint8 Value = Cells[RunStart];
+		int32 RunEnd = RunStart + 1;
+		while (RunEnd < NumCells && Cells[RunEnd] == Value)
+			++RunEnd;
+		Runs.Add(Value);
+		uint32 Length = RunEnd - RunStart - 1;
+		while (Length >= 0x80)
+		{
+			Runs.Add(static_cast<uint8>(Length | 0x80));
+			Length >>= 7;
+		}
+		Runs.Add(static_cast<uint8>(Length));
+		RunStart = RunEnd;
+	}
+
+	// Runs of noisy fog don't compress much further, in which case they are stored as they are
+	uint8 Flags = 0;
+	TArray<uint8> Compressed;
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Runs.Num());
+	Compressed.SetNumUninitialized(CompressedSize);
+	if (Runs.Num() > 0 && FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, Runs.GetData(), Runs.Num()) && CompressedSize < Runs.Num())
+	{
+		Compressed.SetNum(CompressedSize, false);
+		Flags |= Flag_Zlib;
+	}
+	const TArray<uint8>& Payload = (Flags & Flag_Zlib) ? Compressed : Runs;
+
+	OutData.Reset();
+	FMemoryWriter Writer(OutData);
+	uint32 HeaderMagic = Magic;
+	uint16 HeaderVersion = Version;
+	int32 HeaderSize = Size;
+	int32 RunsSize = Runs.Num();
+	Writer << HeaderMagic << HeaderVersion << Flags << HeaderSize << RunsSize;
+	Writer.Serialize(const_cast<uint8*>(Payload.GetData()), Payload.Num());
+}
+
+bool FMapFogState::Decode(const TArray<uint8>& Data, int32& OutSize, TArray<uint8>& OutCells)
+{
+	FMemoryReader Reader(Data);
+	uint32 HeaderMagic = 0;
+	uint16 HeaderVersion = 0;
+	uint8 Flags = 0;
+	int32 HeaderSize = 0;
+	int32 RunsSize = 0;
+	Reader << HeaderMagic << HeaderVersion << Flags << HeaderSize << RunsSize;
+	if (Reader.IsError() || HeaderMagic != Magic || HeaderVersion == 0 || HeaderVersion > Version)
+		return false;
+	if (HeaderSize <= 0 || HeaderSize > 16384 || RunsSize < 0)
+		return false;
+	// The runs are largest when every cell is its own run of a value byte and a one byte length, so anything larger is corrupt.
+	// Checked before allocating, so that a corrupt header can't request gigabytes.
+	const int64 MaxRunsSize = 2 * static_cast<int64>(HeaderSize) * HeaderSize;
+	if (RunsSize > MaxRunsSize)
+		return false;
+
+	const int32 PayloadSize = Data.Num() - Reader.Tell();
+	const uint8* Payload = Data.GetData() + Reader.Tell();
+	TArray<uint8> Uncompressed;
+	if (Flags & Flag_Zlib)
+	{
+		Uncompressed.SetNumUninitialized(RunsSize);
+		if (!FCompression::UncompressMemory(NAME_Zlib, Uncompressed.GetData(), RunsSize, Payload, PayloadSize))
+			return false;
+		Payload = Uncompressed.GetData();
+	}
+	else if (PayloadSize != RunsSize)
+	{
+		return false;
+	}
+
+	// Expand the runs, refusing runs that don't fill the grid exactly
+	const int32 NumCells = HeaderSize * HeaderSize;
+	OutCells.SetNumUninitialized(NumCells, false);
+	int32 Cell = 0;
+	for (int32 i = 0; i < RunsSize;)
+	{
+		const uint8 Value = Payload[i++];
+		uint32 Length = 0;
+		for (int32 Shift = 0;; Shift += 7)
+		{
+			if (i >= RunsSize || Shift > 28)
+				return false;
+			const uint8 Byte = Payload[i++];
+			Length |= static_cast<uint32>(Byte & 0x7F) << Shift;
+			if (!(Byte & 0x80))
+				break;
+		}
+		if (Length >= static_cast<uint32>(NumCells - Cell))
+			return false;
+		FMemory::Memset(OutCells.GetData() + Cell, Value, Length + 1);
+		Cell += Length + 1;
+	}
+	if (Cell != NumCells)
+		return false;
+
+	OutSize = HeaderSize;
+	return true;
+}
+
+void FMapFogState::Resample(const TArray<uint8>& Cells, const int32 Size, const int32 NewSize, TArray<uint8>& OutCells)
+{
+	OutCells.SetNumUninitialized(NewSize * NewSize, false);
+	for (int32 Y = 0; Y < NewSize; ++Y)
+	{
+		const int32 SourceY = FMath::Min((2 * Y + 1) * Size / (2 * NewSize), Size - 1);
+		for (int32 X = 0; X < NewSize; ++X)
+		{
+			const int32 SourceX = FMath::Min((2 * X + 1) * Size / (2 * NewSize), Size - 1);
+			OutCells[Y * NewSize + X] = Cells[SourceY * Size + SourceX];
+		}
+	}
+}
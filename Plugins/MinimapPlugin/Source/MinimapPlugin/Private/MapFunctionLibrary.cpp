@@ -3,6 +3,7 @@
 #include "MapFunctionLibrary.h"
 #include "MinimapPluginPrivatePCH.h"
 #include "MapTrackerComponent.h"
+#include "MapTrackerSubsystem.h"
 #include "MapViewComponent.h"
 #include "MapIconComponent.h"
 #include "MapBackground.h"
@@ -11,7 +12,6 @@
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "GameFramework/PlayerController.h"
-#include "GameFramework/GameState.h"
 #include "Engine/Engine.h"
 #include "EngineGlobals.h"
 
@@ -26,34 +26,9 @@ UMapTrackerComponent* UMapFunctionLibrary::GetMapTracker(const UObject* WorldCon
 	if (!World)
 		return nullptr;
 
-	// Minimap is pointless on dedicated server, so don't do any tracking
-	if (World->GetNetMode() == ENetMode::NM_DedicatedServer)
-		return nullptr;
-
-	// Retrieve the game state actor
-#if ENGINE_MAJOR_VERSION == 4 && ENGINE_MINOR_VERSION <= 13
-	AGameState* GS = World->GetGameState();
-#else
-	AGameStateBase* GS = World->GetGameState();
-#endif
-
-	// Game state not found, assuming gameplay is not in progress
-	if (!GS)
-		return nullptr;
-
-	// Attempt to find a MapTrackerComponent as component of the GameState actor
-	UMapTrackerComponent* MapTracker = Cast<UMapTrackerComponent>(GS->GetComponentByClass(UMapTrackerComponent::StaticClass()));
-	if (MapTracker)
-	{
-		// Found it, so return it
-		return MapTracker;
-	}
-	else
-	{
-		// Wasn't found, so create it once. Subsequent calls will find this one.
-		MapTracker = NewObject<UMapTrackerComponent>(GS, TEXT("MapTracker"));
-		return MapTracker;
-	}
+	// The world's subsystem caches the tracker, and creates it once the GameState exists. It doesn't exist in editor worlds.
+	UMapTrackerSubsystem* Subsystem = World->GetSubsystem<UMapTrackerSubsystem>();
+	return Subsystem ? Subsystem->GetMapTracker() : nullptr;
 }
 
 AMapBackground* UMapFunctionLibrary::GetFirstMapBackground(const UObject* WorldContextObject)
@@ -73,12 +48,6 @@ AMapBackground* UMapFunctionLibrary::GetFirstMapBackground(const UObject* WorldC
 
 UMapViewComponent* UMapFunctionLibrary::FindMapView(UObject* WorldContextObject, const EMapViewSearchOption MapViewSearchOption)
 {
-#if ENGINE_MAJOR_VERSION == 4 && ENGINE_MINOR_VERSION <= 16
-    UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
-#else
-    UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
-#endif
-
 	bool bConsiderPlayer = false;
 	bool bConsiderMapBackground = false;
 	bool bConsiderMapFog = false;
@@ -117,18 +86,24 @@ UMapViewComponent* UMapFunctionLibrary::FindMapView(UObject* WorldContextObject,
 			return MapView;
 	}
 
+	// Other views are looked up in the tracker's view registry, which only holds the handful of views in this world
+	UMapTrackerComponent* MapTracker = GetMapTracker(WorldContextObject);
+	if (!MapTracker)
+		return nullptr;
+	const TArray<UMapViewComponent*>& MapViews = MapTracker->GetMapViews();
+
 	if (bConsiderMapBackground)
-		for (TActorIterator<AMapBackground> Itr(World); Itr; ++Itr)
-			return Itr->GetMapView();
+		for (UMapViewComponent* MapView : MapViews)
+			if (Cast<AMapBackground>(MapView->GetOwner()))
+				return MapView;
 	
 	if (bConsiderMapFog)
-		for (TActorIterator<AMapFog> Itr(World); Itr; ++Itr)
-			return Itr->GetMapView();
+		for (UMapViewComponent* MapView : MapViews)
+			if (Cast<AMapFog>(MapView->GetOwner()))
+				return MapView;
 
-	if (bConsiderAllActors)
-		for (TObjectIterator<UMapViewComponent> Itr; Itr; ++Itr)
-			if (Itr->GetWorld() == World)
-				return *Itr;
+	if (bConsiderAllActors && MapViews.Num() > 0)
+		return MapViews[0];
 
 	return nullptr;
 }
@@ -192,22 +167,28 @@ TArray<UMapIconComponent*> UMapFunctionLibrary::BoxSelectInView(const FVector2D&
 	const FVector2D UVMin(FMath::Min(StartUV.X, EndUV.X), FMath::Min(StartUV.Y, EndUV.Y));
 	const FVector2D UVMax(FMath::Max(StartUV.X, EndUV.X), FMath::Max(StartUV.Y, EndUV.Y));
 
+	// Only consider icons the spatial grid reports near the view
+	TArray<int32> CandidateIndices;
+	MapTracker->GetIconIndicesOverlappingView(MapView, CandidateIndices);
+
+	// Test against the packed render cache first, so components are only touched for icons inside the box
+	const TArray<UMapIconComponent*>& MapIcons = MapTracker->GetMapIcons();
+	const FMapIconRenderCache& Cache = MapTracker->GetIconRenderCache();
 	float U, V;
 	TArray<UMapIconComponent*> Results;
-	TArray<UMapIconComponent*> AllIcons = MapTracker->GetMapIcons();
-	for (UMapIconComponent* MapIcon : AllIcons)
+	for (const int32 Index : CandidateIndices)
 	{
 		// Check if icon is not hidden
-		if (!MapIcon->IsIconVisible())
+		if (!Cache.HasFlag(Index, EMapIconRenderFlags::Visible))
 			continue;
 
-		// Check if icon is not hidden for this view, for example its in a background priority volume that the map view cannot see at the moment
-		if (!MapIcon->IsRenderedInView(MapView))
+		// Check if icon is in view rect, then if its in minimap shape, then finally if its in the box
+		if (!MapView->GetViewCoordinates(FVector(Cache.Locations[Index], Cache.Heights[Index]), bIsCircular, U, V) || !DetectIsInView(FVector2D(U, V), FVector2D::ZeroVector, bIsCircular) || U < UVMin.X || U > UVMax.X || V < UVMin.Y || V > UVMax.Y)
 			continue;
 
-		// Check if icon is in view rect, then if its in minimap shape, then finally if its in the box
-		if (MapView->GetViewCoordinates(MapIcon->GetComponentLocation(), bIsCircular, U, V) && DetectIsInView(FVector2D(U, V), FVector2D::ZeroVector, bIsCircular) && U >= UVMin.X && U <= UVMax.X && V >= UVMin.Y && V <= UVMax.Y)
-			Results.Add(MapIcon);
+		// Check if icon is not hidden for this view, for example its in a background priority volume that the map view cannot see at the moment
+		if (MapIcons[Index]->IsRenderedInView(MapView))
+			Results.Add(MapIcons[Index]);
 	}
 
 	return Results;
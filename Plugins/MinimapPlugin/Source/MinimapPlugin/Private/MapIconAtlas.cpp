@@ -0,0 +1,146 @@
+// Journeyman's Minimap by ZKShao.
+
+#include "MapIconAtlas.h"
+#include "MinimapPluginPrivatePCH.h"
+#include "Engine/Canvas.h"
+#include "Engine/ObjectLibrary.h"
+#include "Kismet/KismetRenderingLibrary.h"
+
+DECLARE_CYCLE_STAT(TEXT("Draw Icon Atlas"), STAT_MinimapDrawIconAtlas, STATGROUP_Minimap);
+
+const uint16 UMapIconAtlas::NoEntry;
+
+uint16 UMapIconAtlas::FindOrAddTexture(UTexture2D* Texture)
+{
+	if (!Texture)
+		return NoEntry;
+	if (const uint16* ExistingEntry = EntryIndices.Find(Texture))
+		return *ExistingEntry;
+	if (Entries.Num() >= NoEntry)
+		return NoEntry;
+
+	// Scale the texture down to the maximum entry size, keeping its aspect ratio
+	const int32 TextureWidth = FMath::Max(1, Texture->GetSizeX());
+	const int32 TextureHeight = FMath::Max(1, Texture->GetSizeY());
+	const float Scale = FMath::Min(1.0f, (float)MaxEntrySize / FMath::Max(TextureWidth, TextureHeight));
+	const FIntPoint EntrySize(FMath::Max(1, FMath::RoundToInt(TextureWidth * Scale)), FMath::Max(1, FMath::RoundToInt(TextureHeight * Scale)));
+
+	int32 Page;
+	FIntPoint Position;
+	if (!Allocate(EntrySize + FIntPoint(2 * EntryPadding, 2 * EntryPadding), Page, Position))
+	{
+		// Remember that it doesn't fit, so the allocation isn't attempted every time the texture is set
+		EntryIndices.Add(Texture, NoEntry);
+		return NoEntry;
+	}
+
+	FMapIconAtlasEntry Entry;
+	Entry.Page = Page;
+	Entry.Rect.Min = Position + FIntPoint(EntryPadding, EntryPadding);
+	Entry.Rect.Max = Entry.Rect.Min + EntrySize;
+	Entry.UVMin = FVector2D(Entry.Rect.Min) / PageSize;
+	Entry.UVSize = FVector2D(EntrySize) / PageSize;
+
+	const uint16 EntryIndex = static_cast<uint16>(Entries.Add(Entry));
+	EntryTextures.Add(Texture);
+	EntryIndices.Add(Texture, EntryIndex);
+	PendingDraws.Add(EntryIndex);
+
+	// Icons are small, so keep the whole texture resident instead of drawing a blurry low mip into the atlas
+	Texture->SetForceMipLevelsToBeResident(30.0f);
+	return EntryIndex;
+}
+
+void UMapIconAtlas::AddPluginIconTextures()
+{
+	UObjectLibrary* Library = UObjectLibrary::CreateLibrary(UTexture2D::StaticClass(), false, GIsEditor);
+	Library->LoadAssetDataFromPath(TEXT("/MinimapPlugin/Textures/Icons"));
+	Library->LoadAssetsFromAssetData();
+
+	TArray<UTexture2D*> Textures;
+	Library->GetObjects<UTexture2D>(Textures);
+	for (UTexture2D* Texture : Textures)
+		FindOrAddTexture(Texture);
+}
+
+void UMapIconAtlas::FlushPendingDraws()
+{
+	if (PendingDraws.Num() == 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_MinimapDrawIconAtlas);
+
+	// Draw per page, since a canvas draws to one render target at a time
+	TArray<uint16> StillPending;
+	UObject* WorldContextObject = GetOuter();
+	for (int32 Page = 0; Page < Pages.Num(); ++Page)
+	{
+		UCanvas* Canvas = nullptr;
+		FVector2D CanvasSize;
+		FDrawToRenderTargetContext RenderContext;
+		for (const uint16 EntryIndex : PendingDraws)
+		{
+			FMapIconAtlasEntry& Entry = Entries[EntryIndex];
+			if (Entry.Page != Page)
+				continue;
+
+			if (!Canvas)
+				UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(WorldContextObject, Pages[Page], Canvas, CanvasSize, RenderContext);
+
+			// Opaque blending overwrites the region including its alpha, which also makes redrawing a texture safe
+			UTexture2D* Texture = EntryTextures[EntryIndex];
+			Canvas->K2_DrawTexture(Texture, FVector2D(Entry.Rect.Min), FVector2D(Entry.Rect.Size()), FVector2D::ZeroVector, FVector2D::UnitVector, FLinearColor::White, EBlendMode::BLEND_Opaque);
+			Entry.bDrawn = true;
+			if (!Texture->IsFullyStreamedIn())
+				StillPending.Add(EntryIndex);
+		}
+		if (Canvas)
+			UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(WorldContextObject, RenderContext);
+	}
+	PendingDraws = MoveTemp(StillPending);
+}
+
+bool UMapIconAtlas::Allocate(const FIntPoint& Size, int32& OutPage, FIntPoint& OutPosition)
+{
+	if (Size.X > PageSize || Size.Y > PageSize)
+		return false;
+
+	for (int32 Page = 0; Page <= Pages.Num() && Page < MaxPages; ++Page)
+	{
+		if (Page == Pages.Num())
+		{
+			// All existing pages are full, so start a new one
+			UTextureRenderTarget2D* NewPage = UKismetRenderingLibrary::CreateRenderTarget2D(GetOuter(), PageSize, PageSize, RTF_RGBA16f, FLinearColor::Transparent);
+			if (!NewPage)
+				return false;
+			Pages.Add(NewPage);
+			PageShelves.AddDefaulted();
+		}
+
+		// Use the lowest shelf that fits, to waste as little height as possible
+		TArray<FShelf>& Shelves = PageShelves[Page];
+		FShelf* BestShelf = nullptr;
+		for (FShelf& Shelf : Shelves)
+			if (Shelf.Height >= Size.Y && Shelf.NextX + Size.X <= PageSize && (!BestShelf || Shelf.Height < BestShelf->Height))
+				BestShelf = &Shelf;
+
+		// Otherwise open a new shelf below the last one
+		if (!BestShelf)
+		{
+			const int32 ShelfY = Shelves.Num() > 0 ? Shelves.Last().Y + Shelves.Last().Height : 0;
+			if (ShelfY + Size.Y > PageSize)
+				continue;
+			FShelf NewShelf;
+			NewShelf.Y = ShelfY;
+			NewShelf.Height = Size.Y;
+			NewShelf.NextX = 0;
+			BestShelf = &Shelves.Add_GetRef(NewShelf);
+		}
+
+		OutPage = Page;
+		OutPosition = FIntPoint(BestShelf->NextX, BestShelf->Y);
+		BestShelf->NextX += Size.X;
+		return true;
+	}
+	return false;
+}
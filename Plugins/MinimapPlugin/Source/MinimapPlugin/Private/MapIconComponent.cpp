@@ -3,6 +3,7 @@
 #include "MapIconComponent.h"
 #include "MinimapPluginPrivatePCH.h"
 #include "MapTrackerComponent.h"
+#include "MapTrackerSubsystem.h"
 #include "MapFunctionLibrary.h"
 
 UMapIconComponent::UMapIconComponent()
@@ -13,6 +14,9 @@ UMapIconComponent::UMapIconComponent()
 
 	// Preview sprite appears above the actor
 	SetRelativeLocation(FVector(0, 0, 256));
+
+	// Movement is forwarded to the tracker to keep its spatial grid up to date
+	bWantsOnUpdateTransform = true;
 	
 	// Find default icon in content folder
 	static ConstructorHelpers::FObjectFinder<UTexture2D> DefaultIcon(TEXT("/MinimapPlugin/Textures/Icons/T_Icon_Placeholder"));
@@ -65,19 +69,35 @@ void UMapIconComponent::BeginPlay()
 		return;
 	}
 
-	// Register self to tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
-		Tracker->RegisterMapIcon(this);
-	
 	// Backup initial materials, so user can revert to these by calling ResetIconMaterialForUMG() or ResetIconMaterialForCanvas()
 	InitialIconMaterial_UMG = IconMaterial_UMG;
 	InitialIconMaterial_Canvas = IconMaterial_Canvas;
 	// Set initial material's start time
 	MaterialEffectStartTime = GetWorld()->GetTimeSeconds();
 	
+	// Register self to tracker, which waits for the GameState if it doesn't exist yet. Ticking is enabled on registration.
+	SetComponentTickEnabled(false);
+	if (UMapTrackerSubsystem* Subsystem = GetWorld()->GetSubsystem<UMapTrackerSubsystem>())
+		Subsystem->CallWhenMapTrackerReady(FMapTrackerReadyDelegate::CreateUObject(this, &UMapIconComponent::RegisterWithMapTracker));
+}
+
+void UMapIconComponent::RegisterWithMapTracker(UMapTrackerComponent* Tracker)
+{
+	if (!HasBegunPlay() || IsBeingDestroyed() || MapTracker == Tracker)
+		return;
+
+	// Start the trail where the icon is registered, so that it doesn't connect to where the icon was placed in the level
+	if (bTrailEnabled)
+	{
+		Trail.Reset(TrailMaxPoints);
+		Trail.Add(FVector2D(GetComponentLocation()), GetWorld()->GetTimeSeconds());
+	}
+
+	Tracker->RegisterMapIcon(this);
+	MapTracker = Tracker;
+
 	// Enable ticking only when features require it
-	SetComponentTickEnabled(Tracker && bHideOwnerInsideFog);
+	SetComponentTickEnabled(bHideOwnerInsideFog);
 }
 
 void UMapIconComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -88,12 +108,11 @@ void UMapIconComponent::TickComponent(float DeltaTime, enum ELevelTick TickType,
 		return;
 
 	// Hide actor inside fog
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker && Tracker->HasMapFog())
+	if (MapTracker && MapTracker->HasMapFog())
 	{
 		const FVector Location = GetComponentLocation();
 		bool bIsInsideFog;
-		GetOwner()->SetActorHiddenInGame(Tracker->GetFogRevealedFactor(Location, IconFogInteraction == EIconFogInteraction::OnlyRenderWhenRevealing, bIsInsideFog) < IconFogRevealThreshold && bIsInsideFog);
+		GetOwner()->SetActorHiddenInGame(MapTracker->GetFogRevealedFactor(Location, IconFogInteraction == EIconFogInteraction::OnlyRenderWhenRevealing, bIsInsideFog) < IconFogRevealThreshold && bIsInsideFog);
 	}
 }
 
@@ -105,9 +124,9 @@ void UMapIconComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 		return;
 	
 	// Unregister self from tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
-		Tracker->UnregisterMapIcon(this);
+	if (MapTracker)
+		MapTracker->UnregisterMapIcon(this);
+	MapTracker = nullptr;
 
 	// Unmark as rendered from all views, will fire OnViewLeft events
 	// for all views the map icon is currently rendered in
@@ -170,6 +189,7 @@ void UMapIconComponent::SetIconMaterialForCanvas(UMaterialInterface* NewMaterial
 	// Store and announce new material. If any minimaps are open, will result in new icon material instances
 	IconMaterial_Canvas = NewMaterial;
 	OnIconMaterialChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 
 	// Reset material start time
 	MaterialEffectStartTime = GetWorld()->GetTimeSeconds();
@@ -199,6 +219,7 @@ void UMapIconComponent::SetIconTexture(UTexture2D* NewIcon)
 {
 	IconTexture = NewIcon;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 UTexture2D* UMapIconComponent::GetIconTexture() const
@@ -217,12 +238,27 @@ FName UMapIconComponent::GetIconTooltipText() const
 	return IconTooltipText;
 }
 
+void UMapIconComponent::SetIconCategory(FName NewIconCategory)
+{
+	if (NewIconCategory == IconCategory)
+		return;
+	IconCategory = NewIconCategory;
+	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
+}
+
+FName UMapIconComponent::GetIconCategory() const
+{
+	return IconCategory;
+}
+
 void UMapIconComponent::SetIconVisible(const bool bNewVisible)
 {
 	if (bNewVisible == bIconVisible)
 		return;
 	bIconVisible = bNewVisible;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 
 	// If hiding, mark as not rendered in all views
 	if (!bNewVisible)
@@ -240,6 +276,7 @@ void UMapIconComponent::SetIconInteractable(const bool bNewInteractable)
 		return;
 	bIconInteractable = bNewInteractable;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 bool UMapIconComponent::IsIconInteractable() const
@@ -251,6 +288,7 @@ void UMapIconComponent::SetIconRotates(const bool bNewRotates)
 {
 	bIconRotates = bNewRotates;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 bool UMapIconComponent::DoesIconRotate() const
@@ -263,6 +301,7 @@ void UMapIconComponent::SetIconSize(const float NewIconSize, const EIconSizeUnit
 	IconSize = NewIconSize;
 	IconSizeUnit = NewIconSizeUnit;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 float UMapIconComponent::GetIconSize() const
@@ -279,6 +318,7 @@ void UMapIconComponent::SetIconDrawColor(const FLinearColor& NewDrawColor)
 {
 	IconDrawColor = NewDrawColor;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 FLinearColor UMapIconComponent::GetIconDrawColor() const
@@ -290,6 +330,7 @@ void UMapIconComponent::SetIconZOrder(const int32 NewZOrder)
 {
 	IconZOrder = NewZOrder;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 int32 UMapIconComponent::GetIconZOrder() const
@@ -301,6 +342,7 @@ void UMapIconComponent::SetObjectiveArrowEnabled(const bool bNewObjectiveArrowEn
 {
 	bObjectiveArrowEnabled = bNewObjectiveArrowEnabled;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 bool UMapIconComponent::IsObjectiveArrowEnabled() const
@@ -312,6 +354,7 @@ void UMapIconComponent::SetObjectiveArrowTexture(UTexture2D* NewTexture)
 {
 	ObjectiveArrowTexture = NewTexture;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 UTexture2D* UMapIconComponent::GetObjectiveArrowTexture() const
@@ -323,6 +366,7 @@ void UMapIconComponent::SetObjectiveArrowRotates(const bool bNewRotates)
 {
 	bObjectiveArrowRotates = bNewRotates;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 bool UMapIconComponent::DoesObjectiveArrowRotate() const
@@ -334,6 +378,7 @@ void UMapIconComponent::SetObjectiveArrowSize(const float NewObjectiveArrowSize)
 {
 	ObjectiveArrowSize = NewObjectiveArrowSize;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 float UMapIconComponent::GetObjectiveArrowSize() const
@@ -345,6 +390,7 @@ void UMapIconComponent::SetIconBackgroundInteraction(const EIconBackgroundIntera
 {
 	IconBackgroundInteraction = NewBackgroundInteraction;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 EIconBackgroundInteraction UMapIconComponent::GetIconBackgroundInteraction() const
@@ -356,6 +402,7 @@ void UMapIconComponent::SetIconFogInteraction(const EIconFogInteraction NewFogIn
 {
 	IconFogInteraction = NewFogInteraction;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 EIconFogInteraction UMapIconComponent::GetIconFogInteraction() const
@@ -367,6 +414,7 @@ void UMapIconComponent::SetIconFogRevealThreshold(const float NewFogRevealThresh
 {
 	IconFogRevealThreshold = NewFogRevealThreshold;
 	OnIconAppearanceChanged.Broadcast(this);
+	NotifyTrackerPropertiesChanged();
 }
 
 float UMapIconComponent::GetIconFogRevealThreshold() const
@@ -374,6 +422,59 @@ float UMapIconComponent::GetIconFogRevealThreshold() const
 	return IconFogRevealThreshold;
 }
 
+void UMapIconComponent::SetTrailEnabled(const bool bNewTrailEnabled)
+{
+	if (bNewTrailEnabled == bTrailEnabled)
+		return;
+	bTrailEnabled = bNewTrailEnabled;
+
+	// Free the buffer of disabled trails, since icons with trails are usually few among many
+	if (bTrailEnabled)
+		ClearTrail();
+	else
+		Trail = FMapIconTrail();
+	NotifyTrackerPropertiesChanged();
+}
+
+bool UMapIconComponent::IsTrailEnabled() const
+{
+	return bTrailEnabled;
+}
+
+void UMapIconComponent::ClearTrail()
+{
+	if (!bTrailEnabled)
+		return;
+	Trail.Reset(TrailMaxPoints);
+	if (HasBegunPlay())
+		Trail.Add(FVector2D(GetComponentLocation()), GetWorld()->GetTimeSeconds());
+}
+
+void UMapIconComponent::SetTrailColor(const FLinearColor& NewTrailColor)
+{
+	TrailColor = NewTrailColor;
+}
+
+FLinearColor UMapIconComponent::GetTrailColor() const
+{
+	return TrailColor;
+}
+
+float UMapIconComponent::GetTrailWidth() const
+{
+	return TrailWidth;
+}
+
+float UMapIconComponent::GetTrailLifetime() const
+{
+	return TrailLifetime;
+}
+
+const FMapIconTrail& UMapIconComponent::GetTrail() const
+{
+	return Trail;
+}
+
 UMaterialInstanceDynamic* UMapIconComponent::GetIconMaterialInstanceForCanvas(UMapRendererComponent* Renderer)
 {
 	if (!Renderer || !IconMaterial_Canvas)
@@ -476,6 +577,16 @@ void UMapIconComponent::ReceiveClicked(const bool bIsLeftMouseButton)
 	OnIconClicked.Broadcast(this, bIsLeftMouseButton);
 }
 
+void UMapIconComponent::SetIconHandle(const FMapIconHandle& NewIconHandle)
+{
+	IconHandle = NewIconHandle;
+}
+
+FMapIconHandle UMapIconComponent::GetIconHandle() const
+{
+	return IconHandle;
+}
+
 void UMapIconComponent::RefreshPreviewSprite()
 {
 	if (IconTexture)
@@ -490,6 +601,34 @@ void UMapIconComponent::RefreshPreviewSprite()
 	}
 }
 
+void UMapIconComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+
+	// Keep the tracker's render cache and spatial grid up to date
+	if (MapTracker)
+	{
+		MapTracker->UpdateMapIconLocation(this);
+		if (bTrailEnabled)
+			RecordTrailPoint();
+	}
+}
+
+void UMapIconComponent::RecordTrailPoint()
+{
+	// Sample by distance rather than time, so that the trail's shape doesn't depend on the frame rate or on how fast the icon moves
+	const FVector2D Location(GetComponentLocation());
+	if (Trail.Num() > 0 && FVector2D::DistSquared(Location, Trail.GetLocation(Trail.Num() - 1)) < FMath::Square(TrailSampleDistance))
+		return;
+	Trail.Add(Location, GetWorld()->GetTimeSeconds());
+}
+
+void UMapIconComponent::NotifyTrackerPropertiesChanged()
+{
+	if (MapTracker)
+		MapTracker->UpdateMapIconProperties(this);
+}
+
 void UMapIconComponent::UnmarkRenderedFromAllViews()
 {
 	// For all views that the MapIconComponent is currently rendered in, mark it not rendered
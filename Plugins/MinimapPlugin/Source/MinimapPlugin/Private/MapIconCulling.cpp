@@ -0,0 +1,146 @@
+// Journeyman's Minimap by ZKShao.
+
+#include "MapIconCulling.h"
+#include "MinimapPluginPrivatePCH.h"
+#include "MapIconRenderCache.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Cull Icons"), STAT_MinimapCullIcons, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Icon Culling Workers"), STAT_MinimapIconCullingWorkers, STATGROUP_Minimap);
+
+const int32 FMapIconCuller::MinIconsPerWorker;
+
+bool FMapFogSnapshot::GetFogAtLocation(const FVector& WorldLocation, const bool bRequireCurrentlyRevealing, float& RevealFactor) const
+{
+	const uint8* Cells = bRequireCurrentlyRevealing ? CurrentlyRevealingCells : PermanentCells;
+	float U, V;
+	if (Size <= 0 || !Cells || !View.GetViewCoordinates(WorldLocation, U, V))
+		return false;
+
+	RevealFactor = bPackedBits ? SampleBits(Cells, Size, U, V) : SampleCells(Cells, Size, U, V);
+	return true;
+}
+
+float FMapFogSnapshot::SampleCells(const uint8* Cells, const int32 Size, const float U, const float V)
+{
+	// Convert the view coordinates to a 1D index
+	const int32 i = FMath::RoundToInt(U * Size);
+	const int32 j = FMath::RoundToInt(V * Size);
+	const int32 CellIndex = FMath::Clamp(j * Size + i, 0, Size * Size - 1);
+	return Cells[CellIndex] / 255.0f;
+}
+
+float FMapFogSnapshot::SampleBits(const uint8* Bits, const int32 Size, const float U, const float V)
+{
+	// Same lookup as SampleCells
+	const int32 i = FMath::RoundToInt(U * Size);
+	const int32 j = FMath::RoundToInt(V * Size);
+	const int32 CellIndex = FMath::Clamp(j * Size + i, 0, Size * Size - 1);
+	return (Bits[CellIndex >> 3] >> (CellIndex & 7)) & 1 ? 1.0f : 0.0f;
+}
+
+int32 FMapIconCuller::GetDefaultNumWorkers(const int32 NumCandidates)
+{
+	const int32 MaxWorkers = FApp::ShouldUseThreadingForPerformance() ? FTaskGraphInterface::Get().GetNumWorkerThreads() + 1 : 1;
+	return FMath::Clamp(NumCandidates / MinIconsPerWorker, 1, MaxWorkers);
+}
+
+void FMapIconCuller::Cull(const FMapIconRenderCache& Cache, const TArray<int32>& Candidates, const FMapIconCullParams& Params, int32 NumWorkers, FMapIconCullResult& OutResult)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapCullIcons);
+
+	OutResult.Reset();
+	if (NumWorkers <= 0)
+		NumWorkers = GetDefaultNumWorkers(Candidates.Num());
+	NumWorkers = FMath::Clamp(NumWorkers, 1, FMath::Max(1, Candidates.Num()));
+	SET_DWORD_STAT(STAT_MinimapIconCullingWorkers, NumWorkers);
+
+	// Cull directly into the result when there's nothing to merge
+	if (NumWorkers == 1)
+	{
+		CullRange(Cache, Candidates.GetData(), Candidates.Num(), Params, OutResult);
+		return;
+	}
+
+	// Give each worker a contiguous range, so that it walks the candidates in order
+	if (WorkerResults.Num() < NumWorkers)
+		WorkerResults.SetNum(NumWorkers);
+	const int32 CandidatesPerWorker = FMath::DivideAndRoundUp(Candidates.Num(), NumWorkers);
+	ParallelFor(NumWorkers, [&](const int32 Worker)
+	{
+		const int32 First = Worker * CandidatesPerWorker;
+		const int32 Count = FMath::Min(CandidatesPerWorker, Candidates.Num() - First);
+		FMapIconCullResult& WorkerResult = WorkerResults[Worker];
+		WorkerResult.Reset();
+		if (Count > 0)
+			CullRange(Cache, Candidates.GetData() + First, Count, Params, WorkerResult);
+	});
+
+	// Merge in worker order, which keeps the result in candidate order
+	int32 NumVisible = 0, NumNeedsBackgroundLevelCheck = 0, NumLeftView = 0;
+	for (int32 Worker = 0; Worker < NumWorkers; ++Worker)
+	{
+		NumVisible += WorkerResults[Worker].Visible.Num();
+		NumNeedsBackgroundLevelCheck += WorkerResults[Worker].NeedsBackgroundLevelCheck.Num();
+		NumLeftView += WorkerResults[Worker].LeftView.Num();
+	}
+	OutResult.Visible.Reserve(NumVisible);
+	OutResult.NeedsBackgroundLevelCheck.Reserve(NumNeedsBackgroundLevelCheck);
+	OutResult.LeftView.Reserve(NumLeftView);
+	for (int32 Worker = 0; Worker < NumWorkers; ++Worker)
+	{
+		OutResult.Visible.Append(WorkerResults[Worker].Visible);
+		OutResult.NeedsBackgroundLevelCheck.Append(WorkerResults[Worker].NeedsBackgroundLevelCheck);
+		OutResult.LeftView.Append(WorkerResults[Worker].LeftView);
+	}
+}
+
+void FMapIconCuller::CullRange(const FMapIconRenderCache& Cache, const int32* Candidates, const int32 NumCandidates, const FMapIconCullParams& Params, FMapIconCullResult& OutResult)
+{
+	for (int32 CandidateIndex = 0; CandidateIndex < NumCandidates; ++CandidateIndex)
+	{
+		const int32 Index = Candidates[CandidateIndex];
+
+		// Ignore hidden map icons
+		if (!Cache.HasFlag(Index, EMapIconRenderFlags::Visible))
+			continue;
+
+		// Ignore icon with invalid size
+		const float IconSize = Cache.Sizes[Index] * (Cache.SizeUnits[Index] == EIconSizeUnit::WorldSpace ? Params.PixelToWorldRatio : Params.DPIScale);
+		if (IconSize <= 0.0f)
+			continue;
+
+		// Ignore icon if no material set
+		if (Cache.MaterialSlots[Index] == FMapIconRenderCache::NoMaterialSlot && Cache.ObjectiveArrowMaterialSlots[Index] == FMapIconRenderCache::NoMaterialSlot)
+			continue;
+
+		// Do a fast check that eliminates most icons that aren't in the view
+		// Takes into account the icon's size
+		const FVector WorldLocation(Cache.Locations[Index], Cache.Heights[Index]);
+		const float IconWorldRadius = IconSize * ICONSIZE_TO_OUTERRADIUS * Params.WorldToPixelRatio;
+		if (!Cache.HasFlag(Index, EMapIconRenderFlags::ObjectiveArrowEnabled) && !Params.View.Contains(WorldLocation, IconWorldRadius))
+		{
+			OutResult.LeftView.Add(Index);
+			continue;
+		}
+
+		// Check whether the icon is visible in the fog. Like the tracker, use the first fog that covers the icon.
+		const EIconFogInteraction FogInteraction = Cache.FogInteractions[Index];
+		if (Params.Fogs.Num() > 0 && (FogInteraction == EIconFogInteraction::OnlyRenderWhenExplored || FogInteraction == EIconFogInteraction::OnlyRenderWhenRevealing))
+		{
+			const bool bRequireCurrentlyRevealing = FogInteraction == EIconFogInteraction::OnlyRenderWhenRevealing;
+			float RevealFactor = 1.0f;
+			for (const FMapFogSnapshot& Fog : Params.Fogs)
+				if (Fog.GetFogAtLocation(WorldLocation, bRequireCurrentlyRevealing, RevealFactor))
+					break;
+			if (RevealFactor < Cache.FogRevealThresholds[Index])
+				continue;
+		}
+
+		// Icon passed all checks that can be done here
+		if (Params.bCheckBackgroundLevels && Cache.BackgroundInteractions[Index] != EIconBackgroundInteraction::AlwaysRender)
+			OutResult.NeedsBackgroundLevelCheck.Add(Index);
+		else
+			OutResult.Visible.Add(Index);
+	}
+}
@@ -0,0 +1,190 @@
+// Journeyman's Minimap by ZKShao.
+
+#include "MapIconRenderCache.h"
+#include "MinimapPluginPrivatePCH.h"
+#include "MapIconComponent.h"
+#include "MapIconAtlas.h"
+
+const uint16 FMapIconRenderCache::NoMaterialSlot;
+const uint16 FMapIconRenderCache::NoCategoryBucket;
+const uint64 FMapIconRenderCache::NoDrawKey;
+
+int32 FMapIconRenderCache::AddDefaulted()
+{
+	Locations.AddDefaulted();
+	Heights.AddDefaulted();
+	Yaws.AddDefaulted();
+	Sizes.AddDefaulted();
+	ObjectiveArrowSizes.AddDefaulted();
+	FogRevealThresholds.AddDefaulted();
+	ZOrders.AddDefaulted();
+	DrawKeys.Add(NoDrawKey);
+	SizeUnits.AddDefaulted();
+	FogInteractions.AddDefaulted();
+	BackgroundInteractions.AddDefaulted();
+	Flags.AddDefaulted();
+	MaterialSlots.Add(NoMaterialSlot);
+	ObjectiveArrowMaterialSlots.Add(NoMaterialSlot);
+	CategoryBuckets.Add(NoCategoryBucket);
+	AtlasEntries.Add(UMapIconAtlas::NoEntry);
+	ObjectiveArrowAtlasEntries.Add(UMapIconAtlas::NoEntry);
+	DrawColors.AddDefaulted();
+	TrailSlots.Add(INDEX_NONE);
+	Textures.AddDefaulted();
+	return ObjectiveArrowTextures.AddDefaulted();
+}
+
+void FMapIconRenderCache::RemoveAtSwap(const int32 Index)
+{
+	Locations.RemoveAtSwap(Index, 1, false);
+	Heights.RemoveAtSwap(Index, 1, false);
+	Yaws.RemoveAtSwap(Index, 1, false);
+	Sizes.RemoveAtSwap(Index, 1, false);
+	ObjectiveArrowSizes.RemoveAtSwap(Index, 1, false);
+	FogRevealThresholds.RemoveAtSwap(Index, 1, false);
+	ZOrders.RemoveAtSwap(Index, 1, false);
+	DrawKeys.RemoveAtSwap(Index, 1, false);
+	SizeUnits.RemoveAtSwap(Index, 1, false);
+	FogInteractions.RemoveAtSwap(Index, 1, false);
+	BackgroundInteractions.RemoveAtSwap(Index, 1, false);
+	Flags.RemoveAtSwap(Index, 1, false);
+	MaterialSlots.RemoveAtSwap(Index, 1, false);
+	ObjectiveArrowMaterialSlots.RemoveAtSwap(Index, 1, false);
+	CategoryBuckets.RemoveAtSwap(Index, 1, false);
+	AtlasEntries.RemoveAtSwap(Index, 1, false);
+	ObjectiveArrowAtlasEntries.RemoveAtSwap(Index, 1, false);
+	DrawColors.RemoveAtSwap(Index, 1, false);
+	TrailSlots.RemoveAtSwap(Index, 1, false);
+	Textures.RemoveAtSwap(Index, 1, false);
+	ObjectiveArrowTextures.RemoveAtSwap(Index, 1, false);
+}
+
+void FMapIconRenderCache::Reserve(const int32 Number)
+{
+	Locations.Reserve(Number);
+	Heights.Reserve(Number);
+	Yaws.Reserve(Number);
+	Sizes.Reserve(Number);
+	ObjectiveArrowSizes.Reserve(Number);
+	FogRevealThresholds.Reserve(Number);
+	ZOrders.Reserve(Number);
+	DrawKeys.Reserve(Number);
+	SizeUnits.Reserve(Number);
+	FogInteractions.Reserve(Number);
+	BackgroundInteractions.Reserve(Number);
+	Flags.Reserve(Number);
+	MaterialSlots.Reserve(Number);
+	ObjectiveArrowMaterialSlots.Reserve(Number);
+	CategoryBuckets.Reserve(Number);
+	AtlasEntries.Reserve(Number);
+	ObjectiveArrowAtlasEntries.Reserve(Number);
+	DrawColors.Reserve(Number);
+	TrailSlots.Reserve(Number);
+	Textures.Reserve(Number);
+	ObjectiveArrowTextures.Reserve(Number);
+}
+
+void FMapIconRenderCache::Empty()
+{
+	Locations.Empty();
+	Heights.Empty();
+	Yaws.Empty();
+	Sizes.Empty();
+	ObjectiveArrowSizes.Empty();
+	FogRevealThresholds.Empty();
+	ZOrders.Empty();
+	DrawKeys.Empty();
+	SizeUnits.Empty();
+	FogInteractions.Empty();
+	BackgroundInteractions.Empty();
+	Flags.Empty();
+	MaterialSlots.Empty();
+	ObjectiveArrowMaterialSlots.Empty();
+	CategoryBuckets.Empty();
+	AtlasEntries.Empty();
+	ObjectiveArrowAtlasEntries.Empty();
+	DrawColors.Empty();
+	TrailSlots.Empty();
+	Textures.Empty();
+	ObjectiveArrowTextures.Empty();
+}
+
+void FMapIconRenderCache::WriteTransform(const int32 Index, const FTransform& Transform)
+{
+	const FVector Location = Transform.GetLocation();
+	Locations[Index] = FVector2D(Location.X, Location.Y);
+	Heights[Index] = Location.Z;
+	Yaws[Index] = Transform.Rotator().Yaw;
+}
+
+void FMapIconRenderCache::WriteProperties(const int32 Index, const UMapIconComponent* MapIcon)
+{
+	Sizes[Index] = MapIcon->GetIconSize();
+	ObjectiveArrowSizes[Index] = MapIcon->GetObjectiveArrowSize();
+	FogRevealThresholds[Index] = MapIcon->GetIconFogRevealThreshold();
+	ZOrders[Index] = MapIcon->GetIconZOrder();
+	SizeUnits[Index] = MapIcon->GetIconSizeUnit();
+	FogInteractions[Index] = MapIcon->GetIconFogInteraction();
+	BackgroundInteractions[Index] = MapIcon->GetIconBackgroundInteraction();
+	DrawColors[Index] = MapIcon->GetIconDrawColor();
+	Textures[Index] = MapIcon->GetIconTexture();
+	ObjectiveArrowTextures[Index] = MapIcon->GetObjectiveArrowTexture();
+
+	uint8 IconFlags = 0;
+	if (MapIcon->IsIconVisible())
+		IconFlags |= EMapIconRenderFlags::Visible;
+	if (MapIcon->DoesIconRotate())
+		IconFlags |= EMapIconRenderFlags::Rotates;
+	if (MapIcon->IsIconInteractable())
+		IconFlags |= EMapIconRenderFlags::Interactable;
+	if (MapIcon->IsObjectiveArrowEnabled())
+		IconFlags |= EMapIconRenderFlags::ObjectiveArrowEnabled;
+	if (MapIcon->DoesObjectiveArrowRotate())
+		IconFlags |= EMapIconRenderFlags::ObjectiveArrowRotates;
+	Flags[Index] = IconFlags;
+}
+
+void FMapIconRenderCache::SortByDrawOrder(TArray<int32>& Indices, TArray<int32>& Scratch) const
+{
+	const int32 NumIndices = Indices.Num();
+	if (NumIndices < 2)
+		return;
+
+	// Count the values of every byte of the keys in one pass
+	static const int32 NumDigits = sizeof(uint64);
+	uint32 Histograms[NumDigits][256];
+	FMemory::Memzero(Histograms);
+	for (const int32 Index : Indices)
+	{
+		const uint64 DrawKey = DrawKeys[Index];
+		for (int32 Digit = 0; Digit < NumDigits; ++Digit)
+			++Histograms[Digit][(DrawKey >> (8 * Digit)) & 0xFF];
+	}
+
+	// Scatter on one byte at a time, least significant first. Bytes that are the same for all icons are skipped,
+	// which usually leaves only the lowest bytes of the sequence numbers and the lowest byte of the z layer.
+	Scratch.SetNumUninitialized(NumIndices, false);
+	int32* Source = Indices.GetData();
+	int32* Target = Scratch.GetData();
+	for (int32 Digit = 0; Digit < NumDigits; ++Digit)
+	{
+		uint32* Histogram = Histograms[Digit];
+		const int32 Shift = 8 * Digit;
+		if (Histogram[(DrawKeys[Source[0]] >> Shift) & 0xFF] == static_cast<uint32>(NumIndices))
+			continue;
+
+		uint32 Offset = 0;
+		for (int32 Value = 0; Value < 256; ++Value)
+		{
+			const uint32 Count = Histogram[Value];
+			Histogram[Value] = Offset;
+			Offset += Count;
+		}
+		for (int32 i = 0; i < NumIndices; ++i)
+			Target[Histogram[(DrawKeys[Source[i]] >> Shift) & 0xFF]++] = Source[i];
+		Swap(Source, Target);
+	}
+
+	if (Source != Indices.GetData())
+		FMemory::Memcpy(Indices.GetData(), Source, NumIndices * sizeof(int32));
+}
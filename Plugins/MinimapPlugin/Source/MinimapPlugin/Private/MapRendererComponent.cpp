@@ -4,17 +4,38 @@
 #include "MinimapPluginPrivatePCH.h"
 #include "MapFunctionLibrary.h"
 #include "MapTrackerComponent.h"
+#include "MapTrackerSubsystem.h"
 #include "MapIconComponent.h"
+#include "MapIconAtlas.h"
 #include "MapViewComponent.h"
 #include "MapBackground.h"
 #include "MapFog.h"
+#include "MapIconCulling.h"
 #include "Engine/Canvas.h"
+#include "Engine/Engine.h"
 #include "Blueprint/WidgetLayoutLibrary.h"
 #include "GameFramework/PlayerController.h"
+#include "Kismet/KismetRenderingLibrary.h"
 #include "Materials/MaterialInterface.h"
 #include "Materials/MaterialInstanceDynamic.h"
+#include "TextureResource.h"
 #include "TimerManager.h"
 
+DECLARE_CYCLE_STAT(TEXT("Draw Icons"), STAT_MinimapDrawIcons, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Draw Icon Draw Lists"), STAT_MinimapDrawIconDrawList, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Draw Static Layer"), STAT_MinimapDrawStaticLayer, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Update Render Target"), STAT_MinimapUpdateRenderTarget, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Draw Icon Trails"), STAT_MinimapDrawIconTrails, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Cluster Icons"), STAT_MinimapClusterIcons, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Icon Draw Calls"), STAT_MinimapIconDrawCalls, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Icon Clusters"), STAT_MinimapIconClusters, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Icon Trail Segments"), STAT_MinimapIconTrailSegments, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Clustered Icons"), STAT_MinimapClusteredIcons, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dropped Icons"), STAT_MinimapDroppedIcons, STATGROUP_Minimap);
+
+// Not using #define here because it may interfere with end user #defines.
+static const float ICONSIZE_TO_INNERRADIUS = 0.5f;
+
 UMapRendererComponent::UMapRendererComponent()
 {
 	PrimaryComponentTick.bCanEverTick = true;
@@ -28,24 +49,59 @@ void UMapRendererComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
+	UpdateTickGroup();
+
 	// If a fill material is set, instantiate it now
 	if (FillMaterial)
 		FillMaterialInstance = UMaterialInstanceDynamic::Create(FillMaterial, this);
 
-	// Find the map tracker component once at game start
-	MapTracker = UMapFunctionLibrary::GetMapTracker(this);
+	// Find the map tracker component once it exists, which waits for the GameState if it doesn't exist yet
+	if (UMapTrackerSubsystem* Subsystem = GetWorld()->GetSubsystem<UMapTrackerSubsystem>())
+		Subsystem->CallWhenMapTrackerReady(FMapTrackerReadyDelegate::CreateUObject(this, &UMapRendererComponent::RegisterWithMapTracker));
 	
 	// Apply the auto-locate map view setting
 	if (!MapView)
 		AutoRelocateMapView();
 }
 
+void UMapRendererComponent::RegisterWithMapTracker(UMapTrackerComponent* Tracker)
+{
+	if (!HasBegunPlay() || IsBeingDestroyed() || MapTracker == Tracker)
+		return;
+
+	if (MapTracker)
+		MapTracker->OnMapViewRegistered.RemoveDynamic(this, &UMapRendererComponent::OnMapViewRegistered);
+
+	MapTracker = Tracker;
+	bIconDrawListsValid = false;
+
+	// Views are searched for in the tracker's registry, so a search at begin play may have failed without it
+	if (!MapView)
+		AutoRelocateMapView();
+}
+
 void UMapRendererComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
 	// Fire buffered mouse hover events
 	TickHoverEvents();
+
+	// Redraw the static layer and draw newly packed icon textures into the atlas before the map is drawn,
+	// since drawing to a render target can't happen while the map is drawn to one
+	if (bIsRendered && MapTracker && MapView)
+	{
+		UpdateStaticLayer();
+		if (bBatchIconDraws && bUseIconAtlas)
+			MapTracker->GetIconAtlas()->FlushPendingDraws();
+	}
+
+	if (bRenderToTarget && bIsRendered && MapTracker && MapView)
+	{
+		const float Now = GetWorld()->GetRealTimeSeconds();
+		if (!RenderTarget || RenderTargetUpdateRate <= 0.0f || Now - LastRenderTargetUpdateTime >= 1.0f / RenderTargetUpdateRate)
+			UpdateRenderTarget();
+	}
 }
 
 void UMapRendererComponent::SetAutoLocateMapView(const EMapViewSearchOption InAutoLocateMapView)
@@ -67,8 +123,11 @@ void UMapRendererComponent::DrawToCanvas(UCanvas* Canvas)
 	FVector2D MapTopLeft, MapSize;
 	ComputeCanvasRect(Canvas, MapTopLeft, MapSize);
 
-	// Render all minimap elements to the canvas
-	RenderToCanvas(Canvas, MapTopLeft, MapSize);
+	// Render all minimap elements to the canvas, or show them from the render target
+	if (bRenderToTarget)
+		DrawRenderTargetToCanvas(Canvas, MapTopLeft, MapSize);
+	else
+		RenderToCanvas(Canvas, MapTopLeft, MapSize);
 
 	// Remember the canvas for click events
 	LastCanvas = Canvas;
@@ -79,6 +138,19 @@ bool UMapRendererComponent::HandleClick(const FVector2D& ScreenPosition, const b
 	if (!bIsRendered)
 		return false;
 
+	// Clusters are drawn on top of the icons of their layer, so they take the click first
+	if (IconClusters.IsValidIndex(HoveringCluster))
+	{
+		const FMapIconCluster& Cluster = IconClusters[HoveringCluster];
+		TArray<UMapIconComponent*> ClusterMapIcons;
+		ClusterMapIcons.Reserve(Cluster.NumIcons);
+		for (int32 i = Cluster.FirstIcon; i < Cluster.FirstIcon + Cluster.NumIcons; ++i)
+			if (IsValid(ClusteredIcons[i]))
+				ClusterMapIcons.Add(ClusteredIcons[i]);
+		OnIconClusterClicked.Broadcast(ClusterMapIcons, bIsLeftMouseButton);
+		return true;
+	}
+
 	// If player is hovering over any icons (this is cached), fire
 	// icon click events and then return that the click has been handled
 	if (HoveringIcons.Num() > 0)
@@ -122,8 +194,48 @@ bool UMapRendererComponent::HandleClick(const FVector2D& ScreenPosition, const b
 	return false;
 }
 
+bool UMapRendererComponent::HandleRenderTargetClick(const FVector2D& UV, const bool bIsLeftMouseButton)
+{
+	if (!bIsRendered || !bRenderToTarget || !MapView)
+		return false;
+
+	// Convert render target position to minimap position
+	FVector2D RenderRegionTopLeft, RenderRegionSize;
+	ComputeRenderRegion(FVector2D::ZeroVector, FVector2D(RenderTargetResolution), RenderRegionTopLeft, RenderRegionSize);
+	if (RenderRegionSize.X <= 0 || RenderRegionSize.Y <= 0)
+		return false;
+	const FVector2D MapUV = (UV * FVector2D(RenderTargetResolution) - RenderRegionTopLeft) / RenderRegionSize;
+	if (!UMapFunctionLibrary::DetectIsInView(MapUV, FVector2D::ZeroVector, bIsCircular))
+		return false;
+
+	FVector WorldPos;
+	MapView->DeprojectViewToWorld(MapUV.X, MapUV.Y, WorldPos);
+	OnMapClicked.Broadcast(WorldPos, bIsLeftMouseButton);
+	return true;
+}
+
 void UMapRendererComponent::SetMapView(UMapViewComponent* InMapView)
 {
+	if (InMapView == MapView)
+		return;
+
+	// Icons rendered in the old view are no longer rendered by this renderer
+	if (MapView)
+	{
+		for (UMapIconComponent* MapIcon : PreviousIconCandidates)
+		{
+			if (!IsValid(MapIcon))
+				continue;
+			MapIcon->MarkRenderedInView(MapView, false);
+			MarkOnHoverEnd(MapIcon);
+		}
+	}
+	PreviousIconCandidates.Empty();
+	IconClusters.Empty();
+	ClusteredIcons.Empty();
+	HoveringCluster = INDEX_NONE;
+	bIconDrawListsValid = false;
+
 	MapView = InMapView;
 }
 
@@ -179,6 +291,64 @@ FLinearColor UMapRendererComponent::GetBackgroundFillColor() const
 	return BackgroundFillColor;
 }
 
+void UMapRendererComponent::InvalidateStaticLayer()
+{
+	bStaticLayerValid = false;
+}
+
+void UMapRendererComponent::SetRenderToTarget(const bool bNewRenderToTarget)
+{
+	bRenderToTarget = bNewRenderToTarget;
+	bRenderTargetOnCanvas = false;
+	UpdateTickGroup();
+}
+
+void UMapRendererComponent::UpdateTickGroup()
+{
+	// Tick after everything moved when rendering to the render target, so that it shows the current frame.
+	// Renderers that draw to the HUD only fire hover events and update the static layer in tick, which can happen earlier.
+	SetTickGroup(bRenderToTarget ? TG_PostUpdateWork : TG_DuringPhysics);
+}
+
+UTextureRenderTarget2D* UMapRendererComponent::GetRenderTarget() const
+{
+	return RenderTarget;
+}
+
+void UMapRendererComponent::UpdateRenderTarget()
+{
+	if (!MapTracker || !MapView || RenderTargetResolution.X <= 0 || RenderTargetResolution.Y <= 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_MinimapUpdateRenderTarget);
+
+	if (!RenderTarget)
+		RenderTarget = UKismetRenderingLibrary::CreateRenderTarget2D(this, RenderTargetResolution.X, RenderTargetResolution.Y, RTF_RGBA8, RenderTargetClearColor);
+	else if (RenderTarget->SizeX != RenderTargetResolution.X || RenderTarget->SizeY != RenderTargetResolution.Y)
+		RenderTarget->ResizeTarget(RenderTargetResolution.X, RenderTargetResolution.Y);
+	if (!RenderTarget)
+		return;
+	UKismetRenderingLibrary::ClearRenderTarget2D(this, RenderTarget, RenderTargetClearColor);
+
+	// The world has a single canvas for drawing to render targets, so nothing drawn below may draw to another render target.
+	// The static layer and icon atlas were updated earlier in the tick for that reason.
+	UCanvas* TargetCanvas;
+	FVector2D TargetCanvasSize;
+	FDrawToRenderTargetContext RenderContext;
+	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(this, RenderTarget, TargetCanvas, TargetCanvasSize, RenderContext);
+	bRenderingToTarget = true;
+	RenderToCanvas(TargetCanvas, FVector2D::ZeroVector, FVector2D(RenderTargetResolution));
+	bRenderingToTarget = false;
+	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(this, RenderContext);
+
+	LastRenderTargetUpdateTime = GetWorld()->GetRealTimeSeconds();
+}
+
+int32 UMapRendererComponent::GetNumDroppedIcons() const
+{
+	return NumDroppedIcons;
+}
+
 void UMapRendererComponent::SetHorizontalAlignment(EHorizontalAlignment InHorizontalAlignment)
 {
 	HorizontalAlignment = InHorizontalAlignment;
@@ -203,27 +373,37 @@ void UMapRendererComponent::SetSize(const int32 Width, const int32 Height)
 	Size.Y = Height;
 }
 
-inline static bool MapIconZSortPredicate(const UMapIconComponent& A, const UMapIconComponent& B)
+void UMapRendererComponent::AutoRelocateMapView()
 {
-     return A.GetIconZOrder() < B.GetIconZOrder();
-}
+	bMapViewSearchPending = false;
+	UMapViewComponent* NewMapView = UMapFunctionLibrary::FindMapView(this, AutoLocateMapView);
+	if (NewMapView)
+		SetMapView(NewMapView);
+	if (!MapTracker)
+		return;
 
-inline static bool MapBackgroundZSortPredicate(const AMapBackground& A, const AMapBackground& B)
-{
-     return A.GetBackgroundZOrder() < B.GetBackgroundZOrder();
+	// Search again whenever a view registers, until one is found
+	if (NewMapView || AutoLocateMapView == EMapViewSearchOption::Disabled)
+		MapTracker->OnMapViewRegistered.RemoveDynamic(this, &UMapRendererComponent::OnMapViewRegistered);
+	else
+		MapTracker->OnMapViewRegistered.AddUniqueDynamic(this, &UMapRendererComponent::OnMapViewRegistered);
 }
 
-void UMapRendererComponent::AutoRelocateMapView()
+void UMapRendererComponent::OnMapViewRegistered(UMapViewComponent* RegisteredMapView)
 {
-	UMapViewComponent* NewMapView = UMapFunctionLibrary::FindMapView(this, AutoLocateMapView);
-	if (NewMapView)
+	// A view was set manually in the meantime
+	if (MapView)
 	{
-		SetMapView(NewMapView);
+		MapTracker->OnMapViewRegistered.RemoveDynamic(this, &UMapRendererComponent::OnMapViewRegistered);
+		return;
 	}
-	else
+
+	// A pawn's view registers when the pawn begins play, which is before it is possessed and thus found as the player's view.
+	// Searching on the next tick also combines views registering in bulk into a single search.
+	if (!bMapViewSearchPending)
 	{
-		FTimerHandle RetryHandle;
-		GetOwner()->GetWorldTimerManager().SetTimer(RetryHandle, this, &UMapRendererComponent::AutoRelocateMapView, 0.2f);
+		bMapViewSearchPending = true;
+		GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UMapRendererComponent::AutoRelocateMapView);
 	}
 }
 
@@ -353,103 +533,171 @@ void UMapRendererComponent::RenderToCanvas(UCanvas* Canvas, const FVector2D& Map
 	FVector2D RenderRegionTopLeft, RenderRegionSize;
 	ComputeRenderRegion(MapTopLeft, MapSize, RenderRegionTopLeft, RenderRegionSize);
 	
+	// Record the icon layers, unless the ones recorded recently can still be used
+	RefreshIconDrawLists(RenderRegionTopLeft, RenderRegionSize);
+	const float InterpolationAlpha = bInterpolatingIconDrawLists ? FMath::Clamp((GetWorld()->GetRealTimeSeconds() - LastIconRefreshTime) * IconRefreshRate, 0.0f, 1.0f) : 1.0f;
+
+	// Advance icon material animations, once per material instance however many draws use it
+	const float Time = GetWorld()->GetTimeSeconds();
+	for (int32 i = 0; i < IconDrawListMaterialInstances.Num(); ++i)
+		IconDrawListMaterialInstances[i]->SetScalarParameterValue(TEXT("Time"), Time + IconDrawListTimeOffsets[i]);
+
 	// Draw layers from back to front
 	DrawBackground(Canvas, RenderRegionTopLeft, RenderRegionSize);
-	DrawIcons(Canvas, RenderRegionTopLeft, RenderRegionSize, false);
+	DrawIconDrawList(Canvas, IconDrawLists[EMapIconDrawLayer::UnderFog], InterpolationAlpha);
 	DrawFog(Canvas, RenderRegionTopLeft, RenderRegionSize);
-	DrawIcons(Canvas, RenderRegionTopLeft, RenderRegionSize, true);
+	DrawIconTrails(Canvas, RenderRegionTopLeft, RenderRegionSize);
+	DrawIconDrawList(Canvas, IconDrawLists[EMapIconDrawLayer::AboveFog], InterpolationAlpha);
+	DrawIconDrawList(Canvas, IconDrawLists[EMapIconDrawLayer::ObjectiveArrows], InterpolationAlpha);
 	DrawBoundary(Canvas, RenderRegionTopLeft, RenderRegionSize);
 	DrawFrustum(Canvas, RenderRegionTopLeft, RenderRegionSize);
 }
 
+void UMapRendererComponent::DrawRenderTargetToCanvas(UCanvas* Canvas, const FVector2D& MapTopLeft, const FVector2D& MapSize)
+{
+	bRenderTargetOnCanvas = false;
+	if (!RenderTarget || !bIsRendered)
+		return;
+
+	// Only draw the part of the render target that contains the map, so that clicks map to the same world positions as without it
+	FVector2D RenderRegionTopLeft, RenderRegionSize;
+	ComputeRenderRegion(MapTopLeft, MapSize, RenderRegionTopLeft, RenderRegionSize);
+	FVector2D TargetRegionTopLeft, TargetRegionSize;
+	ComputeRenderRegion(FVector2D::ZeroVector, FVector2D(RenderTargetResolution), TargetRegionTopLeft, TargetRegionSize);
+	const FVector2D TargetSize(RenderTarget->SizeX, RenderTarget->SizeY);
+	Canvas->K2_DrawTexture(RenderTarget, RenderRegionTopLeft, RenderRegionSize, TargetRegionTopLeft / TargetSize, TargetRegionSize / TargetSize, FLinearColor::White, EBlendMode::BLEND_Opaque);
+
+	bRenderTargetOnCanvas = true;
+	RenderTargetCanvasTopLeft = RenderRegionTopLeft;
+	RenderTargetCanvasSize = RenderRegionSize;
+}
+
+float UMapRendererComponent::GetIconDPIScale() const
+{
+	return bRenderingToTarget ? 1.0f : UWidgetLayoutLibrary::GetViewportScale(this);
+}
+
 void UMapRendererComponent::DrawBackground(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize)
 {
-	const FVector2D RenderRegionCenter = RenderRegionTopLeft + 0.5f * RenderRegionSize;
-	const FVector2D RenderRegionBottomRight = RenderRegionTopLeft + RenderRegionSize;
+	TArray<FMapBackgroundDrawItem> Items;
+	GatherBackgroundDrawItems(Items);
 
-	// Draw opaque base background
-	if (FillMaterialInstance && BackgroundFillColor.A > 0)
+	const FIntPoint LayerSize(FMath::RoundToInt(RenderRegionSize.X), FMath::RoundToInt(RenderRegionSize.Y));
+	if (!CanCacheStaticLayer() || LayerSize.X <= 0 || LayerSize.Y <= 0)
 	{
-		TArray<FVector2D> CornerUVs;
-		CornerUVs.Add(FVector2D(0, 0));
-		CornerUVs.Add(FVector2D(1, 0));
-		CornerUVs.Add(FVector2D(1, 1));
-		CornerUVs.Add(FVector2D(0, 1));
+		StaticLayerRequestedSize = FIntPoint::ZeroValue;
+		DrawBackgroundItems(Canvas, RenderRegionTopLeft, RenderRegionSize, Items);
+		return;
+	}
 
-		// Prepare background triangles
-		FCanvasUVTri Tri1;
-		Tri1.V0_Pos = RenderRegionTopLeft;
-		Tri1.V1_Pos = RenderRegionTopLeft + FVector2D(RenderRegionSize.X, 0);
-		Tri1.V2_Pos = RenderRegionTopLeft + FVector2D(0, RenderRegionSize.Y);
-		Tri1.V0_UV = CornerUVs[0];
-		Tri1.V1_UV = CornerUVs[1];
-		Tri1.V2_UV = CornerUVs[3];
-		Tri1.V0_Color = BackgroundFillColor;
-		Tri1.V1_Color = BackgroundFillColor;
-		Tri1.V2_Color = BackgroundFillColor;
+	// The corner UVs capture the view's location, rotation and zoom, so an unchanged item list means an unchanged image
+	const bool bSizeChanged = !StaticLayerRenderTarget || StaticLayerRenderTarget->SizeX != LayerSize.X || StaticLayerRenderTarget->SizeY != LayerSize.Y;
+	if (bStaticLayerValid && !bSizeChanged && StaticLayerFillColor == BackgroundFillColor && StaticLayerItems == Items)
+	{
+		Canvas->K2_DrawTexture(StaticLayerRenderTarget, RenderRegionTopLeft, RenderRegionSize, FVector2D::ZeroVector, FVector2D::UnitVector, FLinearColor::White, EBlendMode::BLEND_Opaque);
+		return;
+	}
 
-		FCanvasUVTri Tri2;
-		Tri2.V0_Pos = RenderRegionTopLeft + FVector2D(RenderRegionSize.X, 0);
-		Tri2.V1_Pos = RenderRegionTopLeft + FVector2D(0, RenderRegionSize.Y);
-		Tri2.V2_Pos = RenderRegionTopLeft + RenderRegionSize;
-		Tri2.V0_UV = CornerUVs[1];
-		Tri2.V1_UV = CornerUVs[3];
-		Tri2.V2_UV = CornerUVs[2];
-		Tri2.V0_Color = BackgroundFillColor;
-		Tri2.V1_Color = BackgroundFillColor;
-		Tri2.V2_Color = BackgroundFillColor;
+	// The canvas may be drawing to a render target already, so the layer is redrawn at the next tick instead of here
+	DrawBackgroundItems(Canvas, RenderRegionTopLeft, RenderRegionSize, Items);
+	StaticLayerRequestedSize = LayerSize;
+	StaticLayerRequestedItems = MoveTemp(Items);
+}
 
-		// Push clip parameters and render background
-		FillMaterialInstance->SetVectorParameterValue(TEXT("ClipInfo"), FLinearColor(RenderRegionCenter.X, RenderRegionCenter.Y, RenderRegionSize.X, !bIsCircular ? RenderRegionSize.Y : -1));
-		Canvas->K2_DrawMaterialTriangle(FillMaterialInstance, { Tri1, Tri2 });
-	}
+bool UMapRendererComponent::CanCacheStaticLayer() const
+{
+	// Without an opaque fill, parts of the render region are transparent, which the render target can't reproduce
+	return bCacheStaticLayer && !bIsCircular && FillMaterialInstance && BackgroundFillColor.A >= 1.0f;
+}
 
+void UMapRendererComponent::GatherBackgroundDrawItems(TArray<FMapBackgroundDrawItem>& OutItems)
+{
 	// Collect rendered backgrounds
 	bool bUsingPriorityBackground;
 	const int32 ActiveBackgroundPriority = MapView->GetActiveBackgroundPriority(bUsingPriorityBackground);
-	const TArray<AMapBackground*> MapBackgrounds = MapTracker->GetMapBackgrounds();
-	TArray<AMapBackground*> ShownMapBackgrounds;
-	for (AMapBackground* MapBackground : MapBackgrounds)
+	// The tracker keeps the backgrounds sorted back to front
+	for (AMapBackground* MapBackground : MapTracker->GetMapBackgroundsInDrawOrder())
 	{
 		UTexture* BackgroundTexture = MapBackground->GetBackgroundTexture();
 		if (!BackgroundTexture)
 			continue;
 		if (!MapBackground->IsBackgroundVisible() || (bUsingPriorityBackground && MapBackground->GetBackgroundPriority() != ActiveBackgroundPriority))
 			continue;
-		ShownMapBackgrounds.Add(MapBackground);
-	}
 
-	// Sort rendered backgrounds back to front
-	ShownMapBackgrounds.Sort(MapBackgroundZSortPredicate);
-	
-	// Draw backgrounds back to front
-	for (AMapBackground* MapBackground : ShownMapBackgrounds)
-	{
 		// Compute UV coordinates of visible part of the background. Skip if map view doesn't intersect the area.
 		TArray<FVector2D> CornerUVs;
 		if (!MapBackground->GetMapViewCornerUVs(MapView, CornerUVs))
 			continue;
-		
+
 		// Retrieve the material used to render the background. Skip if no material is set.
 		UMaterialInstanceDynamic* MatInst = MapBackground->GetBackgroundMaterialInstanceForCanvas(this);
 		if (!MatInst)
-			return;
+			continue;
 
 		// If this is a multi-level background, refresh the active texture
+		UTexture* Texture = MapBackground->GetBackgroundTexture();
 		if (MapBackground->IsMultiLevel())
 		{
 			const int32 Level = MapView->GetActiveBackgroundLevel(MapBackground);
-			MatInst->SetTextureParameterValue(TEXT("Texture"), MapBackground->GetBackgroundTexture(Level));
+			Texture = MapBackground->GetBackgroundTexture(Level);
+			MatInst->SetTextureParameterValue(TEXT("Texture"), Texture);
 		}
 
+		FMapBackgroundDrawItem& Item = OutItems.AddDefaulted_GetRef();
+		Item.MaterialInstance = MatInst;
+		Item.Texture = Texture;
+		for (int32 i = 0; i < 4; ++i)
+			Item.CornerUVs[i] = CornerUVs[i];
+	}
+}
+
+void UMapRendererComponent::DrawBackgroundItems(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize, const TArray<FMapBackgroundDrawItem>& Items)
+{
+	const FVector2D RenderRegionCenter = RenderRegionTopLeft + 0.5f * RenderRegionSize;
+	const FLinearColor ClipInfo(RenderRegionCenter.X, RenderRegionCenter.Y, RenderRegionSize.X, !bIsCircular ? RenderRegionSize.Y : -1);
+
+	// Draw opaque base background
+	if (FillMaterialInstance && BackgroundFillColor.A > 0)
+	{
 		// Prepare background triangles
 		FCanvasUVTri Tri1;
 		Tri1.V0_Pos = RenderRegionTopLeft;
 		Tri1.V1_Pos = RenderRegionTopLeft + FVector2D(RenderRegionSize.X, 0);
 		Tri1.V2_Pos = RenderRegionTopLeft + FVector2D(0, RenderRegionSize.Y);
-		Tri1.V0_UV = CornerUVs[0];
-		Tri1.V1_UV = CornerUVs[1];
-		Tri1.V2_UV = CornerUVs[3];
+		Tri1.V0_UV = FVector2D(0, 0);
+		Tri1.V1_UV = FVector2D(1, 0);
+		Tri1.V2_UV = FVector2D(0, 1);
+		Tri1.V0_Color = BackgroundFillColor;
+		Tri1.V1_Color = BackgroundFillColor;
+		Tri1.V2_Color = BackgroundFillColor;
+
+		FCanvasUVTri Tri2;
+		Tri2.V0_Pos = RenderRegionTopLeft + FVector2D(RenderRegionSize.X, 0);
+		Tri2.V1_Pos = RenderRegionTopLeft + FVector2D(0, RenderRegionSize.Y);
+		Tri2.V2_Pos = RenderRegionTopLeft + RenderRegionSize;
+		Tri2.V0_UV = FVector2D(1, 0);
+		Tri2.V1_UV = FVector2D(0, 1);
+		Tri2.V2_UV = FVector2D(1, 1);
+		Tri2.V0_Color = BackgroundFillColor;
+		Tri2.V1_Color = BackgroundFillColor;
+		Tri2.V2_Color = BackgroundFillColor;
+
+		// Push clip parameters and render background
+		FillMaterialInstance->SetVectorParameterValue(TEXT("ClipInfo"), ClipInfo);
+		Canvas->K2_DrawMaterialTriangle(FillMaterialInstance, { Tri1, Tri2 });
+	}
+
+	// Draw backgrounds back to front
+	for (const FMapBackgroundDrawItem& Item : Items)
+	{
+		// Prepare background triangles
+		FCanvasUVTri Tri1;
+		Tri1.V0_Pos = RenderRegionTopLeft;
+		Tri1.V1_Pos = RenderRegionTopLeft + FVector2D(RenderRegionSize.X, 0);
+		Tri1.V2_Pos = RenderRegionTopLeft + FVector2D(0, RenderRegionSize.Y);
+		Tri1.V0_UV = Item.CornerUVs[0];
+		Tri1.V1_UV = Item.CornerUVs[1];
+		Tri1.V2_UV = Item.CornerUVs[3];
 		Tri1.V0_Color = FLinearColor::White;
 		Tri1.V1_Color = FLinearColor::White;
 		Tri1.V2_Color = FLinearColor::White;
@@ -458,19 +706,54 @@ void UMapRendererComponent::DrawBackground(UCanvas* Canvas, const FVector2D& Ren
 		Tri2.V0_Pos = RenderRegionTopLeft + FVector2D(RenderRegionSize.X, 0);
 		Tri2.V1_Pos = RenderRegionTopLeft + FVector2D(0, RenderRegionSize.Y);
 		Tri2.V2_Pos = RenderRegionTopLeft + RenderRegionSize;
-		Tri2.V0_UV = CornerUVs[1];
-		Tri2.V1_UV = CornerUVs[3];
-		Tri2.V2_UV = CornerUVs[2];
+		Tri2.V0_UV = Item.CornerUVs[1];
+		Tri2.V1_UV = Item.CornerUVs[3];
+		Tri2.V2_UV = Item.CornerUVs[2];
 		Tri2.V0_Color = FLinearColor::White;
 		Tri2.V1_Color = FLinearColor::White;
 		Tri2.V2_Color = FLinearColor::White;
 
 		// Render background using material
-		MatInst->SetVectorParameterValue(TEXT("ClipInfo"), FLinearColor(RenderRegionCenter.X, RenderRegionCenter.Y, RenderRegionSize.X, !bIsCircular ? RenderRegionSize.Y : -1));
-		Canvas->K2_DrawMaterialTriangle(MatInst, { Tri1, Tri2 });
+		Item.MaterialInstance->SetVectorParameterValue(TEXT("ClipInfo"), ClipInfo);
+		Canvas->K2_DrawMaterialTriangle(Item.MaterialInstance, { Tri1, Tri2 });
 	}
 }
 
+void UMapRendererComponent::UpdateStaticLayer()
+{
+	const FIntPoint LayerSize = StaticLayerRequestedSize;
+	if (LayerSize.X <= 0 || LayerSize.Y <= 0 || !CanCacheStaticLayer())
+		return;
+
+	// Wait for the backgrounds to hold still since the last draw, rather than redrawing a layer that is outdated again when drawn
+	TArray<FMapBackgroundDrawItem> Items;
+	GatherBackgroundDrawItems(Items);
+	if (Items != StaticLayerRequestedItems)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_MinimapDrawStaticLayer);
+
+	if (!StaticLayerRenderTarget)
+		StaticLayerRenderTarget = UKismetRenderingLibrary::CreateRenderTarget2D(this, LayerSize.X, LayerSize.Y, RTF_RGBA8, BackgroundFillColor);
+	else if (StaticLayerRenderTarget->SizeX != LayerSize.X || StaticLayerRenderTarget->SizeY != LayerSize.Y)
+		StaticLayerRenderTarget->ResizeTarget(LayerSize.X, LayerSize.Y);
+	if (!StaticLayerRenderTarget)
+		return;
+
+	UCanvas* LayerCanvas;
+	FVector2D LayerCanvasSize;
+	FDrawToRenderTargetContext RenderContext;
+	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(this, StaticLayerRenderTarget, LayerCanvas, LayerCanvasSize, RenderContext);
+	DrawBackgroundItems(LayerCanvas, FVector2D::ZeroVector, FVector2D(LayerSize), Items);
+	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(this, RenderContext);
+
+	StaticLayerItems = MoveTemp(Items);
+	StaticLayerFillColor = BackgroundFillColor;
+	bStaticLayerValid = true;
+	StaticLayerRequestedSize = FIntPoint::ZeroValue;
+	StaticLayerRequestedItems.Reset();
+}
+
 void UMapRendererComponent::DrawFog(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize)
 {
 	const TArray<AMapFog*> MapFogs = MapTracker->GetMapFogs();
@@ -516,12 +799,228 @@ void UMapRendererComponent::DrawFog(UCanvas* Canvas, const FVector2D& RenderRegi
 	}
 }
 
-void UMapRendererComponent::DrawIcons(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize, const bool bAboveFog)
+void UMapRendererComponent::UpdatePreviousIconCandidates(const TArray<int32>& IconCandidates)
 {
-	// Not using #define here because it may interfere with end user #defines.
-	const float DPIScale = UWidgetLayoutLibrary::GetViewportScale(this);
-	static const float ICONSIZE_TO_INNERRADIUS = 0.5f;
-	static const float ICONSIZE_TO_OUTERRADIUS = 0.5f * FMath::Sqrt(2.0f);
+	// Icons that were candidates last refresh but aren't anymore have left the view
+	const TArray<UMapIconComponent*>& MapIcons = MapTracker->GetMapIcons();
+	TSet<UMapIconComponent*> NewIconCandidates;
+	NewIconCandidates.Reserve(IconCandidates.Num());
+	for (const int32 Index : IconCandidates)
+		NewIconCandidates.Add(MapIcons[Index]);
+	for (UMapIconComponent* MapIcon : PreviousIconCandidates)
+	{
+		if (!IsValid(MapIcon) || NewIconCandidates.Contains(MapIcon))
+			continue;
+		MapIcon->MarkRenderedInView(MapView, false);
+		MarkOnHoverEnd(MapIcon);
+	}
+	PreviousIconCandidates = MoveTemp(NewIconCandidates);
+}
+
+void UMapRendererComponent::RefreshIconDrawLists(const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize)
+{
+	// Icons are positioned relative to the live backgrounds, so any change to the map's placement requires a refresh
+	float ViewExtentX, ViewExtentY;
+	MapView->GetViewExtent(ViewExtentX, ViewExtentY);
+	const FTransform& ViewTransform = MapView->GetComponentTransform();
+	const bool bMapMoved = !ViewTransform.Equals(LastIconRefreshViewTransform) || FVector2D(ViewExtentX, ViewExtentY) != LastIconRefreshViewExtent
+		|| RenderRegionTopLeft != LastIconRefreshRegionTopLeft || RenderRegionSize != LastIconRefreshRegionSize;
+
+	const float Now = GetWorld()->GetRealTimeSeconds();
+	if (bIconDrawListsValid && !bMapMoved && IconRefreshRate > 0.0f && Now - LastIconRefreshTime < 1.0f / IconRefreshRate)
+		return;
+
+	// Previous positions are only meaningful if they were computed for the same map placement
+	bInterpolatingIconDrawLists = bInterpolateIconPositions && IconRefreshRate > 0.0f && bIconDrawListsValid && !bMapMoved;
+	bIconDrawListsValid = true;
+	LastIconRefreshTime = Now;
+	LastIconRefreshViewTransform = ViewTransform;
+	LastIconRefreshViewExtent = FVector2D(ViewExtentX, ViewExtentY);
+	LastIconRefreshRegionTopLeft = RenderRegionTopLeft;
+	LastIconRefreshRegionSize = RenderRegionSize;
+
+	// Culling is shared with the other renderers of this view. Placement and hover are done per renderer on top of it.
+	const float DPIScale = GetIconDPIScale();
+	const float WorldToPixelRatio = 2.0f * ViewExtentX / RenderRegionSize.X;
+	const FMapViewIconCulling& IconCulling = MapView->CullIcons(MapTracker, DPIScale, WorldToPixelRatio, bParallelIconCulling);
+	UpdatePreviousIconCandidates(IconCulling.Candidates);
+
+	IconDrawListMaterialInstances.Reset();
+	IconDrawListTimeOffsets.Reset();
+	NewIconScreenPositions.Reset();
+	BuildIconDrawLists(RenderRegionTopLeft, RenderRegionSize, IconCulling);
+	Swap(IconScreenPositions, NewIconScreenPositions);
+}
+
+void UMapRendererComponent::ClusterIcons(const TArray<int32>& VisibleIcons, const float DPIScale, const float WorldToPixelRatio)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapClusterIcons);
+
+	IconClusters.Reset();
+	ClusteredIcons.Reset();
+	VisibleIconClusters.Reset();
+	HoveringCluster = INDEX_NONE;
+
+	// Choose a world cell size per category bucket, or zero if the category doesn't cluster at this zoom. Cell sizes are rounded
+	// up to a power of two, so that cells stay anchored in the world while the view moves and only change at certain zoom steps.
+	// Icons then only switch clusters when they cross a cell border, instead of clusters reshuffling every refresh.
+	float ViewExtentX, ViewExtentY;
+	MapView->GetViewExtent(ViewExtentX, ViewExtentY);
+	const float MaxViewExtent = FMath::Max(ViewExtentX, ViewExtentY);
+	TArray<float, TInlineAllocator<16>> BucketCellSizes;
+	bool bAnyBucketClusters = false;
+	for (int32 Bucket = 0; Bucket < MapTracker->GetNumIconCategoryBuckets(); ++Bucket)
+	{
+		const FMapIconCategorySettings& Settings = MapTracker->GetIconCategoryBucketSettings(Bucket);
+		float CellSize = 0.0f;
+		if (Settings.ClusterRadius > 0.0f && MaxViewExtent > Settings.MinClusterViewExtent)
+			CellSize = FMath::Pow(2.0f, FMath::CeilToFloat(FMath::Log2(FMath::Max(1.0f, Settings.ClusterRadius * DPIScale * WorldToPixelRatio))));
+		BucketCellSizes.Add(CellSize);
+		bAnyBucketClusters |= CellSize > 0.0f;
+	}
+	if (!bAnyBucketClusters)
+		return;
+
+	// Count the icons per cell. Only icons whose center is in view are clustered, which leaves objective arrows as they are.
+	struct FCell
+	{
+		int32 NumIcons = 0;
+		int32 Cluster = INDEX_NONE;
+	};
+	TMap<FIntVector, int32> CellIndices;
+	TArray<FCell> Cells;
+	TArray<int32> VisibleIconCells;
+	VisibleIconCells.Init(INDEX_NONE, VisibleIcons.Num());
+	const FMapIconRenderCache& Cache = MapTracker->GetIconRenderCache();
+	for (int32 VisibleIndex = 0; VisibleIndex < VisibleIcons.Num(); ++VisibleIndex)
+	{
+		const int32 Index = VisibleIcons[VisibleIndex];
+		const uint16 Bucket = Cache.CategoryBuckets[Index];
+		if (Bucket == FMapIconRenderCache::NoCategoryBucket || BucketCellSizes[Bucket] <= 0.0f)
+			continue;
+
+		float U, V;
+		MapView->GetViewCoordinates(FVector(Cache.Locations[Index], Cache.Heights[Index]), bIsCircular, U, V);
+		if (!UMapFunctionLibrary::DetectIsInView(FVector2D(U, V), FVector2D::ZeroVector, bIsCircular))
+			continue;
+
+		const FVector2D Cell = Cache.Locations[Index] / BucketCellSizes[Bucket];
+		const FIntVector CellKey(FMath::FloorToInt(Cell.X), FMath::FloorToInt(Cell.Y), Bucket);
+		const int32* ExistingCellIndex = CellIndices.Find(CellKey);
+		const int32 CellIndex = ExistingCellIndex ? *ExistingCellIndex : CellIndices.Add(CellKey, Cells.AddDefaulted());
+		++Cells[CellIndex].NumIcons;
+		VisibleIconCells[VisibleIndex] = CellIndex;
+	}
+
+	// Cells with enough icons become clusters. Their icons are stored in draw order, so the last one is the top-most.
+	VisibleIconClusters.Init(INDEX_NONE, VisibleIcons.Num());
+	for (int32 VisibleIndex = 0; VisibleIndex < VisibleIcons.Num(); ++VisibleIndex)
+	{
+		const int32 CellIndex = VisibleIconCells[VisibleIndex];
+		if (CellIndex == INDEX_NONE)
+			continue;
+		const int32 Index = VisibleIcons[VisibleIndex];
+		const FMapIconCategorySettings& Settings = MapTracker->GetIconCategoryBucketSettings(Cache.CategoryBuckets[Index]);
+		FCell& Cell = Cells[CellIndex];
+		if (Cell.NumIcons < FMath::Max(2, Settings.MinClusterSize))
+			continue;
+
+		if (Cell.Cluster == INDEX_NONE)
+		{
+			Cell.Cluster = IconClusters.AddDefaulted();
+			FMapIconCluster& NewCluster = IconClusters[Cell.Cluster];
+			NewCluster.UV = FVector2D::ZeroVector;
+			NewCluster.FirstIcon = ClusteredIcons.Num();
+			NewCluster.NumIcons = 0;
+			NewCluster.IconScale = Settings.ClusterIconScale;
+			NewCluster.ScreenPosition = FVector2D::ZeroVector;
+			NewCluster.ScreenRadius = 0.0f;
+			ClusteredIcons.AddZeroed(Cell.NumIcons);
+		}
+
+		FMapIconCluster& Cluster = IconClusters[Cell.Cluster];
+		float U, V;
+		MapView->GetViewCoordinates(FVector(Cache.Locations[Index], Cache.Heights[Index]), bIsCircular, U, V);
+		Cluster.UV += FVector2D(U, V);
+		Cluster.RepresentativeIndex = Index;
+		ClusteredIcons[Cluster.FirstIcon + Cluster.NumIcons++] = MapTracker->GetMapIcons()[Index];
+		VisibleIconClusters[VisibleIndex] = Cell.Cluster;
+	}
+
+	for (FMapIconCluster& Cluster : IconClusters)
+		Cluster.UV /= Cluster.NumIcons;
+	if (IconClusters.Num() == 0)
+		VisibleIconClusters.Reset();
+	SET_DWORD_STAT(STAT_MinimapIconClusters, IconClusters.Num());
+	SET_DWORD_STAT(STAT_MinimapClusteredIcons, ClusteredIcons.Num());
+}
+
+void UMapRendererComponent::ApplyIconBudget(const TArray<int32>& VisibleIcons)
+{
+	DroppedVisibleIcons.Reset();
+	NumDroppedIcons = 0;
+
+	int32 Budget = MaxIconsPerRefresh > 0 ? MaxIconsPerRefresh : MAX_int32;
+	if (IconRefreshBudgetMs > 0.0f && AverageIconBuildMicroseconds > 0.0f)
+		Budget = FMath::Min(Budget, FMath::Max(1, FMath::FloorToInt(1000.0f * IconRefreshBudgetMs / AverageIconBuildMicroseconds)));
+	if (Budget == MAX_int32)
+		return;
+
+	// Clusters already stand in for many icons, so they're always drawn. Icons merged into them don't count.
+	struct FRankedIcon
+	{
+		int32 VisibleIndex;
+		bool bObjectiveArrow;
+		float CategoryPriority;
+		int32 ZOrder;
+		float DistanceSquared;
+	};
+	TArray<FRankedIcon> RankedIcons;
+	Budget = FMath::Max(0, Budget - IconClusters.Num());
+	const FMapIconRenderCache& Cache = MapTracker->GetIconRenderCache();
+	const FVector2D ViewCenter(MapView->GetComponentLocation());
+	for (int32 VisibleIndex = 0; VisibleIndex < VisibleIcons.Num(); ++VisibleIndex)
+	{
+		if (VisibleIconClusters.Num() > 0 && VisibleIconClusters[VisibleIndex] != INDEX_NONE)
+			continue;
+		const int32 Index = VisibleIcons[VisibleIndex];
+		const uint16 Bucket = Cache.CategoryBuckets[Index];
+		FRankedIcon& RankedIcon = RankedIcons.AddDefaulted_GetRef();
+		RankedIcon.VisibleIndex = VisibleIndex;
+		RankedIcon.bObjectiveArrow = Cache.HasFlag(Index, EMapIconRenderFlags::ObjectiveArrowEnabled);
+		RankedIcon.CategoryPriority = Bucket != FMapIconRenderCache::NoCategoryBucket ? MapTracker->GetIconCategoryBucketSettings(Bucket).DrawPriority : 0.0f;
+		RankedIcon.ZOrder = Cache.ZOrders[Index];
+		RankedIcon.DistanceSquared = FVector2D::DistSquared(Cache.Locations[Index], ViewCenter);
+	}
+	if (RankedIcons.Num() <= Budget)
+		return;
+
+	RankedIcons.Sort([](const FRankedIcon& A, const FRankedIcon& B)
+	{
+		if (A.bObjectiveArrow != B.bObjectiveArrow)
+			return A.bObjectiveArrow;
+		if (A.CategoryPriority != B.CategoryPriority)
+			return A.CategoryPriority > B.CategoryPriority;
+		if (A.ZOrder != B.ZOrder)
+			return A.ZOrder > B.ZOrder;
+		return A.DistanceSquared < B.DistanceSquared;
+	});
+
+	DroppedVisibleIcons.Init(false, VisibleIcons.Num());
+	for (int32 Rank = Budget; Rank < RankedIcons.Num(); ++Rank)
+		DroppedVisibleIcons[RankedIcons[Rank].VisibleIndex] = true;
+	NumDroppedIcons = RankedIcons.Num() - Budget;
+}
+
+void UMapRendererComponent::BuildIconDrawLists(const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize, const FMapViewIconCulling& IconCulling)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapDrawIcons);
+
+	for (FMapIconDrawList& DrawList : IconDrawLists)
+		DrawList.Reset();
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	const float DPIScale = GetIconDPIScale();
 	
 	const FVector2D RenderRegionCenter = RenderRegionTopLeft + 0.5f * RenderRegionSize;
 	const FVector2D RenderRegionBottomRight = RenderRegionTopLeft + RenderRegionSize;
@@ -531,84 +1030,83 @@ void UMapRendererComponent::DrawIcons(UCanvas* Canvas, const FVector2D& RenderRe
 	if (FirstPC)
 		FirstPC->GetMousePosition(MousePosition.X, MousePosition.Y);
 
+	// In the render target, the cursor can only hover icons through where the HUD last showed it
+	if (bRenderingToTarget)
+	{
+		if (bRenderTargetOnCanvas && RenderTargetCanvasSize.X > 0 && RenderTargetCanvasSize.Y > 0)
+			MousePosition = RenderRegionTopLeft + (MousePosition - RenderTargetCanvasTopLeft) / RenderTargetCanvasSize * RenderRegionSize;
+		else
+			MousePosition = FVector2D(-BIG_NUMBER, -BIG_NUMBER);
+	}
+
 	// Determine icons in view
 	float ViewExtentX, ViewExtentY;
 	MapView->GetViewExtent(ViewExtentX, ViewExtentY);
 
+	// Placement reads the tracker's packed render cache. Components are only touched for icons that are drawn.
 	const TArray<UMapIconComponent*>& MapIcons = MapTracker->GetMapIcons();
+	const FMapIconRenderCache& Cache = MapTracker->GetIconRenderCache();
+
 	const FVector2D UVToPixelRatio = FVector2D::UnitVector / RenderRegionSize;
 	const float WorldToPixelRatio = 2.0f * ViewExtentX * UVToPixelRatio.X;
 	const float PixelToWorldRatio = 1.0f / WorldToPixelRatio;
-	TArray<UMapIconComponent*> MapIconsInView;
-	for (UMapIconComponent* MapIcon : MapIcons)
-	{
-		// Ignore hidden map icons
-		if (!MapIcon->IsIconVisible())
-			continue;
+	const FLinearColor ClipInfo(RenderRegionCenter.X, RenderRegionCenter.Y, RenderRegionSize.X, !bIsCircular ? RenderRegionSize.Y : -1);
 
-		// Ignore icon with invalid size
-		const float IconSize = MapIcon->GetIconSize() * (MapIcon->GetIconSizeUnit() == EIconSizeUnit::WorldSpace ? PixelToWorldRatio : DPIScale);
-		if (IconSize <= 0.0f)
-			continue;
+	UMapIconAtlas* IconAtlas = bBatchIconDraws && bUseIconAtlas ? MapTracker->GetIconAtlas() : nullptr;
 
-		// Ignore icon if no material set
-		if (!MapIcon->GetIconMaterialForCanvas() && !MapIcon->GetObjectiveArrowMaterialForCanvas())
-			continue;
+	// The view culled and sorted the icons. Apply what touches components here.
+	for (const int32 Index : IconCulling.Result.LeftView)
+	{
+		MapIcons[Index]->MarkRenderedInView(MapView, false);
+		MarkOnHoverEnd(MapIcons[Index]);
+	}
 
-		// Ignore icons that are on another layer with respect to fog
-		const EIconFogInteraction FogInteraction = MapIcon->GetIconFogInteraction();
-		if (bAboveFog && FogInteraction == EIconFogInteraction::AlwaysRenderUnderFog)
-			continue;
+	// Merge icons that are too close together to tell apart at this zoom
+	const TArray<int32>& VisibleIcons = IconCulling.Result.Visible;
+	ClusterIcons(VisibleIcons, DPIScale, WorldToPixelRatio);
 
-		// Do a fast check that eliminates most icons that aren't in the view
-		// Takes into account the icon's size
-		const float IconWorldRadius = IconSize * ICONSIZE_TO_OUTERRADIUS * WorldToPixelRatio;
-		if (!MapIcon->IsObjectiveArrowEnabled() && !MapView->ViewContains(MapIcon->GetComponentLocation(), IconWorldRadius))
+	// Leave out the lowest ranked icons if there are more than this renderer may draw
+	ApplyIconBudget(VisibleIcons);
+	SET_DWORD_STAT(STAT_MinimapDroppedIcons, NumDroppedIcons);
+	const double BuildStartTime = FPlatformTime::Seconds();
+
+	// Record icons in view
+	for (int32 VisibleIndex = 0; VisibleIndex < VisibleIcons.Num(); ++VisibleIndex)
+	{
+		const int32 Index = VisibleIcons[VisibleIndex];
+		UMapIconComponent* MapIcon = MapIcons[Index];
+		const bool bObjectiveArrowEnabled = Cache.HasFlag(Index, EMapIconRenderFlags::ObjectiveArrowEnabled);
+
+		// Clustered icons are in view, but only the top-most one is drawn, for the whole cluster
+		const int32 ClusterIndex = VisibleIconClusters.Num() > 0 ? VisibleIconClusters[VisibleIndex] : INDEX_NONE;
+		FMapIconCluster* Cluster = ClusterIndex != INDEX_NONE ? &IconClusters[ClusterIndex] : nullptr;
+		if (Cluster && Cluster->RepresentativeIndex != Index)
 		{
-			MapIcon->MarkRenderedInView(MapView, false);
+			MapIcon->MarkRenderedInView(MapView, true);
 			MarkOnHoverEnd(MapIcon);
 			continue;
 		}
-
-		// Eliminate icons that are in the same mult-level background volume, but not in the same level
-		if (!MapView->IsSameBackgroundLevel(MapIcon))
-			continue;
-		
-		// Check whether the icon is visible in the fog
-		if (MapTracker->HasMapFog())
+		if (DroppedVisibleIcons.Num() > 0 && DroppedVisibleIcons[VisibleIndex])
 		{
-			switch (FogInteraction)
-			{
-			case EIconFogInteraction::OnlyRenderWhenExplored:
-			case EIconFogInteraction::OnlyRenderWhenRevealing:
-				const FVector WorldLocation = MapIcon->GetComponentLocation();
-				const bool RequireCurrentlySeeing = FogInteraction == EIconFogInteraction::OnlyRenderWhenRevealing;
-				const float FogRevealThreshold = MapIcon->GetIconFogRevealThreshold();
-				bool bIsInsideFogVolume;
-				if (MapTracker->GetFogRevealedFactor(WorldLocation, RequireCurrentlySeeing, bIsInsideFogVolume) < FogRevealThreshold)
-					continue;
-				break;
-			}
+			MapIcon->MarkRenderedInView(MapView, false);
+			MarkOnHoverEnd(MapIcon);
+			continue;
 		}
 
-		// Icon passed all checks, schedule it for rendering
-		MapIconsInView.Add(MapIcon);
-	}
-
-	// Sort icons on ZOrder
-	MapIconsInView.Sort(MapIconZSortPredicate);
-
-	// Draw icons in view
-	for (UMapIconComponent* MapIcon : MapIconsInView)
-	{
 		// Compute view coordinates
 		float U, V, Yaw;
-		MapView->GetViewCoordinates(MapIcon->GetComponentLocation(), bIsCircular, U, V);
-		MapView->GetViewYaw(MapIcon->GetComponentRotation().Yaw, Yaw);
+		MapView->GetViewCoordinates(FVector(Cache.Locations[Index], Cache.Heights[Index]), bIsCircular, U, V);
+		MapView->GetViewYaw(Cache.Yaws[Index], Yaw);
 
 		// Compute icon radius. Icon is rectangular. For some purposes we use the inner radius,
 		// while for other purposes we use the outer radius that includes the corners.
-		float IconSize = MapIcon->GetIconSize() * (MapIcon->GetIconSizeUnit() == EIconSizeUnit::WorldSpace ? PixelToWorldRatio : DPIScale);
+		float IconSize = Cache.Sizes[Index] * (Cache.SizeUnits[Index] == EIconSizeUnit::WorldSpace ? PixelToWorldRatio : DPIScale);
+		if (Cluster)
+		{
+			U = Cluster->UV.X;
+			V = Cluster->UV.Y;
+			IconSize *= Cluster->IconScale;
+		}
 		float IconInnerRadius = IconSize * ICONSIZE_TO_INNERRADIUS;
 		float IconOuterRadius = IconSize * ICONSIZE_TO_OUTERRADIUS;
 
@@ -619,10 +1117,10 @@ void UMapRendererComponent::DrawIcons(UCanvas* Canvas, const FVector2D& RenderRe
 
 		// If icon should appear at border, update the UV coordinates
 		float EdgeYaw = 0.0f;
-		if (!IsWithinView && MapIcon->IsObjectiveArrowEnabled())
+		if (!IsWithinView && bObjectiveArrowEnabled)
 		{
 			// Use edge icon size instead
-			IconSize = MapIcon->GetObjectiveArrowSize() * DPIScale;
+			IconSize = Cache.ObjectiveArrowSizes[Index] * DPIScale;
 			IconInnerRadius = IconSize * ICONSIZE_TO_INNERRADIUS;
 			IconOuterRadius = IconSize * ICONSIZE_TO_OUTERRADIUS;
 
@@ -636,16 +1134,43 @@ void UMapRendererComponent::DrawIcons(UCanvas* Canvas, const FVector2D& RenderRe
 		}
 
 		// Retrieve icon texture (can be null), material (can be null) and color
-		const bool IsShowingEdgeIcon = !IsWithinView && MapIcon->GetObjectiveArrowTexture() != nullptr && MapIcon->IsObjectiveArrowEnabled();
-		UTexture* Icon = IsShowingEdgeIcon ? MapIcon->GetObjectiveArrowTexture() : MapIcon->GetIconTexture();
-		UMaterialInstanceDynamic* MatInst = IsShowingEdgeIcon ? MapIcon->GetObjectiveArrowMaterialInstanceForCanvas(this) : MapIcon->GetIconMaterialInstanceForCanvas(this);
-		if (!MatInst)
-			continue;;
+		const bool IsShowingEdgeIcon = !IsWithinView && Cache.ObjectiveArrowTextures[Index] != nullptr && bObjectiveArrowEnabled;
+		UTexture* Icon = IsShowingEdgeIcon ? Cache.ObjectiveArrowTextures[Index] : Cache.Textures[Index];
+		UMaterialInstanceDynamic* MatInst = nullptr;
+		UMaterialInterface* BatchMaterial = nullptr;
+		if (bBatchIconDraws)
+		{
+			// Like the icon's own material instances, the objective arrow falls back to the icon material
+			const uint16 ObjectiveArrowMaterialSlot = Cache.ObjectiveArrowMaterialSlots[Index];
+			const bool bUseObjectiveArrowMaterial = IsShowingEdgeIcon && ObjectiveArrowMaterialSlot != FMapIconRenderCache::NoMaterialSlot;
+			BatchMaterial = MapTracker->GetIconCanvasMaterial(bUseObjectiveArrowMaterial ? ObjectiveArrowMaterialSlot : Cache.MaterialSlots[Index]);
+			if (!BatchMaterial)
+				continue;
+		}
+		else
+		{
+			MatInst = IsShowingEdgeIcon ? MapIcon->GetObjectiveArrowMaterialInstanceForCanvas(this) : MapIcon->GetIconMaterialInstanceForCanvas(this);
+			if (!MatInst)
+				continue;
+		}
 
-		const FLinearColor& IconDrawColor = MapIcon->GetIconDrawColor();
+		const FLinearColor& IconDrawColor = Cache.DrawColors[Index];
+		const EMapIconDrawLayer::Type Layer = IsShowingEdgeIcon ? EMapIconDrawLayer::ObjectiveArrows
+			: Cache.FogInteractions[Index] == EIconFogInteraction::AlwaysRenderUnderFog ? EMapIconDrawLayer::UnderFog : EMapIconDrawLayer::AboveFog;
 		
 		// Finalize icon render position
 		const FVector2D IconScreenPos = RenderRegionTopLeft + FVector2D(U, V) * RenderRegionSize;
+		FVector2D PreviousPositionDelta = FVector2D::ZeroVector;
+		if (bInterpolatingIconDrawLists)
+		{
+			if (const FVector2D* PreviousScreenPos = IconScreenPositions.Find(MapIcon))
+				PreviousPositionDelta = *PreviousScreenPos - IconScreenPos;
+			NewIconScreenPositions.Add(MapIcon, IconScreenPos);
+		}
+		else if (bInterpolateIconPositions)
+		{
+			NewIconScreenPositions.Add(MapIcon, IconScreenPos);
+		}
 		const FVector2D IconScreenSize(IconSize, IconSize);
 		const FVector2D IconTopLeft = IconScreenPos - 0.5f * IconScreenSize;
 		
@@ -654,17 +1179,31 @@ void UMapRendererComponent::DrawIcons(UCanvas* Canvas, const FVector2D& RenderRe
 		if (IsShowingEdgeIcon)
 		{
 			// Make icon point towards world object
-			if (MapIcon->DoesObjectiveArrowRotate())
+			if (Cache.HasFlag(Index, EMapIconRenderFlags::ObjectiveArrowRotates))
 				RenderYaw = EdgeYaw;
 		}
 		else
 		{
 			// Apply relative rotation
-			if (MapIcon->DoesIconRotate())
+			if (Cache.HasFlag(Index, EMapIconRenderFlags::Rotates))
 				RenderYaw = Yaw;
 		}
 		
-		if (MapIcon->IsIconInteractable())
+		if (Cluster)
+		{
+			// Clusters can always be clicked, regardless of whether their icons are interactable
+			Cluster->ScreenPosition = IconScreenPos;
+			Cluster->ScreenRadius = 0.5f * IconSize;
+			if (FVector2D::DistSquared(MousePosition, IconScreenPos) < FMath::Square(Cluster->ScreenRadius))
+				HoveringCluster = ClusterIndex;
+			MarkOnHoverEnd(MapIcon);
+
+			FMapIconDrawList::FLabel& Label = IconDrawLists[Layer].Labels.AddDefaulted_GetRef();
+			Label.Position = IconScreenPos;
+			Label.PreviousPositionDelta = PreviousPositionDelta;
+			Label.Count = Cluster->NumIcons;
+		}
+		else if (Cache.HasFlag(Index, EMapIconRenderFlags::Interactable))
 		{
 			// Compute whether cursor is on icon
 			bool IsMouseOvering = false;
@@ -682,11 +1221,6 @@ void UMapRendererComponent::DrawIcons(UCanvas* Canvas, const FVector2D& RenderRe
 				MarkOnHoverEnd(MapIcon);
 		}
 		
-		// Push clip parameters
-		MatInst->SetTextureParameterValue(TEXT("Texture"), Icon);
-		MatInst->SetVectorParameterValue(TEXT("ClipInfo"), FLinearColor(RenderRegionCenter.X, RenderRegionCenter.Y, RenderRegionSize.X, !bIsCircular ? RenderRegionSize.Y : -1));
-		MatInst->SetVectorParameterValue(TEXT("Color"), IconDrawColor);
-		
 		// Compute rotated quad triangles. Since icons are square, we can compute the delta from center of
 		// one of the corners and then repeatedly rotate that delta by 90 degrees, which can be done
 		// by flipping the X and Y deltas.
@@ -709,11 +1243,305 @@ void UMapRendererComponent::DrawIcons(UCanvas* Canvas, const FVector2D& RenderRe
 		Tri2.V1_UV = FVector2D(0, 1);
 		Tri2.V2_UV = FVector2D(1, 1);
 
-		// Draw the material quad
-		Canvas->K2_DrawMaterialTriangle(MatInst, { Tri1, Tri2 });
+		if (BatchMaterial)
+		{
+			// Queue the quad with its color in the vertex colors, to be drawn along with icons sharing its material and texture
+			Tri1.V0_Color = Tri1.V1_Color = Tri1.V2_Color = IconDrawColor;
+			Tri2.V0_Color = Tri2.V1_Color = Tri2.V2_Color = IconDrawColor;
+			FMapIconBatchItem& BatchItem = IconBatchItems[Layer].AddDefaulted_GetRef();
+			BatchItem.ZOrder = Cache.ZOrders[Index];
+			BatchItem.Material = BatchMaterial;
+			BatchItem.Texture = Icon;
+			BatchItem.Triangles[0] = Tri1;
+			BatchItem.Triangles[1] = Tri2;
+			BatchItem.PreviousPositionDelta = PreviousPositionDelta;
+
+			// Draw from the texture's atlas page instead, so that icons batch regardless of texture. Textures that didn't fit are drawn as is,
+			// as are textures packed since the last tick, which aren't in their page yet.
+			const uint16 AtlasEntry = !IconAtlas ? UMapIconAtlas::NoEntry : IsShowingEdgeIcon ? Cache.ObjectiveArrowAtlasEntries[Index] : Cache.AtlasEntries[Index];
+			const FMapIconAtlasEntry* Entry = AtlasEntry != UMapIconAtlas::NoEntry ? &IconAtlas->GetEntry(AtlasEntry) : nullptr;
+			if (Entry && Entry->bDrawn)
+			{
+				BatchItem.Texture = IconAtlas->GetPage(Entry->Page);
+				for (FCanvasUVTri& Tri : BatchItem.Triangles)
+				{
+					Tri.V0_UV = Entry->UVMin + Tri.V0_UV * Entry->UVSize;
+					Tri.V1_UV = Entry->UVMin + Tri.V1_UV * Entry->UVSize;
+					Tri.V2_UV = Entry->UVMin + Tri.V2_UV * Entry->UVSize;
+				}
+			}
+			continue;
+		}
+
+		// Push clip parameters
+		MatInst->SetTextureParameterValue(TEXT("Texture"), Icon);
+		MatInst->SetVectorParameterValue(TEXT("ClipInfo"), ClipInfo);
+		MatInst->SetVectorParameterValue(TEXT("Color"), IconDrawColor);
+
+		// Record the material quad. The icon set the material's animation time relative to when its material was set.
+		const float MaterialTime = MatInst->K2_GetScalarParameterValue(TEXT("Time"));
+		FMapIconDrawList& DrawList = IconDrawLists[Layer];
+		FMapIconDrawList::FDraw& Draw = DrawList.AddDraw(MatInst);
+		Draw.Item.MaterialRenderProxy = MatInst->GetRenderProxy();
+		Draw.Item.TriangleList.Add(Tri1);
+		Draw.Item.TriangleList.Add(Tri2);
+		DrawList.PreviousPositionDeltas.Add(PreviousPositionDelta);
+		IconDrawListMaterialInstances.Add(MatInst);
+		IconDrawListTimeOffsets.Add(MaterialTime - Now);
+	}
+
+	if (bBatchIconDraws)
+	{
+		const int32 FirstBatchMaterialInstance = IconDrawListMaterialInstances.Num();
+		for (int32 Layer = 0; Layer < EMapIconDrawLayer::Num; ++Layer)
+			AddIconBatchesToDrawList(ClipInfo, IconBatchItems[Layer], FirstBatchMaterialInstance, IconDrawLists[Layer]);
+	}
+
+	// Measure the cost per drawn icon for the time budget. Small refreshes are too noisy to measure.
+	const int32 NumBuiltIcons = VisibleIcons.Num() - NumDroppedIcons - ClusteredIcons.Num() + IconClusters.Num();
+	if (NumBuiltIcons >= 32)
+	{
+		const float IconBuildMicroseconds = (FPlatformTime::Seconds() - BuildStartTime) * 1000000.0 / NumBuiltIcons;
+		AverageIconBuildMicroseconds = AverageIconBuildMicroseconds > 0.0f ? FMath::Lerp(AverageIconBuildMicroseconds, IconBuildMicroseconds, 0.25f) : IconBuildMicroseconds;
 	}
 }
 
+void UMapRendererComponent::AddIconBatchesToDrawList(const FLinearColor& ClipInfo, TArray<FMapIconBatchItem>& BatchItems, const int32 FirstBatchMaterialInstance, FMapIconDrawList& OutDrawList)
+{
+	// Icons were queued in draw order. Group them by material and texture within each z-order,
+	// keeping the draw order among icons that share both so that overlapping icons don't swap between frames.
+	BatchItems.StableSort([](const FMapIconBatchItem& A, const FMapIconBatchItem& B)
+	{
+		if (A.ZOrder != B.ZOrder)
+			return A.ZOrder < B.ZOrder;
+		if (A.Material != B.Material)
+			return reinterpret_cast<UPTRINT>(A.Material) < reinterpret_cast<UPTRINT>(B.Material);
+		return reinterpret_cast<UPTRINT>(A.Texture) < reinterpret_cast<UPTRINT>(B.Texture);
+	});
+
+	for (int32 First = 0; First < BatchItems.Num();)
+	{
+		// Find the run of icons that can be drawn together
+		const FMapIconBatchItem& FirstItem = BatchItems[First];
+		int32 End = First + 1;
+		while (End < BatchItems.Num() && BatchItems[End].ZOrder == FirstItem.ZOrder && BatchItems[End].Material == FirstItem.Material && BatchItems[End].Texture == FirstItem.Texture)
+			++End;
+
+		// Per-icon values are in the vertices, so parameters only need to be pushed once per batch. Batches run on the world clock.
+		UMaterialInstanceDynamic* MatInst = GetIconBatchMaterialInstance(FirstItem.Material, FirstItem.Texture);
+		MatInst->SetVectorParameterValue(TEXT("ClipInfo"), ClipInfo);
+
+		FMapIconDrawList::FDraw& Draw = OutDrawList.AddDraw(MatInst);
+		Draw.Item.MaterialRenderProxy = MatInst->GetRenderProxy();
+		for (int32 i = First; i < End; ++i)
+		{
+			Draw.Item.TriangleList.Append(BatchItems[i].Triangles, 2);
+			OutDrawList.PreviousPositionDeltas.Add(BatchItems[i].PreviousPositionDelta);
+		}
+
+		// The same material instance can batch icons in several z-orders and layers, but its time only needs to be set once
+		const int32 NumBatchMaterialInstances = IconDrawListMaterialInstances.Num() - FirstBatchMaterialInstance;
+		if (!MakeArrayView(IconDrawListMaterialInstances).Slice(FirstBatchMaterialInstance, NumBatchMaterialInstances).Contains(MatInst))
+		{
+			IconDrawListMaterialInstances.Add(MatInst);
+			IconDrawListTimeOffsets.Add(0.0f);
+		}
+
+		First = End;
+	}
+	BatchItems.Reset();
+}
+
+void UMapRendererComponent::DrawIconDrawList(UCanvas* Canvas, FMapIconDrawList& DrawList, const float InterpolationAlpha)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapDrawIconDrawList);
+
+	const float PreviousPositionWeight = 1.0f - InterpolationAlpha;
+	for (int32 DrawIndex = 0; DrawIndex < DrawList.NumDraws; ++DrawIndex)
+	{
+		FMapIconDrawList::FDraw& Draw = DrawList.Draws[DrawIndex];
+		if (PreviousPositionWeight <= 0.0f)
+		{
+			Canvas->DrawItem(Draw.Item);
+		}
+		else
+		{
+			// Both triangles of an icon move along with it. The moved triangles are swapped in for the draw only,
+			// since the recorded ones are interpolated from again next frame.
+			TArray<FCanvasUVTri>& Triangles = Draw.Item.TriangleList;
+			IconTriangleScratch.Reset();
+			IconTriangleScratch.Append(Triangles);
+			for (int32 i = 0; i < IconTriangleScratch.Num(); ++i)
+			{
+				const FVector2D Offset = PreviousPositionWeight * DrawList.PreviousPositionDeltas[Draw.FirstIcon + i / 2];
+				IconTriangleScratch[i].V0_Pos += Offset;
+				IconTriangleScratch[i].V1_Pos += Offset;
+				IconTriangleScratch[i].V2_Pos += Offset;
+			}
+			Swap(Triangles, IconTriangleScratch);
+			Canvas->DrawItem(Draw.Item);
+			Swap(Triangles, IconTriangleScratch);
+		}
+		INC_DWORD_STAT(STAT_MinimapIconDrawCalls);
+	}
+
+	if (DrawList.Labels.Num() == 0)
+		return;
+	UFont* Font = ClusterCountFont ? ClusterCountFont : GEngine->GetSmallFont();
+	const float DPIScale = GetIconDPIScale();
+	for (const FMapIconDrawList::FLabel& Label : DrawList.Labels)
+	{
+		const FVector2D Position = Label.Position + PreviousPositionWeight * Label.PreviousPositionDelta;
+		Canvas->K2_DrawText(Font, FString::FromInt(Label.Count), Position, FVector2D(DPIScale, DPIScale), ClusterCountColor,
+			0.0f, FLinearColor::Black, FVector2D::UnitVector, true, true, true, FLinearColor::Black);
+	}
+}
+
+UMaterialInstanceDynamic* UMapRendererComponent::GetIconBatchMaterialInstance(UMaterialInterface* Material, UTexture* Texture)
+{
+	UMaterialInstanceDynamic*& MatInst = IconBatchMaterialInstances.FindOrAdd(TPair<UMaterialInterface*, UTexture*>(Material, Texture));
+	if (!MatInst)
+	{
+		// Vertex colors carry the icon colors, so the color parameter is left neutral
+		MatInst = UMaterialInstanceDynamic::Create(Material, this);
+		MatInst->SetTextureParameterValue(TEXT("Texture"), Texture);
+		MatInst->SetVectorParameterValue(TEXT("Color"), FLinearColor::White);
+		IconBatchMaterialInstancePool.Add(MatInst);
+	}
+	return MatInst;
+}
+
+// Clips the segment from A to B to the render region. Returns false if no part of it is inside, otherwise the part from
+// OutTMin to OutTMax along the segment is.
+static bool ClipSegmentToRegion(const FVector2D& A, const FVector2D& B, const FVector2D& Center, const FVector2D& HalfSize, const bool bIsCircular, float& OutTMin, float& OutTMax)
+{
+	const FVector2D Delta = B - A;
+	OutTMin = 0.0f;
+	OutTMax = 1.0f;
+	if (bIsCircular)
+	{
+		// Solve |A + T * Delta - Center| = Radius for T
+		const FVector2D FromCenter = A - Center;
+		const float QA = Delta.SizeSquared();
+		const float QB = 2.0f * (FromCenter | Delta);
+		const float QC = FromCenter.SizeSquared() - FMath::Square(HalfSize.X);
+		if (QA < KINDA_SMALL_NUMBER)
+			return QC <= 0.0f;
+		const float Discriminant = QB * QB - 4.0f * QA * QC;
+		if (Discriminant < 0.0f)
+			return false;
+		const float Root = FMath::Sqrt(Discriminant);
+		OutTMin = FMath::Max(OutTMin, (-QB - Root) / (2.0f * QA));
+		OutTMax = FMath::Min(OutTMax, (-QB + Root) / (2.0f * QA));
+	}
+	else
+	{
+		// Narrow the segment to the slab between the region's edges along each axis
+		for (int32 Axis = 0; Axis < 2; ++Axis)
+		{
+			const float Start = A[Axis] - Center[Axis];
+			if (FMath::Abs(Delta[Axis]) < KINDA_SMALL_NUMBER)
+			{
+				if (FMath::Abs(Start) > HalfSize[Axis])
+					return false;
+				continue;
+			}
+			const float T0 = (-HalfSize[Axis] - Start) / Delta[Axis];
+			const float T1 = (HalfSize[Axis] - Start) / Delta[Axis];
+			OutTMin = FMath::Max(OutTMin, FMath::Min(T0, T1));
+			OutTMax = FMath::Min(OutTMax, FMath::Max(T0, T1));
+		}
+	}
+	return OutTMin < OutTMax;
+}
+
+void UMapRendererComponent::DrawIconTrails(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize)
+{
+	const TArray<UMapIconComponent*>& TrailMapIcons = MapTracker->GetTrailMapIcons();
+	if (!bDrawIconTrails || TrailMapIcons.Num() == 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_MinimapDrawIconTrails);
+
+	// All trails are drawn as one translucent triangle list, with the fade in the vertex colors
+	if (!TrailTriangleItem.IsSet())
+	{
+		TrailTriangleItem.Emplace(FVector2D::ZeroVector, FVector2D::ZeroVector, FVector2D::ZeroVector, GWhiteTexture);
+		TrailTriangleItem->BlendMode = SE_BLEND_Translucent;
+	}
+	TArray<FCanvasUVTri>& Triangles = TrailTriangleItem->TriangleList;
+	Triangles.Reset();
+
+	FMapViewSnapshot View;
+	MapView->GetViewSnapshot(View);
+	const FVector2D RenderRegionHalfSize = 0.5f * RenderRegionSize;
+	const FVector2D RenderRegionCenter = RenderRegionTopLeft + RenderRegionHalfSize;
+	const float DPIScale = GetIconDPIScale();
+	const float Now = GetWorld()->GetTimeSeconds();
+	const auto WorldToScreen = [&](const FVector& WorldLocation)
+	{
+		float U, V;
+		View.GetViewCoordinates(WorldLocation, U, V);
+		return RenderRegionTopLeft + FVector2D(U, V) * RenderRegionSize;
+	};
+
+	for (UMapIconComponent* MapIcon : TrailMapIcons)
+	{
+		// Trails are hidden along with their icon, for example by fog or a hidden category
+		if (!MapIcon || !MapIcon->IsRenderedInView(MapView))
+			continue;
+
+		const FMapIconTrail& Trail = MapIcon->GetTrail();
+		const FLinearColor Color = MapIcon->GetTrailColor();
+		const float Lifetime = MapIcon->GetTrailLifetime();
+		const float HalfWidth = 0.5f * MapIcon->GetTrailWidth() * DPIScale;
+		const float Height = MapIcon->GetComponentLocation().Z;
+
+		// Walk from the icon to the oldest point. The trail ends at the icon itself instead of at the last recorded point.
+		FVector2D Newer = WorldToScreen(MapIcon->GetComponentLocation());
+		float NewerAlpha = Color.A;
+		for (int32 Point = Trail.Num() - 1; Point >= 0 && NewerAlpha > 0.0f; --Point)
+		{
+			const float Fade = Lifetime > 0.0f ? 1.0f - (Now - Trail.GetTime(Point)) / Lifetime : float(Point + 1) / (Trail.Num() + 1);
+			const float OlderAlpha = Color.A * FMath::Max(0.0f, Fade);
+			const FVector2D Older = WorldToScreen(FVector(Trail.GetLocation(Point), Height));
+
+			float TMin, TMax;
+			if (ClipSegmentToRegion(Older, Newer, RenderRegionCenter, RenderRegionHalfSize, bIsCircular, TMin, TMax))
+			{
+				const FVector2D Start = FMath::Lerp(Older, Newer, TMin);
+				const FVector2D End = FMath::Lerp(Older, Newer, TMax);
+				const FVector2D Offset = HalfWidth * FVector2D(Start.Y - End.Y, End.X - Start.X).GetSafeNormal();
+				const FLinearColor StartColor(Color.R, Color.G, Color.B, FMath::Lerp(OlderAlpha, NewerAlpha, TMin));
+				const FLinearColor EndColor(Color.R, Color.G, Color.B, FMath::Lerp(OlderAlpha, NewerAlpha, TMax));
+
+				FCanvasUVTri& Tri1 = Triangles.AddDefaulted_GetRef();
+				Tri1.V0_Pos = Start - Offset;
+				Tri1.V1_Pos = Start + Offset;
+				Tri1.V2_Pos = End + Offset;
+				Tri1.V0_Color = StartColor;
+				Tri1.V1_Color = StartColor;
+				Tri1.V2_Color = EndColor;
+
+				FCanvasUVTri& Tri2 = Triangles.AddDefaulted_GetRef();
+				Tri2.V0_Pos = Start - Offset;
+				Tri2.V1_Pos = End + Offset;
+				Tri2.V2_Pos = End - Offset;
+				Tri2.V0_Color = StartColor;
+				Tri2.V1_Color = EndColor;
+				Tri2.V2_Color = EndColor;
+			}
+
+			Newer = Older;
+			NewerAlpha = OlderAlpha;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_MinimapIconTrailSegments, Triangles.Num() / 2);
+	if (Triangles.Num() > 0)
+		Canvas->DrawItem(TrailTriangleItem.GetValue());
+}
+
 void UMapRendererComponent::DrawBoundary(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize)
 {
 	const FVector2D RenderRegionCenter = RenderRegionTopLeft + 0.5f * RenderRegionSize;
@@ -722,20 +1550,21 @@ void UMapRendererComponent::DrawBoundary(UCanvas* Canvas, const FVector2D& Rende
 	// Draw boundary
 	if (bIsCircular)
 	{
-		// Draw circle boundary
-		static const uint8 NumSegments = 64;
-		static const float DeltaAngle = 2.0f * PI / float(NumSegments);
-		const float Radius = 0.5f * RenderRegionSize.X;
-		float Angle = 0.0f;
-		FVector2D LastPoint = RenderRegionCenter + FVector2D(Radius, 0);
-		for (uint8 i = 0; i < NumSegments; ++i)
+		// Draw circle boundary. The directions of the segment points only depend on the segment count, so compute them once.
+		static const int32 NumSegments = 64;
+		static const TArray<FVector2D> SegmentDirections = []()
 		{
-			const FVector2D A = LastPoint;
-			const FVector2D B = RenderRegionCenter + FVector2D(FMath::Cos(Angle + DeltaAngle) * Radius, FMath::Sin(Angle + DeltaAngle) * Radius);
-			Canvas->K2_DrawLine(A, B, 2.0f, FLinearColor::Black);
-			LastPoint = B;
-			Angle += DeltaAngle;
-		}
+			TArray<FVector2D> Directions;
+			for (int32 i = 0; i <= NumSegments; ++i)
+			{
+				const float Angle = 2.0f * PI * i / float(NumSegments);
+				Directions.Add(FVector2D(FMath::Cos(Angle), FMath::Sin(Angle)));
+			}
+			return Directions;
+		}();
+		const float Radius = 0.5f * RenderRegionSize.X;
+		for (int32 i = 0; i < NumSegments; ++i)
+			Canvas->K2_DrawLine(RenderRegionCenter + SegmentDirections[i] * Radius, RenderRegionCenter + SegmentDirections[i + 1] * Radius, 2.0f, FLinearColor::Black);
 	}
 	else
 	{
@@ -4,8 +4,10 @@
 #include "MinimapPluginPrivatePCH.h"
 #include "MapViewComponent.h"
 #include "MapTrackerComponent.h"
+#include "MapTrackerSubsystem.h"
 #include "MapFunctionLibrary.h"
 #include "MapFog.h"
+#include "MapFogGrid.h"
 #include "Engine/Canvas.h"
 
 UMapRevealerComponent::UMapRevealerComponent()
@@ -27,14 +29,22 @@ void UMapRevealerComponent::BeginPlay()
 	if (GetNetMode() == ENetMode::NM_DedicatedServer)
 		return;
 	
-	// Register self to tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
-		Tracker->RegisterMapRevealer(this);
-
 	// Instantiate reveal material
 	if (RevealMaterial)
 		RevealMaterialInstance = UMaterialInstanceDynamic::Create(RevealMaterial, this);
+
+	// Register self to tracker, which waits for the GameState if it doesn't exist yet
+	if (UMapTrackerSubsystem* Subsystem = GetWorld()->GetSubsystem<UMapTrackerSubsystem>())
+		Subsystem->CallWhenMapTrackerReady(FMapTrackerReadyDelegate::CreateUObject(this, &UMapRevealerComponent::RegisterWithMapTracker));
+}
+
+void UMapRevealerComponent::RegisterWithMapTracker(UMapTrackerComponent* Tracker)
+{
+	if (!HasBegunPlay() || IsBeingDestroyed() || MapTracker == Tracker)
+		return;
+
+	TrackerHandle = Tracker->RegisterMapRevealer(this);
+	MapTracker = Tracker;
 }
 
 void UMapRevealerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
@@ -45,9 +55,10 @@ void UMapRevealerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 		return;
 	
 	// Unregister self from tracker
-	UMapTrackerComponent* Tracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (Tracker)
-		Tracker->UnregisterMapRevealer(this);
+	if (MapTracker)
+		MapTracker->UnregisterMapRevealer(TrackerHandle);
+	MapTracker = nullptr;
+	TrackerHandle = FMapRegistryHandle();
 }
 
 EMapFogRevealMode UMapRevealerComponent::GetRevealMode() const
@@ -158,3 +169,25 @@ void UMapRevealerComponent::UpdateMapFog(AMapFog* MapFog, UCanvas* Canvas)
 		Canvas->K2_DrawMaterialTriangle(RevealMaterialInstance, { Tri2 });
 	}
 }
+
+bool UMapRevealerComponent::GetFogRevealStamp(AMapFog* MapFog, FMapFogRevealStamp& OutStamp)
+{
+	const FVector MyExtent = GetScaledBoxExtent();
+	if (MyExtent.X <= 0 || MyExtent.Y <= 0)
+		return false;
+
+	// Convert to the fog grid's cells, same as the render target pixels of the GPU backend
+	float ViewPosX, ViewPosY;
+	MapFog->GetMapView()->GetViewCoordinates(GetComponentLocation(), false, ViewPosX, ViewPosY);
+	const float GridSize = MapFog->GetFogGridSize();
+	const float WorldToCellRatio = MapFog->GetWorldToPixelRatio();
+	OutStamp.Center = FVector2D(ViewPosX, ViewPosY) * GridSize;
+	OutStamp.Extent = FVector2D(MyExtent.X, MyExtent.Y) * WorldToCellRatio;
+	OutStamp.DropOff = RevealDropOffDistance * WorldToCellRatio;
+	FMath::SinCos(&OutStamp.Sin, &OutStamp.Cos, FMath::DegreesToRadians(GetComponentRotation().Yaw - MapFog->GetActorRotation().Yaw));
+	OutStamp.bCircular = RevealShape == EMapRevealShape::Circle;
+	OutStamp.bPermanent = RevealMode == EMapFogRevealMode::Permanent;
+	OutStamp.bLineOfSight = bUseLineOfSight;
+	OutStamp.EyeHeight = GetComponentLocation().Z + EyeHeight;
+	return true;
+}
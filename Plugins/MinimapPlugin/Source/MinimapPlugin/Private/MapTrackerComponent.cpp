@@ -3,22 +3,95 @@
 #include "MapTrackerComponent.h"
 #include "MinimapPluginPrivatePCH.h"
 #include "MapFog.h"
+#include "MapIconComponent.h"
+#include "MapViewComponent.h"
+#include "MapTrackerSubsystem.h"
+#include "MapIconAtlas.h"
 #include "EngineUtils.h"
+#include "Algo/BinarySearch.h"
+
+DECLARE_CYCLE_STAT(TEXT("Query Icon Grid"), STAT_MinimapQueryIconGrid, STATGROUP_Minimap);
+DECLARE_CYCLE_STAT(TEXT("Query Icons"), STAT_MinimapQueryIcons, STATGROUP_Minimap);
 
 UMapTrackerComponent::UMapTrackerComponent()
 {
+	// Ticks only while icon changes are pending, after gameplay has had the chance to spawn and destroy icons
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.bTickEvenWhenPaused = true;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+}
+
+void UMapTrackerComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	BroadcastMapIconsChanged();
+}
+
+void UMapTrackerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// Make sure the world's subsystem doesn't hand out this tracker anymore, e.g. when the GameState is replaced by seamless travel
+	if (UMapTrackerSubsystem* Subsystem = GetWorld()->GetSubsystem<UMapTrackerSubsystem>())
+		Subsystem->NotifyMapTrackerEndPlay(this);
 }
 
 void UMapTrackerComponent::RegisterMapIcon(UMapIconComponent* MapIcon)
 {
-	MapIcons.Add(MapIcon);
+	// The handle may also have been issued by the tracker of a previous world, so check that it refers to this icon
+	if (ResolveMapIconHandle(MapIcon->GetIconHandle()) == MapIcon)
+		return;
+
+	// Append the icon and its render cache entry at the same index
+	MapIcon->SetIconHandle(IconSlots.Add());
+	const int32 Index = MapIcons.Add(MapIcon);
+	IconRenderCache.AddDefaulted();
+	IconRenderCache.WriteTransform(Index, MapIcon->GetComponentTransform());
+	UpdateMapIconProperties(MapIcon);
 	OnMapIconRegistered.Broadcast(MapIcon);
+
+	// Queue for the coalesced event. An icon that unregistered earlier this frame simply stays registered.
+	if (PendingRemovedMapIcons.Remove(MapIcon) == 0)
+		PendingAddedMapIcons.Add(MapIcon);
+	SetComponentTickEnabled(true);
 }
 
 void UMapTrackerComponent::UnregisterMapIcon(UMapIconComponent* MapIcon)
 {
-	MapIcons.RemoveSingle(MapIcon);
+	if (ResolveMapIconHandle(MapIcon->GetIconHandle()) != MapIcon)
+		return;
+	SetMapIconTrailListed(IconSlots.Find(MapIcon->GetIconHandle()), false);
+	RemoveMapIconAt(IconSlots.Remove(MapIcon->GetIconHandle()));
+	MapIcon->SetIconHandle(FMapIconHandle());
 	OnMapIconUnregistered.Broadcast(MapIcon);
+
+	// Queue for the coalesced event. An icon that registered earlier this frame was never announced.
+	if (PendingAddedMapIcons.Remove(MapIcon) == 0)
+		PendingRemovedMapIcons.Add(MapIcon);
+	SetComponentTickEnabled(true);
+}
+
+void UMapTrackerComponent::RegisterMapIcons(const TArray<UMapIconComponent*>& NewMapIcons)
+{
+	// Grow the registry once instead of once per icon
+	MapIcons.Reserve(MapIcons.Num() + NewMapIcons.Num());
+	IconRenderCache.Reserve(IconRenderCache.Num() + NewMapIcons.Num());
+	PendingAddedMapIcons.Reserve(PendingAddedMapIcons.Num() + NewMapIcons.Num());
+
+	for (UMapIconComponent* MapIcon : NewMapIcons)
+		if (MapIcon)
+			RegisterMapIcon(MapIcon);
+}
+
+void UMapTrackerComponent::UnregisterMapIcons(const TArray<UMapIconComponent*>& OldMapIcons)
+{
+	PendingRemovedMapIcons.Reserve(PendingRemovedMapIcons.Num() + OldMapIcons.Num());
+
+	for (UMapIconComponent* MapIcon : OldMapIcons)
+		if (MapIcon)
+			UnregisterMapIcon(MapIcon);
 }
 
 const TArray<UMapIconComponent*>& UMapTrackerComponent::GetMapIcons() const
@@ -26,15 +99,505 @@ const TArray<UMapIconComponent*>& UMapTrackerComponent::GetMapIcons() const
 	return MapIcons;
 }
 
-void UMapTrackerComponent::RegisterMapBackground(AMapBackground* MapBackground)
+UMapIconComponent* UMapTrackerComponent::ResolveMapIconHandle(const FMapIconHandle& Handle) const
+{
+	const int32 Index = IconSlots.Find(Handle);
+	return Index != INDEX_NONE ? MapIcons[Index] : nullptr;
+}
+
+const FMapIconRenderCache& UMapTrackerComponent::GetIconRenderCache() const
+{
+	return IconRenderCache;
+}
+
+uint32 UMapTrackerComponent::GetIconRenderCacheVersion() const
+{
+	return IconRenderCacheVersion;
+}
+
+const TArray<UMapIconComponent*>& UMapTrackerComponent::GetTrailMapIcons() const
+{
+	return TrailMapIcons;
+}
+
+UMaterialInterface* UMapTrackerComponent::GetIconCanvasMaterial(const uint16 MaterialSlot) const
+{
+	return IconCanvasMaterials.IsValidIndex(MaterialSlot) ? IconCanvasMaterials[MaterialSlot] : nullptr;
+}
+
+UMapIconAtlas* UMapTrackerComponent::GetIconAtlas()
+{
+	if (!IconAtlas)
+	{
+		IconAtlas = NewObject<UMapIconAtlas>(this);
+		if (bPackPluginIconsIntoAtlas)
+			IconAtlas->AddPluginIconTextures();
+		for (int32 Index = 0; Index < MapIcons.Num(); ++Index)
+			WriteIconAtlasEntries(Index, MapIcons[Index]);
+	}
+	return IconAtlas;
+}
+
+void UMapTrackerComponent::WriteIconAtlasEntries(const int32 Index, const UMapIconComponent* MapIcon)
+{
+	// Only textures that aren't packed yet are drawn into the atlas, so changing to a known texture costs a map lookup
+	IconRenderCache.AtlasEntries[Index] = IconAtlas->FindOrAddTexture(MapIcon->GetIconTexture());
+	IconRenderCache.ObjectiveArrowAtlasEntries[Index] = IconAtlas->FindOrAddTexture(MapIcon->GetObjectiveArrowTexture());
+}
+
+void UMapTrackerComponent::UpdateMapIconLocation(UMapIconComponent* MapIcon)
+{
+	const int32 Index = IconSlots.Find(MapIcon->GetIconHandle());
+	if (Index == INDEX_NONE)
+		return;
+
+	// Write through to the render cache. The grid only touches its buckets when the icon crossed into another cell.
+	IconRenderCache.WriteTransform(Index, MapIcon->GetComponentTransform());
+	++IconRenderCacheVersion;
+	const uint16 Bucket = IconRenderCache.CategoryBuckets[Index];
+	if (Bucket != FMapIconRenderCache::NoCategoryBucket)
+		IconCategoryBuckets[Bucket].Grid.Move(Index, IconRenderCache.Locations[Index]);
+}
+
+void UMapTrackerComponent::UpdateMapIconProperties(UMapIconComponent* MapIcon)
+{
+	const int32 Index = IconSlots.Find(MapIcon->GetIconHandle());
+	if (Index == INDEX_NONE)
+		return;
+
+	// Write through to the render cache. Category and objective arrow changes may move the icon to another bucket.
+	++IconRenderCacheVersion;
+	RemoveFromIconCategoryBucket(Index);
+	const int32 OldZOrder = IconRenderCache.ZOrders[Index];
+	IconRenderCache.WriteProperties(Index, MapIcon);
+	if (IconRenderCache.DrawKeys[Index] == FMapIconRenderCache::NoDrawKey || IconRenderCache.ZOrders[Index] != OldZOrder)
+		AssignIconDrawKey(Index);
+	IconRenderCache.MaterialSlots[Index] = GetIconCanvasMaterialSlot(MapIcon->GetIconMaterialForCanvas());
+	IconRenderCache.ObjectiveArrowMaterialSlots[Index] = GetIconCanvasMaterialSlot(MapIcon->GetObjectiveArrowMaterialForCanvas());
+	IconRenderCache.CategoryBuckets[Index] = FindOrAddIconCategoryBucket(MapIcon->GetIconCategory());
+	AddToIconCategoryBucket(Index);
+	if (IconAtlas)
+		WriteIconAtlasEntries(Index, MapIcon);
+
+	// Remember the largest icon size so that views can be expanded enough to include partially visible icons
+	const uint8 SizeUnitIndex = static_cast<uint8>(MapIcon->GetIconSizeUnit());
+	MaxIconSize[SizeUnitIndex] = FMath::Max(MaxIconSize[SizeUnitIndex], MapIcon->GetIconSize());
+	MaxIconSize[static_cast<uint8>(EIconSizeUnit::ScreenSpace)] = FMath::Max(MaxIconSize[static_cast<uint8>(EIconSizeUnit::ScreenSpace)], MapIcon->GetObjectiveArrowSize());
+
+	// Keep the icons with trails listed, so that renderers don't need to visit every icon to find them
+	SetMapIconTrailListed(Index, MapIcon->IsTrailEnabled());
+}
+
+void UMapTrackerComponent::SetMapIconTrailListed(const int32 Index, const bool bListed)
+{
+	const int32 Slot = IconRenderCache.TrailSlots[Index];
+	if (bListed == (Slot != INDEX_NONE))
+		return;
+	if (bListed)
+	{
+		IconRenderCache.TrailSlots[Index] = TrailMapIcons.Add(MapIcons[Index]);
+		return;
+	}
+
+	// Move the last listed icon into the freed slot, and tell it where it went
+	IconRenderCache.TrailSlots[Index] = INDEX_NONE;
+	TrailMapIcons.RemoveAtSwap(Slot, 1, false);
+	if (Slot < TrailMapIcons.Num() && TrailMapIcons[Slot])
+	{
+		const int32 MovedIndex = IconSlots.Find(TrailMapIcons[Slot]->GetIconHandle());
+		if (MovedIndex != INDEX_NONE)
+			IconRenderCache.TrailSlots[MovedIndex] = Slot;
+	}
+}
+
+void UMapTrackerComponent::SetIconGridCellSize(const float NewIconGridCellSize)
+{
+	IconGridCellSize = FMath::Max(1.0f, NewIconGridCellSize);
+
+	// Rebucket the icons of all categories that use the default cell size
+	for (int32 Bucket = 0; Bucket < IconCategoryBuckets.Num(); ++Bucket)
+		if (!IconCategorySettings.Contains(IconCategoryBuckets[Bucket].IconCategory))
+			RebuildIconCategoryBucket(Bucket);
+}
+
+float UMapTrackerComponent::GetIconGridCellSize() const
+{
+	return IconGridCellSize;
+}
+
+void UMapTrackerComponent::SetIconCategorySettings(FName IconCategory, const FMapIconCategorySettings& Settings)
+{
+	IconCategorySettings.Add(IconCategory, Settings);
+	if (const uint16* Bucket = IconCategoryBucketIndices.Find(IconCategory))
+		RebuildIconCategoryBucket(*Bucket);
+}
+
+FMapIconCategorySettings UMapTrackerComponent::GetIconCategorySettings(FName IconCategory) const
+{
+	if (const FMapIconCategorySettings* Settings = IconCategorySettings.Find(IconCategory))
+		return *Settings;
+
+	FMapIconCategorySettings DefaultSettings;
+	DefaultSettings.GridCellSize = IconGridCellSize;
+	return DefaultSettings;
+}
+
+int32 UMapTrackerComponent::GetNumIconCategoryBuckets() const
+{
+	return IconCategoryBuckets.Num();
+}
+
+const FMapIconCategorySettings& UMapTrackerComponent::GetIconCategoryBucketSettings(const uint16 Bucket) const
+{
+	return IconCategoryBuckets[Bucket].Settings;
+}
+
+void UMapTrackerComponent::GetIconsOverlappingView(UMapViewComponent* MapView, TArray<UMapIconComponent*>& OutMapIcons, const float Margin) const
+{
+	TArray<int32> Indices;
+	GetIconIndicesOverlappingView(MapView, Indices, Margin);
+	GetMapIconsAtIndices(Indices, OutMapIcons);
+}
+
+void UMapTrackerComponent::GetIconIndicesOverlappingView(UMapViewComponent* MapView, TArray<int32>& OutIndices, const float Margin) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapQueryIconGrid);
+
+	OutIndices.Reset();
+	if (!MapView)
+		return;
+
+	// Derive the view's rotated box from its corners: 0 and 1 span the X axis, 0 and 3 span the Y axis
+	const TArray<FVector> Corners = MapView->GetWorldCorners();
+	const FVector2D Corner0(Corners[0].X, Corners[0].Y);
+	const FVector2D AxisX = (FVector2D(Corners[1].X, Corners[1].Y) - Corner0).GetSafeNormal();
+	const FVector2D AxisY = (FVector2D(Corners[3].X, Corners[3].Y) - Corner0).GetSafeNormal();
+	const FVector Center = MapView->GetComponentLocation();
+	float ViewExtentX, ViewExtentY;
+	MapView->GetViewExtent(ViewExtentX, ViewExtentY);
+	const float MaxViewExtent = FMath::Max(ViewExtentX, ViewExtentY);
+
+	for (const FMapIconCategoryBucket& Bucket : IconCategoryBuckets)
+	{
+		// Skip whole categories that this view hides, or that are configured to disappear at this zoom level
+		if (!MapView->IsIconCategoryVisible(Bucket.IconCategory))
+			continue;
+		if (Bucket.Settings.MaxViewExtent > 0.0f && MaxViewExtent > Bucket.Settings.MaxViewExtent)
+			continue;
+
+		Bucket.Grid.QueryBox(FVector2D(Center.X, Center.Y), AxisX, AxisY, FVector2D(ViewExtentX + Margin, ViewExtentY + Margin), OutIndices);
+
+		// Objective arrows are shown at the map's edge, so they are relevant no matter where they are
+		OutIndices.Append(Bucket.ObjectiveArrowIconIndices);
+	}
+}
+
+void UMapTrackerComponent::GetIconsInRadius(const FVector& Center, const float Radius, const FMapIconQueryFilter& Filter, TArray<UMapIconComponent*>& OutMapIcons) const
+{
+	TArray<int32> Indices;
+	GetIconIndicesInRadius(FVector2D(Center.X, Center.Y), Radius, Filter, Indices);
+	GetMapIconsAtIndices(Indices, OutMapIcons);
+}
+
+void UMapTrackerComponent::GetNearestIcons(const FVector& Location, const int32 Count, const FMapIconQueryFilter& Filter, TArray<UMapIconComponent*>& OutMapIcons, const float MaxDistance) const
+{
+	TArray<int32> Indices;
+	GetNearestIconIndices(FVector2D(Location.X, Location.Y), Count, Filter, Indices, MaxDistance);
+	GetMapIconsAtIndices(Indices, OutMapIcons);
+}
+
+void UMapTrackerComponent::GetIconsInBox(const FVector& Center, const FVector2D& Extent, const float Yaw, const FMapIconQueryFilter& Filter, TArray<UMapIconComponent*>& OutMapIcons) const
+{
+	TArray<int32> Indices;
+	GetIconIndicesInBox(FVector2D(Center.X, Center.Y), Extent, Yaw, Filter, Indices);
+	GetMapIconsAtIndices(Indices, OutMapIcons);
+}
+
+void UMapTrackerComponent::GetIconIndicesInRadius(const FVector2D& Center, const float Radius, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapQueryIcons);
+
+	OutIndices.Reset();
+	GatherIconIndicesInRadius(Center, Radius, Filter, OutIndices);
+}
+
+void UMapTrackerComponent::GetNearestIconIndices(const FVector2D& Location, const int32 Count, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices, const float MaxDistance) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapQueryIcons);
+
+	OutIndices.Reset();
+	if (Count <= 0)
+		return;
+
+	// Start searching within a single cell of the finest grid involved and count the icons that can be found at all
+	float Radius = MAX_flt;
+	int32 NumIcons = 0;
+	ForEachFilteredIconCategoryBucket(Filter, [&](const FMapIconCategoryBucket& Bucket)
+	{
+		Radius = FMath::Min(Radius, Bucket.Grid.GetCellSize());
+		NumIcons += Bucket.Grid.Num() + Bucket.ObjectiveArrowIconIndices.Num();
+	});
+	if (NumIcons == 0)
+		return;
+
+	// Double the radius until it contains enough icons. All icons within the radius are found, so once there are
+	// Count of them, the nearest Count icons are among them.
+	while (true)
+	{
+		const bool bReachedMaxDistance = MaxDistance > 0.0f && Radius >= MaxDistance;
+		if (bReachedMaxDistance)
+			Radius = MaxDistance;
+
+		OutIndices.Reset();
+		const int32 NumVisited = GatherIconIndicesInRadius(Location, Radius, Filter, OutIndices);
+		if (OutIndices.Num() >= Count || NumVisited >= NumIcons || bReachedMaxDistance)
+			break;
+		Radius *= 2.0f;
+	}
+
+	const TArray<FVector2D>& Locations = IconRenderCache.Locations;
+	OutIndices.Sort([&Locations, &Location](const int32 A, const int32 B)
+	{
+		return FVector2D::DistSquared(Locations[A], Location) < FVector2D::DistSquared(Locations[B], Location);
+	});
+	if (OutIndices.Num() > Count)
+		OutIndices.SetNum(Count, false);
+}
+
+void UMapTrackerComponent::GetIconIndicesInBox(const FVector2D& Center, const FVector2D& Extent, const float Yaw, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_MinimapQueryIcons);
+
+	OutIndices.Reset();
+	const FVector2D AxisX = FVector2D(1.0f, 0.0f).GetRotated(Yaw);
+	const FVector2D AxisY = FVector2D(0.0f, 1.0f).GetRotated(Yaw);
+
+	TArray<int32> Candidates;
+	ForEachFilteredIconCategoryBucket(Filter, [&](const FMapIconCategoryBucket& Bucket)
+	{
+		Candidates.Reset();
+		Bucket.Grid.QueryBox(Center, AxisX, AxisY, Extent, Candidates);
+		Candidates.Append(Bucket.ObjectiveArrowIconIndices);
+		for (const int32 Index : Candidates)
+		{
+			const FVector2D Delta = IconRenderCache.Locations[Index] - Center;
+			if (FMath::Abs(Delta | AxisX) <= Extent.X && FMath::Abs(Delta | AxisY) <= Extent.Y && PassesIconQueryFilter(Index, Filter))
+				OutIndices.Add(Index);
+		}
+	});
+}
+
+float UMapTrackerComponent::GetMaxIconSize(const EIconSizeUnit SizeUnit) const
+{
+	return MaxIconSize[static_cast<uint8>(SizeUnit)];
+}
+
+void UMapTrackerComponent::AssignIconDrawKey(const int32 Index)
+{
+	// Games use a handful of z-orders, so layers are never removed. Adding one shifts the layers above it,
+	// which is the only time draw keys of other icons change.
+	const int32 ZOrder = IconRenderCache.ZOrders[Index];
+	const int32 Layer = Algo::LowerBound(IconZLayers, ZOrder);
+	if (Layer == IconZLayers.Num() || IconZLayers[Layer] != ZOrder)
+	{
+		IconZLayers.Insert(ZOrder, Layer);
+		const uint64 FirstShiftedKey = static_cast<uint64>(Layer) << 32;
+		for (uint64& DrawKey : IconRenderCache.DrawKeys)
+			if (DrawKey != FMapIconRenderCache::NoDrawKey && DrawKey >= FirstShiftedKey)
+				DrawKey += 1ull << 32;
+	}
+
+	// Enter at the back of the layer, so that the icon is drawn on top of the icons already in it
+	IconRenderCache.DrawKeys[Index] = (static_cast<uint64>(Layer) << 32) | NextIconDrawSequence++;
+}
+
+void UMapTrackerComponent::RemoveMapIconAt(const int32 Index)
+{
+	++IconRenderCacheVersion;
+	RemoveFromIconCategoryBucket(Index);
+
+	// The last icon is moved into the freed index, so its category bucket must refer to its new index.
+	// The slot map already points the last icon's handle at the new index.
+	const int32 LastIndex = MapIcons.Num() - 1;
+	if (Index != LastIndex)
+	{
+		const uint16 LastBucket = IconRenderCache.CategoryBuckets[LastIndex];
+		if (LastBucket != FMapIconRenderCache::NoCategoryBucket)
+		{
+			FMapIconCategoryBucket& Bucket = IconCategoryBuckets[LastBucket];
+			int32 Slot;
+			if (!Bucket.Grid.Rename(LastIndex, Index) && Bucket.ObjectiveArrowIconSlots.RemoveAndCopyValue(LastIndex, Slot))
+			{
+				Bucket.ObjectiveArrowIconIndices[Slot] = Index;
+				Bucket.ObjectiveArrowIconSlots.Add(Index, Slot);
+			}
+		}
+	}
+
+	MapIcons.RemoveAtSwap(Index, 1, false);
+	IconRenderCache.RemoveAtSwap(Index);
+}
+
+void UMapTrackerComponent::BroadcastMapIconsChanged()
+{
+	SetComponentTickEnabled(false);
+	if (PendingAddedMapIcons.Num() == 0 && PendingRemovedMapIcons.Num() == 0)
+		return;
+
+	// Take the pending sets first, so listeners may register and unregister icons for the next broadcast.
+	// Garbage collection may have cleared references to destroyed icons in the meantime.
+	TArray<UMapIconComponent*> AddedMapIcons = PendingAddedMapIcons.Array();
+	TArray<UMapIconComponent*> RemovedMapIcons = PendingRemovedMapIcons.Array();
+	PendingAddedMapIcons.Reset();
+	PendingRemovedMapIcons.Reset();
+	AddedMapIcons.RemoveAllSwap([](const UMapIconComponent* MapIcon) { return MapIcon == nullptr; });
+	RemovedMapIcons.RemoveAllSwap([](const UMapIconComponent* MapIcon) { return MapIcon == nullptr; });
+
+	OnMapIconsChanged.Broadcast(AddedMapIcons, RemovedMapIcons);
+}
+
+int32 UMapTrackerComponent::GatherIconIndicesInRadius(const FVector2D& Center, const float Radius, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices) const
+{
+	const float RadiusSquared = FMath::Square(Radius);
+	int32 NumVisited = 0;
+	TArray<int32> Candidates;
+	ForEachFilteredIconCategoryBucket(Filter, [&](const FMapIconCategoryBucket& Bucket)
+	{
+		// Icons with an objective arrow aren't in the grid, so test those separately
+		Candidates.Reset();
+		Bucket.Grid.QueryCircle(Center, Radius, Candidates);
+		Candidates.Append(Bucket.ObjectiveArrowIconIndices);
+		NumVisited += Candidates.Num();
+		for (const int32 Index : Candidates)
+			if (FVector2D::DistSquared(IconRenderCache.Locations[Index], Center) <= RadiusSquared && PassesIconQueryFilter(Index, Filter))
+				OutIndices.Add(Index);
+	});
+	return NumVisited;
+}
+
+void UMapTrackerComponent::ForEachFilteredIconCategoryBucket(const FMapIconQueryFilter& Filter, TFunctionRef<void(const FMapIconCategoryBucket&)> Visitor) const
+{
+	if (Filter.IconCategories.Num() == 0)
+	{
+		for (const FMapIconCategoryBucket& Bucket : IconCategoryBuckets)
+			Visitor(Bucket);
+		return;
+	}
+
+	// A category listed twice would otherwise report its icons twice
+	TArray<uint16, TInlineAllocator<16>> Buckets;
+	for (const FName& IconCategory : Filter.IconCategories)
+		if (const uint16* Bucket = IconCategoryBucketIndices.Find(IconCategory))
+			Buckets.AddUnique(*Bucket);
+	for (const uint16 Bucket : Buckets)
+		Visitor(IconCategoryBuckets[Bucket]);
+}
+
+bool UMapTrackerComponent::PassesIconQueryFilter(const int32 Index, const FMapIconQueryFilter& Filter) const
+{
+	if (Filter.bOnlyVisibleIcons && !IconRenderCache.HasFlag(Index, EMapIconRenderFlags::Visible))
+		return false;
+	if (Filter.RenderedInView && !MapIcons[Index]->IsRenderedInView(Filter.RenderedInView))
+		return false;
+	if (Filter.Predicate && !Filter.Predicate(MapIcons[Index]))
+		return false;
+	return true;
+}
+
+void UMapTrackerComponent::GetMapIconsAtIndices(const TArray<int32>& Indices, TArray<UMapIconComponent*>& OutMapIcons) const
+{
+	OutMapIcons.Reset(Indices.Num());
+	for (const int32 Index : Indices)
+		OutMapIcons.Add(MapIcons[Index]);
+}
+
+uint16 UMapTrackerComponent::FindOrAddIconCategoryBucket(FName IconCategory)
+{
+	if (const uint16* Bucket = IconCategoryBucketIndices.Find(IconCategory))
+		return *Bucket;
+
+	// Buckets are never removed, since games use a handful of categories
+	const int32 NewBucket = IconCategoryBuckets.AddDefaulted();
+	check(NewBucket < FMapIconRenderCache::NoCategoryBucket);
+	FMapIconCategoryBucket& Bucket = IconCategoryBuckets[NewBucket];
+	Bucket.IconCategory = IconCategory;
+	Bucket.Settings = GetIconCategorySettings(IconCategory);
+	Bucket.Grid.SetCellSize(Bucket.Settings.GridCellSize);
+	IconCategoryBucketIndices.Add(IconCategory, static_cast<uint16>(NewBucket));
+	return static_cast<uint16>(NewBucket);
+}
+
+void UMapTrackerComponent::AddToIconCategoryBucket(const int32 Index)
+{
+	FMapIconCategoryBucket& Bucket = IconCategoryBuckets[IconRenderCache.CategoryBuckets[Index]];
+
+	// Objective arrows render regardless of distance to the view, so these are kept out of the grid
+	if (IconRenderCache.HasFlag(Index, EMapIconRenderFlags::ObjectiveArrowEnabled))
+		Bucket.ObjectiveArrowIconSlots.Add(Index, Bucket.ObjectiveArrowIconIndices.Add(Index));
+	else
+		Bucket.Grid.Add(Index, IconRenderCache.Locations[Index]);
+}
+
+void UMapTrackerComponent::RemoveFromIconCategoryBucket(const int32 Index)
+{
+	const uint16 BucketIndex = IconRenderCache.CategoryBuckets[Index];
+	if (BucketIndex == FMapIconRenderCache::NoCategoryBucket)
+		return;
+
+	// Fill the freed slot with the last icon of the list, like the grid does within a cell
+	FMapIconCategoryBucket& Bucket = IconCategoryBuckets[BucketIndex];
+	int32 Slot;
+	if (!Bucket.Grid.Remove(Index) && Bucket.ObjectiveArrowIconSlots.RemoveAndCopyValue(Index, Slot))
+	{
+		Bucket.ObjectiveArrowIconIndices.RemoveAtSwap(Slot, 1, false);
+		if (Slot < Bucket.ObjectiveArrowIconIndices.Num())
+			Bucket.ObjectiveArrowIconSlots[Bucket.ObjectiveArrowIconIndices[Slot]] = Slot;
+	}
+	IconRenderCache.CategoryBuckets[Index] = FMapIconRenderCache::NoCategoryBucket;
+}
+
+void UMapTrackerComponent::RebuildIconCategoryBucket(const uint16 BucketIndex)
+{
+	++IconRenderCacheVersion;
+	FMapIconCategoryBucket& Bucket = IconCategoryBuckets[BucketIndex];
+	Bucket.Settings = GetIconCategorySettings(Bucket.IconCategory);
+	Bucket.Grid.SetCellSize(Bucket.Settings.GridCellSize);
+	Bucket.ObjectiveArrowIconIndices.Reset();
+	Bucket.ObjectiveArrowIconSlots.Reset();
+
+	for (int32 Index = 0; Index < IconRenderCache.Num(); ++Index)
+		if (IconRenderCache.CategoryBuckets[Index] == BucketIndex)
+			AddToIconCategoryBucket(Index);
+}
+
+uint16 UMapTrackerComponent::GetIconCanvasMaterialSlot(UMaterialInterface* Material)
+{
+	if (!Material)
+		return FMapIconRenderCache::NoMaterialSlot;
+
+	// Icons share a handful of materials, so a linear search is fine
+	const int32 Slot = IconCanvasMaterials.AddUnique(Material);
+	check(Slot < FMapIconRenderCache::NoMaterialSlot);
+	return static_cast<uint16>(Slot);
+}
+
+FMapRegistryHandle UMapTrackerComponent::RegisterMapBackground(AMapBackground* MapBackground)
 {
+	const FMapRegistryHandle Handle = BackgroundSlots.Add();
 	MapBackgrounds.Add(MapBackground);
+	bMapBackgroundDrawOrderDirty = true;
 	OnMapBackgroundRegistered.Broadcast(MapBackground);
+	return Handle;
 }
 
-void UMapTrackerComponent::UnregisterMapBackground(AMapBackground* MapBackground)
+void UMapTrackerComponent::UnregisterMapBackground(const FMapRegistryHandle& Handle)
 {
-	MapBackgrounds.RemoveSingle(MapBackground);
+	const int32 Index = BackgroundSlots.Remove(Handle);
+	if (Index == INDEX_NONE)
+		return;
+	AMapBackground* MapBackground = MapBackgrounds[Index];
+	MapBackgrounds.RemoveAtSwap(Index, 1, false);
+	bMapBackgroundDrawOrderDirty = true;
 	OnMapBackgroundUnregistered.Broadcast(MapBackground);
 }
 
@@ -43,15 +606,40 @@ const TArray<AMapBackground*>& UMapTrackerComponent::GetMapBackgrounds() const
 	return MapBackgrounds;
 }
 
-void UMapTrackerComponent::RegisterMapFog(AMapFog* MapFog)
+const TArray<AMapBackground*>& UMapTrackerComponent::GetMapBackgroundsInDrawOrder()
+{
+	if (bMapBackgroundDrawOrderDirty)
+	{
+		bMapBackgroundDrawOrderDirty = false;
+		MapBackgroundsInDrawOrder = MapBackgrounds;
+		MapBackgroundsInDrawOrder.StableSort([](const AMapBackground& A, const AMapBackground& B)
+		{
+			return A.GetBackgroundZOrder() < B.GetBackgroundZOrder();
+		});
+	}
+	return MapBackgroundsInDrawOrder;
+}
+
+void UMapTrackerComponent::MarkMapBackgroundDrawOrderDirty()
 {
+	bMapBackgroundDrawOrderDirty = true;
+}
+
+FMapRegistryHandle UMapTrackerComponent::RegisterMapFog(AMapFog* MapFog)
+{
+	const FMapRegistryHandle Handle = FogSlots.Add();
 	MapFogs.Add(MapFog);
 	OnMapFogRegistered.Broadcast(MapFog);
+	return Handle;
 }
 
-void UMapTrackerComponent::UnregisterMapFog(AMapFog* MapFog)
+void UMapTrackerComponent::UnregisterMapFog(const FMapRegistryHandle& Handle)
 {
-	MapFogs.RemoveSingle(MapFog);
+	const int32 Index = FogSlots.Remove(Handle);
+	if (Index == INDEX_NONE)
+		return;
+	AMapFog* MapFog = MapFogs[Index];
+	MapFogs.RemoveAtSwap(Index, 1, false);
 	OnMapFogUnregistered.Broadcast(MapFog);
 }
 
@@ -80,19 +668,48 @@ float UMapTrackerComponent::GetFogRevealedFactor(const FVector& WorldLocation, c
 	return RevealFactor;
 }
 
-void UMapTrackerComponent::RegisterMapRevealer(UMapRevealerComponent* MapRevealer)
+FMapRegistryHandle UMapTrackerComponent::RegisterMapRevealer(UMapRevealerComponent* MapRevealer)
 {
+	const FMapRegistryHandle Handle = RevealerSlots.Add();
 	MapRevealers.Add(MapRevealer);
 	OnMapRevealerRegistered.Broadcast(MapRevealer);
+	return Handle;
 }
 
-void UMapTrackerComponent::UnregisterMapRevealer(UMapRevealerComponent* MapRevealer)
+void UMapTrackerComponent::UnregisterMapRevealer(const FMapRegistryHandle& Handle)
 {
-	MapRevealers.RemoveSingle(MapRevealer);
+	const int32 Index = RevealerSlots.Remove(Handle);
+	if (Index == INDEX_NONE)
+		return;
+	UMapRevealerComponent* MapRevealer = MapRevealers[Index];
+	MapRevealers.RemoveAtSwap(Index, 1, false);
 	OnMapRevealerUnregistered.Broadcast(MapRevealer);
 }
 
 const TArray<UMapRevealerComponent*>& UMapTrackerComponent::GetMapRevealers() const
 {
 	return MapRevealers;
-}
\ No newline at end of file
+}
+
+FMapRegistryHandle UMapTrackerComponent::RegisterMapView(UMapViewComponent* MapView)
+{
+	const FMapRegistryHandle Handle = ViewSlots.Add();
+	MapViews.Add(MapView);
+	OnMapViewRegistered.Broadcast(MapView);
+	return Handle;
+}
+
+void UMapTrackerComponent::UnregisterMapView(const FMapRegistryHandle& Handle)
+{
+	const int32 Index = ViewSlots.Remove(Handle);
+	if (Index == INDEX_NONE)
+		return;
+	UMapViewComponent* MapView = MapViews[Index];
+	MapViews.RemoveAtSwap(Index, 1, false);
+	OnMapViewUnregistered.Broadcast(MapView);
+}
+
+const TArray<UMapViewComponent*>& UMapTrackerComponent::GetMapViews() const
+{
+	return MapViews;
+}
@@ -0,0 +1,123 @@
+// Journeyman's Minimap by ZKShao.
+
+#include "MapTrackerSubsystem.h"
+#include "MinimapPluginPrivatePCH.h"
+#include "MapTrackerComponent.h"
+#include "MapIconComponent.h"
+#include "MapRevealerComponent.h"
+#include "MapViewComponent.h"
+#include "MapRendererComponent.h"
+#include "GameFramework/GameStateBase.h"
+
+namespace
+{
+	template<typename ComponentType>
+	void RegisterComponentsWithMapTracker(AActor* Actor, UMapTrackerComponent* MapTracker)
+	{
+		TInlineComponentArray<ComponentType*> Components(Actor);
+		for (ComponentType* Component : Components)
+			Component->RegisterWithMapTracker(MapTracker);
+	}
+}
+
+bool UMapTrackerSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// Editor and preview worlds never have gameplay to track
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UMapTrackerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	GameStateSetHandle = GetWorld()->GameStateSetEvent.AddUObject(this, &UMapTrackerSubsystem::OnGameStateSet);
+}
+
+void UMapTrackerSubsystem::Deinitialize()
+{
+	GetWorld()->GameStateSetEvent.Remove(GameStateSetHandle);
+	PendingCallbacks.Empty();
+	MapTracker = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UMapTrackerSubsystem::CallWhenMapTrackerReady(const FMapTrackerReadyDelegate& Callback)
+{
+	// Minimap is pointless on dedicated server, so nothing will ever be tracked
+	UWorld* World = GetWorld();
+	if (World->GetNetMode() == ENetMode::NM_DedicatedServer)
+		return;
+
+	if (UMapTrackerComponent* Tracker = GetMapTracker())
+		Callback.ExecuteIfBound(Tracker);
+	else
+		PendingCallbacks.Add(Callback);
+}
+
+void UMapTrackerSubsystem::NotifyMapTrackerEndPlay(UMapTrackerComponent* EndingMapTracker)
+{
+	if (MapTracker == EndingMapTracker)
+		MapTracker = nullptr;
+}
+
+UMapTrackerComponent* UMapTrackerSubsystem::FindOrCreateMapTracker()
+{
+	// Minimap is pointless on dedicated server, so don't do any tracking
+	UWorld* World = GetWorld();
+	if (World->GetNetMode() == ENetMode::NM_DedicatedServer)
+		return nullptr;
+
+	// Game state not found, assuming gameplay is not in progress
+	AGameStateBase* GS = World->GetGameState();
+	if (!GS || GS->IsPendingKillPending())
+		return nullptr;
+
+	// Attempt to find a MapTrackerComponent as component of the GameState actor
+	MapTracker = Cast<UMapTrackerComponent>(GS->GetComponentByClass(UMapTrackerComponent::StaticClass()));
+	if (!MapTracker)
+	{
+		// Wasn't found, so create it once. Subsequent calls will use the cached one.
+		// Registered so that it can tick, which it needs to fire its coalesced per-frame events.
+		MapTracker = NewObject<UMapTrackerComponent>(GS, TEXT("MapTracker"));
+		MapTracker->RegisterComponent();
+	}
+	return MapTracker;
+}
+
+void UMapTrackerSubsystem::OnGameStateSet(AGameStateBase* GameState)
+{
+	// A tracker on a previous GameState must not be handed out anymore
+	if (MapTracker && MapTracker->GetOwner() != GameState)
+		MapTracker = nullptr;
+
+	UMapTrackerComponent* Tracker = GetMapTracker();
+	if (!Tracker)
+		return;
+
+	// Call back everything that started play before the GameState existed. Callbacks may queue new callbacks,
+	// but those are executed right away now that the tracker exists.
+	TArray<FMapTrackerReadyDelegate> Callbacks = MoveTemp(PendingCallbacks);
+	PendingCallbacks.Reset();
+	for (const FMapTrackerReadyDelegate& Callback : Callbacks)
+		Callback.ExecuteIfBound(Tracker);
+
+	ReconnectTravelledMapObjects(Tracker);
+}
+
+void UMapTrackerSubsystem::ReconnectTravelledMapObjects(UMapTrackerComponent* Tracker)
+{
+	// Travelled actors don't begin play again, so their components never register with this world's tracker by themselves.
+	// Everything else that has begun play is already registered, which the components detect and skip.
+	for (TActorIterator<AActor> Itr(GetWorld()); Itr; ++Itr)
+	{
+		AActor* Actor = *Itr;
+		if (!Actor->HasActorBegunPlay() || Actor->IsPendingKillPending())
+			continue;
+		RegisterComponentsWithMapTracker<UMapIconComponent>(Actor, Tracker);
+		RegisterComponentsWithMapTracker<UMapRevealerComponent>(Actor, Tracker);
+		RegisterComponentsWithMapTracker<UMapViewComponent>(Actor, Tracker);
+		RegisterComponentsWithMapTracker<UMapRendererComponent>(Actor, Tracker);
+	}
+}
@@ -4,8 +4,16 @@
 #include "MinimapPluginPrivatePCH.h"
 #include "MapIconComponent.h"
 #include "MapTrackerComponent.h"
+#include "MapTrackerSubsystem.h"
 #include "MapBackground.h"
 #include "MapFunctionLibrary.h"
+#include "MapFog.h"
+#include "MapIconRenderCache.h"
+#include "MapIconCulling.h"
+
+DECLARE_CYCLE_STAT(TEXT("Gather Icon Candidates"), STAT_MinimapGatherIconCandidates, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Icon Candidates"), STAT_MinimapIconCandidates, STATGROUP_Minimap);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shared Icon Cullings"), STAT_MinimapSharedIconCullings, STATGROUP_Minimap);
 
 UMapViewComponent::UMapViewComponent()
 {
@@ -39,27 +47,50 @@ void UMapViewComponent::BeginPlay()
 	SetViewExtent(ScaledBoxExtent.X, ScaledBoxExtent.Y);
 	SetZoomScale(1.0f);
 
-	UMapTrackerComponent* MapTracker = UMapFunctionLibrary::GetMapTracker(this);
-	if (MapTracker) 
-	{
-		MapTracker->OnMapBackgroundRegistered.AddDynamic(this, &UMapViewComponent::RegisterMultiLevelMapBackground);
-		MapTracker->OnMapBackgroundUnregistered.AddDynamic(this, &UMapViewComponent::UnregisterMultiLevelMapBackground);
+	// Register self to tracker, which waits for the GameState if it doesn't exist yet
+	if (UMapTrackerSubsystem* Subsystem = GetWorld()->GetSubsystem<UMapTrackerSubsystem>())
+		Subsystem->CallWhenMapTrackerReady(FMapTrackerReadyDelegate::CreateUObject(this, &UMapViewComponent::RegisterWithMapTracker));
+}
 
-		for (AMapBackground* MapBackground : MapTracker->GetMapBackgrounds())
-			RegisterMultiLevelMapBackground(MapBackground);
+void UMapViewComponent::RegisterWithMapTracker(UMapTrackerComponent* Tracker)
+{
+	if (!HasBegunPlay() || IsBeingDestroyed() || MapTracker == Tracker)
+		return;
+
+	// Leave the tracker of a previous world
+	if (MapTracker)
+	{
+		MapTracker->UnregisterMapView(TrackerHandle);
+		MapTracker->OnMapBackgroundRegistered.RemoveDynamic(this, &UMapViewComponent::RegisterMultiLevelMapBackground);
+		MapTracker->OnMapBackgroundUnregistered.RemoveDynamic(this, &UMapViewComponent::UnregisterMultiLevelMapBackground);
+		MapBackgrounds.Empty();
+		PositionOnMultiLevelBackgrounds.Empty();
+		UpdateBackgroundCache();
 	}
+
+	MapTracker = Tracker;
+	MapTracker->OnMapBackgroundRegistered.AddUniqueDynamic(this, &UMapViewComponent::RegisterMultiLevelMapBackground);
+	MapTracker->OnMapBackgroundUnregistered.AddUniqueDynamic(this, &UMapViewComponent::UnregisterMultiLevelMapBackground);
+
+	for (AMapBackground* MapBackground : MapTracker->GetMapBackgrounds())
+		RegisterMultiLevelMapBackground(MapBackground);
+
+	// Registered last, so renderers that pick up this view find it fully initialized
+	TrackerHandle = MapTracker->RegisterMapView(this);
 }
 
 void UMapViewComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 	
-	UMapTrackerComponent* MapTracker = UMapFunctionLibrary::GetMapTracker(this);
 	if (MapTracker) 
 	{
+		MapTracker->UnregisterMapView(TrackerHandle);
 		MapTracker->OnMapBackgroundRegistered.RemoveDynamic(this, &UMapViewComponent::RegisterMultiLevelMapBackground);
 		MapTracker->OnMapBackgroundUnregistered.RemoveDynamic(this, &UMapViewComponent::UnregisterMultiLevelMapBackground);
 	}
+	MapTracker = nullptr;
+	TrackerHandle = FMapRegistryHandle();
 	
 	// Let listeners (like a UMG widget) know this map view is destroyed
 	OnViewDestroyed.Broadcast(this);
@@ -72,11 +103,13 @@ void UMapViewComponent::SetIconCategoryVisible(FName IconCategory, const bool bN
 	if (bNewVisible && HiddenIconCategories.Contains(IconCategory))
 	{
 		HiddenIconCategories.Remove(IconCategory);
+		IconCulling.bValid = false;
 		OnVisibleCategoriesChanged.Broadcast(this);
 	}
 	else if (!bNewVisible && !HiddenIconCategories.Contains(IconCategory))
 	{
 		HiddenIconCategories.Add(IconCategory);
+		IconCulling.bValid = false;
 		OnVisibleCategoriesChanged.Broadcast(this);
 	}
 }
@@ -169,6 +202,96 @@ bool UMapViewComponent::GetViewCoordinates(const FVector& WorldPos, bool bForceR
 	return !(U < 0 || U > 1 || V < 0 || V > 1);
 }
 
+void UMapViewComponent::GetViewSnapshot(FMapViewSnapshot& OutSnapshot)
+{
+	UpdateTransformCache();
+
+	const FVector ScaledBoxExtent = GetScaledBoxExtent();
+	OutSnapshot.Location = FVector2D(GetComponentLocation());
+	OutSnapshot.ScaledExtent = FVector2D(ScaledBoxExtent.X, ScaledBoxExtent.Y);
+	OutSnapshot.InverseTransform = CachedInverseTransform;
+	OutSnapshot.InverseViewSize = CachedInverseViewSize;
+}
+
+const FMapViewIconCulling& UMapViewComponent::CullIcons(UMapTrackerComponent* Tracker, const float DPIScale, const float WorldToPixelRatio, const bool bParallel)
+{
+	// Keep track of the largest icons in world units that renderers ask for. Culling for the largest covers the other renderers
+	// as well, so taking the previous frame into account keeps renderers of different sizes from culling again every frame.
+	if (IconCulling.RequestFrame != GFrameCounter)
+	{
+		IconCulling.RequestFrame = GFrameCounter;
+		IconCulling.PreviousMaxRequestedWorldToPixelRatio = IconCulling.MaxRequestedWorldToPixelRatio;
+		IconCulling.MaxRequestedWorldToPixelRatio = 0.0f;
+	}
+	IconCulling.MaxRequestedWorldToPixelRatio = FMath::Max(IconCulling.MaxRequestedWorldToPixelRatio, WorldToPixelRatio);
+
+	if (IconCulling.bValid && IconCulling.Frame == GFrameCounter && IconCulling.Tracker == Tracker && IconCulling.TrackerIconVersion == Tracker->GetIconRenderCacheVersion()
+		&& IconCulling.DPIScale == DPIScale && IconCulling.WorldToPixelRatio >= WorldToPixelRatio)
+	{
+		INC_DWORD_STAT(STAT_MinimapSharedIconCullings);
+		return IconCulling;
+	}
+
+	IconCulling.bValid = true;
+	IconCulling.Frame = GFrameCounter;
+	IconCulling.Tracker = Tracker;
+	IconCulling.TrackerIconVersion = Tracker->GetIconRenderCacheVersion();
+	IconCulling.DPIScale = DPIScale;
+	IconCulling.WorldToPixelRatio = FMath::Max(IconCulling.MaxRequestedWorldToPixelRatio, IconCulling.PreviousMaxRequestedWorldToPixelRatio);
+
+	// Icons that are partially in view must be included, so expand the view by the largest icon radius
+	{
+		SCOPE_CYCLE_COUNTER(STAT_MinimapGatherIconCandidates);
+		const float MaxScreenSpaceSize = Tracker->GetMaxIconSize(EIconSizeUnit::ScreenSpace) * DPIScale * IconCulling.WorldToPixelRatio;
+		const float MaxWorldSpaceSize = Tracker->GetMaxIconSize(EIconSizeUnit::WorldSpace);
+		const float Margin = ICONSIZE_TO_OUTERRADIUS * FMath::Max(MaxScreenSpaceSize, MaxWorldSpaceSize);
+		Tracker->GetIconIndicesOverlappingView(this, IconCulling.Candidates, Margin);
+		SET_DWORD_STAT(STAT_MinimapIconCandidates, IconCulling.Candidates.Num());
+	}
+
+	// Cull on the task graph from a snapshot of everything culling reads
+	const FMapIconRenderCache& Cache = Tracker->GetIconRenderCache();
+	FMapIconCullParams CullParams;
+	GetViewSnapshot(CullParams.View);
+	CullParams.DPIScale = DPIScale;
+	CullParams.WorldToPixelRatio = IconCulling.WorldToPixelRatio;
+	CullParams.PixelToWorldRatio = 1.0f / IconCulling.WorldToPixelRatio;
+	GetActiveBackgroundPriority(CullParams.bCheckBackgroundLevels);
+	if (Tracker->HasMapFog())
+		GatherFogSnapshots(Tracker, CullParams.Fogs);
+	IconCulling.Culler.Cull(Cache, IconCulling.Candidates, CullParams, bParallel ? 0 : 1, IconCulling.Result);
+
+	// Eliminate icons that are in the same mult-level background volume, but not in the same level
+	FMapIconCullResult& Result = IconCulling.Result;
+	for (const int32 Index : Result.NeedsBackgroundLevelCheck)
+		if (IsSameBackgroundLevel(FVector(Cache.Locations[Index], Cache.Heights[Index]), Cache.BackgroundInteractions[Index]))
+			Result.Visible.Add(Index);
+	Result.NeedsBackgroundLevelCheck.Reset();
+
+	// Sort icons back to front on the draw keys the tracker maintains
+	Cache.SortByDrawOrder(Result.Visible, IconCulling.SortScratch);
+	return IconCulling;
+}
+
+void UMapViewComponent::GatherFogSnapshots(UMapTrackerComponent* Tracker, TArray<FMapFogSnapshot>& OutFogs)
+{
+	// Reading fog back from the GPU stalls, so only read the buffers that candidates are going to sample
+	const FMapIconRenderCache& Cache = Tracker->GetIconRenderCache();
+	bool bNeedsPermanent = false, bNeedsCurrentlyRevealing = false;
+	for (const int32 Index : IconCulling.Candidates)
+	{
+		bNeedsPermanent |= Cache.FogInteractions[Index] == EIconFogInteraction::OnlyRenderWhenExplored;
+		bNeedsCurrentlyRevealing |= Cache.FogInteractions[Index] == EIconFogInteraction::OnlyRenderWhenRevealing;
+		if (bNeedsPermanent && bNeedsCurrentlyRevealing)
+			break;
+	}
+	if (!bNeedsPermanent && !bNeedsCurrentlyRevealing)
+		return;
+
+	for (AMapFog* MapFog : Tracker->GetMapFogs())
+		MapFog->GetFogSnapshot(bNeedsPermanent, bNeedsCurrentlyRevealing, OutFogs.AddDefaulted_GetRef());
+}
+
 void UMapViewComponent::GetViewYaw(const float WorldYaw, float& Yaw)
 {
 	UpdateTransformCache();
@@ -206,8 +329,11 @@ bool UMapViewComponent::IsSameBackgroundLevel(const UMapIconComponent* MapIcon)
 {
 	if (!MapIcon)
 		return false;
-	
-	const EIconBackgroundInteraction BackgroundInteraction = MapIcon->GetIconBackgroundInteraction();
+	return IsSameBackgroundLevel(MapIcon->GetComponentLocation(), MapIcon->GetIconBackgroundInteraction());
+}
+
+bool UMapViewComponent::IsSameBackgroundLevel(const FVector& MapIconPos, const EIconBackgroundInteraction BackgroundInteraction)
+{
 	if (BackgroundInteraction == EIconBackgroundInteraction::AlwaysRender)
 		return true;
 
@@ -217,7 +343,6 @@ bool UMapViewComponent::IsSameBackgroundLevel(const UMapIconComponent* MapIcon)
 	if (!bInsideAnyBackground)
 		return true;
 	
-	const FVector MapIconPos = MapIcon->GetComponentLocation();
 	TSet<AMapBackground*> SurroundingBackgrounds;
 	for (AMapBackground* Background : MapBackgrounds)
 	{
@@ -296,6 +421,7 @@ void UMapViewComponent::UpdateViewSize()
 	CachedInverseViewSize.X = 1.0f / (2.0f * UnscaledBoxExtent.X);
 	CachedInverseViewSize.Y = 1.0f / (2.0f * UnscaledBoxExtent.Y);
 	InverseViewRadius = FMath::Max(CachedInverseViewSize.X, CachedInverseViewSize.Y);
+	IconCulling.bValid = false;
 
 	// Fire view size changed event
 	OnViewSizeChanged.Broadcast(this);
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "MapAreaBase.h"
+#include "MapSlotMap.h"
 #include "MapBackground.generated.h"
 
 class UBoxComponent;
@@ -11,6 +12,7 @@ class UNavMeshRenderingComponent;
 class UTextureRenderTarget2D;
 class UMapViewComponent;
 class UMapRendererComponent;
+class UMapTrackerComponent;
 
 // MapBackground event signatures
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapBackgroundTextureChangedSignature, AMapBackground*, MapBackground);
@@ -151,6 +153,9 @@ private:
 
 	void NormalizeScale();
 
+	// Registers the background with the tracker once it exists, unless play has ended since
+	void RegisterWithMapTracker(UMapTrackerComponent* Tracker);
+
 	// 
 	void InitializeDynamicRenderTargets();
 
@@ -220,6 +225,11 @@ private:
 
 	// The time at which the material was last changed, used to update the material instance's Time parameter
 	float AnimStartTime;
+	// The tracker this background registered itself to
+	UPROPERTY(Transient)
+	UMapTrackerComponent* MapTracker = nullptr;
+	// Handle in the tracker's background registry, used to unregister
+	FMapRegistryHandle TrackerHandle;
 
 	// Used to generate a background if no hand drawn background texture is set
 	UPROPERTY(VisibleAnywhere, Category = "Minimap Background Generation")
@@ -26,6 +26,45 @@ enum class EMapFogRevealMode : uint8
 	Permanent,
 };
 
+// Where a MapFog keeps track of revealed areas
+UENUM(BlueprintType)
+enum class EMapFogBackend : uint8
+{
+	// Revealers draw their RevealMaterial to render targets every frame. Gameplay queries read the render targets back from the GPU.
+	GPU,
+	// Revealers stamp their RevealShape into a grid on the CPU, and only changed rows are uploaded to a texture for drawing.
+	// Gameplay queries read the grid directly, and the fog works without rendering.
+	CPU,
+};
+
+// Shape of the area a revealer reveals in fog that uses the CPU backend
+UENUM(BlueprintType)
+enum class EMapRevealShape : uint8
+{
+	Circle,
+	Rectangle,
+};
+
+// Pixel format of a MapFog's render targets, or of its fog texture with the CPU backend. Fog only uses the R and G channels.
+UENUM(BlueprintType)
+enum class EMapFogTextureFormat : uint8
+{
+	// 16-bit float RGBA, 8 bytes per texel. The CPU backend uploads 8-bit BGRA instead, since its grid has 8 bits per layer.
+	RGBA16F,
+	// 8-bit RG, 2 bytes per texel
+	RG8,
+};
+
+// How a MapFog keeps fog read back from the GPU for gameplay queries
+UENUM(BlueprintType)
+enum class EMapFogReadbackFormat : uint8
+{
+	// One byte per texel, holding the reveal factor in 256 steps
+	Byte,
+	// One bit per texel, set if the texel is at least half revealed. Queries only return 0 or 1.
+	Bit,
+};
+
 // Icon size can be defined in screen or world units
 UENUM(BlueprintType)
 enum class EIconFogInteraction : uint8
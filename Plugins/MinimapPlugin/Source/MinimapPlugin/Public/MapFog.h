@@ -4,10 +4,15 @@
 
 #include "MapAreaBase.h"
 #include "MapEnums.h"
+#include "MapSlotMap.h"
+#include "MapFogGrid.h"
 #include "MapFog.generated.h"
 
 class UMapRevealerComponent;
+class UMapTrackerComponent;
 class APostProcessVolume;
+class FMapFogReadback;
+struct FMapFogSnapshot;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapFogMaterialChangedSignature, AMapFog*, MapFog);
 
@@ -23,14 +28,48 @@ public:
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Tick( float DeltaSeconds ) override;
 	
-	// Retrieves fog at location. Returns true if the location was covered by this MapFog. Warning: Reads from render target which is expensive, but only does this once per frame.
+	// Retrieves fog at location. Returns true if the location was covered by this MapFog. With the GPU backend, reads the render target's CPU copy,
+	// which is a few frames old if bAsyncFogReadback is set and stalls on the GPU otherwise. With the CPU backend, reads the fog grid directly.
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	bool GetFogAtLocation(const FVector& WorldLocation, const bool bRequireCurrentlyRevealing, float& RevealFactor);
+	// Reads the requested fog buffers from the GPU like GetFogAtLocation, and describes them for sampling on other threads.
+	// The snapshot is valid until the fog's cached buffers are read again or replaced by a finished readback, which doesn't happen before the next tick.
+	void GetFogSnapshot(const bool bPermanent, const bool bCurrentlyRevealing, FMapFogSnapshot& OutSnapshot);
 	
+	// Returns the texture that fog materials sample: the destination render target with the GPU backend, or the texture that the fog grid is
+	// uploaded to with the CPU backend. R-channel is permanently revealed, G-channel is currently revealing.
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	UTexture* GetFogTexture() const;
+	// Returns the backend that keeps track of revealed areas
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	EMapFogBackend GetFogBackend() const;
+	// Returns the width and height in cells of the fog's render targets or grid
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	int32 GetFogGridSize() const;
+	// Returns the CPU fog grid. Only meaningful with the CPU backend.
+	const FMapFogGrid& GetFogGrid() const;
+	// Serializes which areas are permanently explored into a compact, versioned blob, for example for save games. See FMapFogState.
+	// With the GPU backend, this reads the permanent render target back from the GPU, which stalls the game thread. Returns false before BeginPlay.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	bool SaveFogState(TArray<uint8>& OutData);
+	// Replaces the permanently explored areas with a state from SaveFogState(). States saved with another fog size are resampled.
+	// Returns false if the data isn't a fog state, or before BeginPlay.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	bool LoadFogState(const TArray<uint8>& Data);
+	// Traces the height of every fog grid cell again, for example after level geometry has changed. Only does something with the CPU backend
+	// and bLineOfSight, in which case it happens on BeginPlay as well. Takes a line trace per cell, spread over frames by OccluderBakeRowsPerFrame.
+	// The previous heights stay in use until all cells are traced, so revealers see past everything until the first bake completes.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void BakeFogOccluders();
+	// Returns how many seconds ago the fog that gameplay queries read was captured on the GPU. Zero with the CPU backend.
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	float GetFogReadbackAge(const bool bCurrentlyRevealing) const;
+
 	// Returns the texture that stores what area is revealed. Double buffering is used. This will retrieve the render target that is written to this frame.
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	UTextureRenderTarget2D* GetDestinationFogRenderTarget() const;
 	// Returns the texture that stores what area is revealed. Double buffering is used. This will retrieve the render target that is read from this frame.
+	// Both render targets are null with the CPU backend, see GetFogTexture().
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	UTextureRenderTarget2D* GetSourceFogRenderTarget() const;
 	// Returns the ratio between world units and pixels
@@ -53,6 +92,22 @@ public:
 
 private:
 	void InitializeWorldFog();
+	// Stamps all revealers into the fog grid and uploads the rows that changed. Used instead of drawing with the CPU backend.
+	void UpdateFogGrid();
+	// Copies the fog grid's changed rows to the fog texture
+	void UploadDirtyFogRows();
+	// Traces the next rows of the bake started by BakeFogOccluders(), and hands the heights to the fog grid once all rows are traced
+	void UpdateOccluderBake();
+	// Points the fog materials at the texture they should sample
+	void UpdateFogTextureParameters();
+	// Reads a fog render target into its CPU buffer, unless it was read recently enough, and returns the buffer.
+	// With bAsyncFogReadback, only asks for the buffer to be refreshed and returns the latest finished copy.
+	// The buffer holds cells as described by FMapFogSnapshot, packed as bits if FogReadbackFormat says so.
+	const TArray<uint8>& ReadFogBuffer(const bool bCurrentlyRevealing);
+	// Takes finished readbacks into the fog buffers and requests new copies of the buffers that were asked for
+	void UpdateFogReadbacks();
+	// Registers the fog with the tracker once it exists, unless play has ended since
+	void RegisterWithMapTracker(UMapTrackerComponent* Tracker);
 
 	UFUNCTION()
 	void OnMapRevealerRegistered(UMapRevealerComponent* MapRevealer);
@@ -65,10 +120,25 @@ public:
 	FMapFogMaterialChangedSignature OnMapFogMaterialChanged;
 
 protected:
+	// Where revealed areas are kept. The CPU backend makes gameplay fog queries cheap and skips the per-frame render target passes, but
+	// revealers reveal their RevealShape instead of their RevealMaterial and FogCombineMaterial isn't used.
+	UPROPERTY(EditAnywhere, Category = "Minimap Fog")
+	EMapFogBackend FogBackend = EMapFogBackend::GPU;
+	// If true, revealers can't see past cells that are higher than their eyes, see UMapRevealerComponent::bUseLineOfSight. Only with the CPU backend.
+	// Cell heights are found by tracing down through the fog volume against WorldStatic geometry, such as landscapes and static meshes.
+	UPROPERTY(EditAnywhere, Category = "Minimap Fog")
+	bool bLineOfSight = false;
+	// How many rows of fog grid cells BakeFogOccluders() traces per frame
+	UPROPERTY(EditAnywhere, Category = "Minimap Fog", meta = (EditCondition = "bLineOfSight", ClampMin = "1"))
+	int32 OccluderBakeRowsPerFrame = 8;
 	// Width and height of the texture in which vision information is stored. Increase to have more detailed fog boundaries at the cost of performance.
 	// Especially if you use GetFogAtLocation() or any icon is configured to show/hide based on fog, having a large render target size will impact performance.
 	UPROPERTY(EditAnywhere, Category = "Minimap Fog")
 	int32 FogRenderTargetSize = 256;
+	// Pixel format of the fog render targets, or of the fog texture with the CPU backend. RG8 takes a quarter of the memory of RGBA16F
+	// and fog materials sample it the same way, but reveal materials and FogCombineMaterial can only write values from 0 to 1 in 256 steps.
+	UPROPERTY(EditAnywhere, Category = "Minimap Fog")
+	EMapFogTextureFormat FogTextureFormat = EMapFogTextureFormat::RGBA16F;
 	// This material is used to render the fog in UMG. It receives the fog data as two texture inputs named 'FogRevealedPermanent' and 'FogRevealedTemporary'.
 	UPROPERTY(EditAnywhere, Category = "Minimap Fog")
 	UMaterialInterface* FogMaterial_UMG = nullptr;
@@ -90,8 +160,16 @@ protected:
 	
 	// If you call GetFogAtLocation() or if any icons are configured to show/hide based on fog, texture data will be retrieved from the GPU. Because this is a slow operation, the retrieved data 
 	// is cached and reused for a duration. This setting controls that duration. You can increase it for better performance but delayed response to fog.
+	// With bAsyncFogReadback, this is the time between copies requested from the GPU instead.
 	UPROPERTY(EditAnywhere, Category = "Gameplay Fog")
 	float FogCacheLifetime = 0.05f;
+	// If true, fog is copied from the GPU without waiting for it and gameplay queries read the latest copy that finished, which lags a few frames behind.
+	// If false, queries read the current fog, but each read stalls the game thread until the GPU has caught up.
+	UPROPERTY(EditAnywhere, Category = "Gameplay Fog")
+	bool bAsyncFogReadback = true;
+	// How fog read back from the GPU is kept for gameplay queries. Bits take an eighth of the memory of bytes, but only tell revealed from hidden.
+	UPROPERTY(EditAnywhere, Category = "Gameplay Fog")
+	EMapFogReadbackFormat FogReadbackFormat = EMapFogReadbackFormat::Byte;
 
 	// If true, will apply fog to world as a post process effect
 	UPROPERTY(EditAnywhere, Category = "World Fog")
@@ -143,12 +221,35 @@ private:
 	bool bStagingRT_Read = false;
 	float PermanentRT_LastReadTime = 0.0f;
 	float StagingRT_LastReadTime = 0.0f;
-	TArray<FLinearColor> PermanentRT_Buffer;
-	TArray<FLinearColor> StagingRT_Buffer;
+	TArray<uint8> PermanentRT_Buffer;
+	TArray<uint8> StagingRT_Buffer;
+	// Asynchronous readbacks. A buffer is asked for by queries and copied at most once per FogCacheLifetime, so LastReadTime is when its copy was requested.
+	TSharedPtr<FMapFogReadback, ESPMode::ThreadSafe> PermanentRT_Readback;
+	TSharedPtr<FMapFogReadback, ESPMode::ThreadSafe> StagingRT_Readback;
+	bool bPermanentRT_Wanted = false;
+	bool bStagingRT_Wanted = false;
+	float PermanentRT_LastRequestTime = -BIG_NUMBER;
+	float StagingRT_LastRequestTime = -BIG_NUMBER;
+
+	// Revealed areas with the CPU backend, and the texture they are uploaded to for fog materials.
+	// The texture isn't created when nothing can be rendered, such as on headless builds.
+	FMapFogGrid FogGrid;
+	UPROPERTY(Transient)
+	UTexture2D* FogTexture = nullptr;
+	// Footprints of the revealers, gathered every tick
+	TArray<FMapFogRevealStamp> RevealStamps;
+	// Heights traced so far by an occluder bake, and the next row to trace, or INDEX_NONE if no bake is in progress
+	TArray<float> PendingOccluderHeights;
+	int32 NextOccluderBakeRow = INDEX_NONE;
 
-	// Keep track of all fog revealers
+	// Keep track of all fog revealers. A set, so that revealers can be forgotten in constant time.
+	UPROPERTY(Transient)
+	TSet<UMapRevealerComponent*> MapRevealers;
+	// The tracker this fog registered itself to
 	UPROPERTY(Transient)
-	TArray<UMapRevealerComponent*> MapRevealers;
+	UMapTrackerComponent* MapTracker = nullptr;
+	// Handle in the tracker's fog registry, used to unregister
+	FMapRegistryHandle TrackerHandle;
 
 		
 };
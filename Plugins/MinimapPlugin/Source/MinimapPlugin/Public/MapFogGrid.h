@@ -0,0 +1,96 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// One revealer's footprint in a fog grid, computed on the game thread so that stamping can run on any thread.
+// See UMapRevealerComponent::GetFogRevealStamp().
+struct MINIMAPPLUGIN_API FMapFogRevealStamp
+{
+	// Center in cells, where cell (X, Y) spans X to X + 1
+	FVector2D Center = FVector2D::ZeroVector;
+	// Half size of the fully revealed area, in cells
+	FVector2D Extent = FVector2D::ZeroVector;
+	// Distance in cells beyond Extent over which the reveal strength drops to zero
+	float DropOff = 0.0f;
+	// Rotation of the footprint within the grid
+	float Cos = 1.0f;
+	float Sin = 0.0f;
+	// Whether the footprint is an ellipse or a rectangle
+	bool bCircular = true;
+	// Whether the revealed area stays explored after the revealer leaves
+	bool bPermanent = false;
+	// Whether cells that are higher than EyeHeight block the view, in grids with occluder heights
+	bool bLineOfSight = false;
+	// World Z from which the revealer looks out
+	float EyeHeight = 0.0f;
+
+	// Computes the cells that the stamp may touch, clamped to a grid. Returns false if it touches none.
+	bool GetCellBounds(const int32 GridSize, FIntRect& OutBounds) const;
+	// Reveal strength at a cell center, from 0 to 255
+	uint8 GetRevealAt(const float CellX, const float CellY) const;
+};
+
+// Fog of war kept on the CPU, as one byte per cell for the permanently explored and the currently revealing layers.
+// Gameplay queries read the cells directly, and only rows that changed need to be uploaded to a texture for drawing.
+class MINIMAPPLUGIN_API FMapFogGrid
+{
+public:
+	// Resizes the grid to Size x Size cells and clears both layers
+	void Init(const int32 InSize);
+	int32 GetSize() const { return Size; }
+
+	// Rebuilds the currently revealing layer from the stamps and adds permanent stamps to the explored layer.
+	// First the workers shadowcast the stamps that need line of sight, each taking every NumWorkers-th stamp.
+	// Then rows are spread over the workers, each stamping the stamps that overlap its rows, so that no two workers write to
+	// the same cell. Uses GetDefaultNumWorkers() if NumWorkers isn't positive.
+	void Update(const TArray<FMapFogRevealStamp>& Stamps, int32 NumWorkers = 0);
+
+	// Sets the world Z of each cell's ground or geometry, as Size x Size values, which blocks the view of stamps with line of sight.
+	// Pass an empty array to let all stamps see through everything.
+	void SetOccluderHeights(TArray<float>&& Heights);
+	const TArray<float>& GetOccluderHeights() const { return OccluderHeights; }
+
+	// Explored cells stay revealed once revealed by a permanent stamp. Revealing cells are revealed by any stamp this update.
+	const TArray<uint8>& GetPermanentCells() const { return PermanentCells; }
+	const TArray<uint8>& GetRevealingCells() const { return RevealingCells; }
+	// Replaces the explored layer, for example when loading a saved fog state. Expects Size x Size cells.
+	void SetPermanentCells(const TArray<uint8>& Cells);
+
+	// Columns that changed per row since the last ClearDirtyRows(), as inclusive Min to Max. Clean rows have Min > Max.
+	const TArray<FIntPoint>& GetDirtyRowSpans() const { return DirtyRowSpans; }
+	bool HasDirtyRows() const { return bHasDirtyRows; }
+	void ClearDirtyRows();
+	// Marks all cells as changed, for example after replacing the contents of the grid
+	void MarkAllDirty();
+
+	// Spreads the rows over the task graph, keeping enough rows per worker to be worth the scheduling
+	static int32 GetDefaultNumWorkers(const int32 GridSize, const int32 NumStamps);
+
+	// Fewest rows per worker when choosing the number of workers automatically
+	static const int32 MinRowsPerWorker = 32;
+
+private:
+	// Stamps the rows from FirstRow up to EndRow and records what changed in them
+	void UpdateRows(const int32 FirstRow, const int32 EndRow, const TArray<FMapFogRevealStamp>& Stamps, const TArray<FIntRect>& StampBounds);
+	// Widens a row's dirty span to include the columns from MinX to MaxX
+	void MarkRowDirty(const int32 Row, const int32 MinX, const int32 MaxX);
+	// Finds the cells within Bounds that the stamp's center cell can see past the occluders.
+	// Leaves OutVisible empty if the stamp sees everything, which is the case for stamps centered outside of the grid.
+	void ComputeStampVisibility(const FMapFogRevealStamp& Stamp, const FIntRect& Bounds, TArray<uint8>& OutVisible) const;
+
+	int32 Size = 0;
+	TArray<uint8> PermanentCells;
+	TArray<uint8> RevealingCells;
+	// The revealing layer of the previous update, to detect which cells changed
+	TArray<uint8> PreviousRevealingCells;
+	TArray<FIntPoint> DirtyRowSpans;
+	bool bHasDirtyRows = false;
+	// Cells each stamp touches, kept between updates so that updating doesn't allocate
+	TArray<FIntRect> StampBounds;
+	// Empty, or the world Z of each cell
+	TArray<float> OccluderHeights;
+	// Per stamp, a byte per cell of its bounds that's nonzero if the stamp can see the cell. Empty for stamps that see everything.
+	TArray<TArray<uint8>> StampVisibility;
+};
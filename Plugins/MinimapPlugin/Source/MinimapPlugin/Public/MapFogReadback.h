@@ -0,0 +1,65 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "PixelFormat.h"
+#include "Templates/Function.h"
+
+class FRHIGPUTextureReadback;
+class FRHICommandListImmediate;
+class FRHITexture;
+class UTextureRenderTarget2D;
+
+// Copies a fog render target back from the GPU without waiting for it, see AMapFog::bAsyncFogReadback.
+// Two copies can be in flight at once. The render thread polls them and hands each finished copy over to the game thread,
+// converted to cells as described by FMapFogSnapshot.
+// Shared with the render commands it enqueues, so that it stays alive until they have run.
+class MINIMAPPLUGIN_API FMapFogReadback : public TSharedFromThis<FMapFogReadback, ESPMode::ThreadSafe>
+{
+public:
+	explicit FMapFogReadback(const bool bInPackedBits);
+	~FMapFogReadback();
+
+	// Polls the copies in flight on the render thread, and if requested also starts a new copy of the render target.
+	// A new copy is dropped if both copies are still in flight. Does nothing if there's nothing to poll or request.
+	void Tick(UTextureRenderTarget2D* RenderTarget, const bool bRequestCopy, const float RequestTime);
+	// Moves the newest copy that finished since the last call into OutBuffer, along with the time it was requested.
+	// Returns false if none finished, leaving OutBuffer untouched.
+	bool Consume(TArray<uint8>& OutBuffer, float& OutRequestTime);
+	// Copies that were requested but haven't been handed over yet
+	int32 GetNumInFlight() const { return NumInFlight.GetValue(); }
+
+	// Copies a render target back from the GPU and waits for it, which stalls the game thread. Calls Visitor with the index, R and G channels
+	// of each texel from 0 to 1, in the same formats as the asynchronous copies. Returns false if the render target couldn't be read.
+	static bool ReadBlocking(UTextureRenderTarget2D* RenderTarget, TFunctionRef<void(int32, float, float)> Visitor);
+
+private:
+	struct FSlot
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		float RequestTime = 0.0f;
+		FIntPoint Size = FIntPoint::ZeroValue;
+		EPixelFormat Format = PF_Unknown;
+		bool bInFlight = false;
+	};
+
+	void EnqueueCopy_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture* Texture, const float RequestTime);
+	void Poll_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+	// Whether cells are packed eight per byte
+	const bool bPackedBits;
+
+	// Only touched on the render thread
+	FSlot Slots[2];
+	TArray<uint8> ConvertBuffer;
+
+	// Finished copy waiting for the game thread
+	FCriticalSection CompletedLock;
+	TArray<uint8> CompletedBuffer;
+	float CompletedRequestTime = 0.0f;
+	bool bHasCompleted = false;
+
+	FThreadSafeCounter NumInFlight;
+};
@@ -0,0 +1,29 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Binary format of a fog's permanently explored cells, see AMapFog::SaveFogState().
+// A header with a version and the grid size is followed by the cells run-length encoded as value and length pairs,
+// compressed with zlib if that is smaller. Explored areas are mostly large runs of 0 and 255, so states take a few KB.
+class MINIMAPPLUGIN_API FMapFogState
+{
+public:
+	// Encodes Size x Size cells from 0 to 255
+	static void Encode(const uint8* Cells, const int32 Size, TArray<uint8>& OutData);
+	// Decodes data written by Encode(). Returns false if it isn't a fog state of a known version, or if it is corrupt.
+	static bool Decode(const TArray<uint8>& Data, int32& OutSize, TArray<uint8>& OutCells);
+	// Scales square cells to another size, picking the nearest cell
+	static void Resample(const TArray<uint8>& Cells, const int32 Size, const int32 NewSize, TArray<uint8>& OutCells);
+
+	static const uint32 Magic = 0x474F464D;
+	// Increase when changing the format, and keep decoding older versions
+	static const uint16 Version = 1;
+
+private:
+	enum EFlags : uint8
+	{
+		Flag_Zlib = 1 << 0,
+	};
+};
@@ -0,0 +1,92 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "UObject/Object.h"
+#include "MapIconAtlas.generated.h"
+
+class UTexture2D;
+class UTextureRenderTarget2D;
+
+// Where a texture is packed in the icon atlas
+struct FMapIconAtlasEntry
+{
+	// Index of the atlas page render target
+	int32 Page = 0;
+	// UV region of the page covered by the texture
+	FVector2D UVMin = FVector2D::ZeroVector;
+	FVector2D UVSize = FVector2D::UnitVector;
+	// Pixel region of the page covered by the texture
+	FIntRect Rect;
+	// Whether the texture was drawn into its page yet, see UMapIconAtlas::FlushPendingDraws()
+	bool bDrawn = false;
+};
+
+// Packs icon textures into a few render target pages, so that icons with different textures can be drawn in a single batch.
+// Textures are added on demand and never move once packed, so adding a texture only draws that texture into its page.
+// Owned by the map tracker, see UMapTrackerComponent::GetIconAtlas().
+UCLASS()
+class MINIMAPPLUGIN_API UMapIconAtlas : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Entry of textures that could not be packed, because they're null or all pages are full
+	static const uint16 NoEntry = MAX_uint16;
+
+	// Returns the entry of a texture, packing it into a page if it isn't yet. The texture is drawn into its page on the next FlushPendingDraws().
+	uint16 FindOrAddTexture(UTexture2D* Texture);
+	// Packs all icon textures shipped with the plugin, so that the most common icons don't have to be packed during play
+	void AddPluginIconTextures();
+	// Draws newly packed textures into their pages. Textures that aren't fully streamed in yet are drawn again on later calls.
+	// Opens a render target canvas per page, so call it outside of any other render target draw, such as from tick.
+	void FlushPendingDraws();
+
+	const FMapIconAtlasEntry& GetEntry(const uint16 Entry) const
+	{
+		return Entries[Entry];
+	}
+	UTextureRenderTarget2D* GetPage(const int32 Page) const
+	{
+		return Pages[Page];
+	}
+	int32 GetNumPages() const
+	{
+		return Pages.Num();
+	}
+
+	// Width and height of each page in pixels
+	int32 PageSize = 1024;
+	// Textures are scaled down to at most this many pixels wide and high. Minimap icons are rarely drawn larger.
+	int32 MaxEntrySize = 64;
+	// Empty pixels between packed textures, so that filtering doesn't bleed neighbouring icons into each other
+	int32 EntryPadding = 2;
+	// Textures that don't fit in this many pages are left out and drawn unbatched
+	int32 MaxPages = 4;
+
+private:
+	// A row of packed textures. Textures are added to the first shelf that is high enough and has room left.
+	struct FShelf
+	{
+		int32 Y;
+		int32 Height;
+		int32 NextX;
+	};
+
+	// Finds room for a rectangle of the given size, adding a page if needed
+	bool Allocate(const FIntPoint& Size, int32& OutPage, FIntPoint& OutPosition);
+
+	UPROPERTY(Transient)
+	TArray<UTextureRenderTarget2D*> Pages;
+	// Shelves per page
+	TArray<TArray<FShelf>> PageShelves;
+
+	// Packed textures, indexed by entry
+	UPROPERTY(Transient)
+	TArray<UTexture2D*> EntryTextures;
+	TArray<FMapIconAtlasEntry> Entries;
+	TMap<UTexture2D*, uint16> EntryIndices;
+	// Entries that still need to be drawn into their page
+	TArray<uint16> PendingDraws;
+
+};
@@ -4,6 +4,7 @@
 
 #include "Components/BillboardComponent.h"
 #include "MapEnums.h"
+#include "MapSlotMap.h"
 #include "MapIconComponent.generated.h"
 
 class UMapTrackerComponent;
@@ -21,6 +22,50 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapIconHoverStartSignature, UMapIco
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapIconHoverEndSignature, UMapIconComponent*, MapIcon);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FMapIconClickedSignature, UMapIconComponent*, MapIcon, bool, bIsLeftMouse);
 
+// Recent locations of an icon in a fixed-capacity ring buffer, so that recording them doesn't allocate once the trail is set up.
+// Only for internal use.
+struct MINIMAPPLUGIN_API FMapIconTrail
+{
+	// Sets the capacity and forgets all points. Only allocates if the capacity grows.
+	void Reset(const int32 Capacity)
+	{
+		Locations.SetNumUninitialized(Capacity, false);
+		Times.SetNumUninitialized(Capacity, false);
+		Head = 0;
+		Count = 0;
+	}
+
+	// Appends a point, overwriting the oldest point once the buffer is full
+	void Add(const FVector2D& Location, const float Time)
+	{
+		if (Locations.Num() == 0)
+			return;
+		Locations[Head] = Location;
+		Times[Head] = Time;
+		Head = (Head + 1) % Locations.Num();
+		Count = FMath::Min(Count + 1, Locations.Num());
+	}
+
+	// Number of recorded points
+	int32 Num() const { return Count; }
+	// Points are numbered from the oldest (0) to the newest (Num() - 1)
+	const FVector2D& GetLocation(const int32 Point) const { return Locations[ToBufferIndex(Point)]; }
+	float GetTime(const int32 Point) const { return Times[ToBufferIndex(Point)]; }
+
+private:
+	int32 ToBufferIndex(const int32 Point) const
+	{
+		const int32 Index = Head - Count + Point;
+		return Index < 0 ? Index + Locations.Num() : Index;
+	}
+
+	TArray<FVector2D> Locations;
+	TArray<float> Times;
+	// Where the next point is written
+	int32 Head = 0;
+	int32 Count = 0;
+};
+
 // A MapIconComponent represents an icon to render on minimaps. 
 // To make an actor appear on a minimap, add this component to it and then configure it. Icon properties can be 
 // set in C++ and in blueprint. Properties can be changed during gameplay and any changes will fire events so 
@@ -95,6 +140,13 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	FName GetIconTooltipText() const;
 
+	// Sets the icon's category, which views can hide via MapView->SetIconCategoryVisible()
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void SetIconCategory(FName NewIconCategory);
+	// Retrieves the icon's category
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	FName GetIconCategory() const;
+
 	// Sets the icon's visibility on minimap
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
 	void SetIconVisible(const bool bNewVisible);
@@ -189,6 +241,30 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	float GetIconFogRevealThreshold() const;
 	
+	// Sets whether the icon leaves a trail of its recent movement on canvas minimaps
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void SetTrailEnabled(const bool bNewTrailEnabled);
+	// Retrieves whether the icon leaves a trail of its recent movement on canvas minimaps
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	bool IsTrailEnabled() const;
+	// Forgets the icon's trail, for example after teleporting
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void ClearTrail();
+	// Sets the trail's color. Its alpha fades out towards the oldest points.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void SetTrailColor(const FLinearColor& NewTrailColor);
+	// Retrieves the trail's color
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	FLinearColor GetTrailColor() const;
+	// Retrieves the trail's width in pixels prior to DPI scaling
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	float GetTrailWidth() const;
+	// Retrieves how many seconds trail points stay visible, or 0 if they stay until overwritten
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	float GetTrailLifetime() const;
+	// Retrieves the recorded trail points. Only for internal use.
+	const FMapIconTrail& GetTrail() const;
+
 	// Retrieves material instance to render the icon with on HUD Canvas.
 	UMaterialInstanceDynamic* GetIconMaterialInstanceForCanvas(UMapRendererComponent* Renderer);
 	// Retrieves material instance to render objective arrow with on HUD Canvas.
@@ -211,12 +287,29 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
 	void ReceiveClicked(const bool bIsLeftMouseButton);
 
+	// Registers the icon with the tracker once it exists, unless it already is or has ended play. Only for internal use.
+	void RegisterWithMapTracker(UMapTrackerComponent* Tracker);
+	// Sets the handle assigned by the tracker on registration. Only for internal use.
+	void SetIconHandle(const FMapIconHandle& NewIconHandle);
+	// Retrieves the icon's handle in the tracker's registry, which can be held without keeping the icon alive. Unset while not registered.
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	FMapIconHandle GetIconHandle() const;
+
 private:
 	// Updates the preview sprite to show in the editor viewport
 	void RefreshPreviewSprite();
+	// Records the icon's location in its trail if it moved far enough from the last recorded point
+	void RecordTrailPoint();
 
 	// Mark the icon not rendered from all views, firing OnViewLeft events. Called, for example, prior to removing the icon from the world.
 	void UnmarkRenderedFromAllViews();
+	// Lets the tracker know that properties it keeps track of have changed
+	void NotifyTrackerPropertiesChanged();
+
+protected:
+	// Begin USceneComponent interface
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport = ETeleportType::None) override;
+	// End USceneComponent interface
 
 public:
 	// Event that fires whenever the icon's appearance changes
@@ -298,6 +391,26 @@ protected:
 	UPROPERTY(EditAnywhere, Category = "Minimap Objective Arrow", meta = (EditCondition = "bObjectiveArrowEnabled", ClampMin = "1.0"))
 	float ObjectiveArrowSize = 50.0f;
 	
+	// Whether the icon leaves a trail of its recent movement on canvas minimaps. Trails are recorded when the icon moves,
+	// so they cost nothing for icons that stand still.
+	UPROPERTY(EditAnywhere, Category = "Minimap Trail")
+	bool bTrailEnabled = false;
+	// Most points kept in the trail. Once full, new points overwrite the oldest.
+	UPROPERTY(EditAnywhere, Category = "Minimap Trail", meta = (EditCondition = "bTrailEnabled", ClampMin = "2"))
+	int32 TrailMaxPoints = 32;
+	// World distance the icon must move before a new trail point is recorded
+	UPROPERTY(EditAnywhere, Category = "Minimap Trail", meta = (EditCondition = "bTrailEnabled", ClampMin = "1.0"))
+	float TrailSampleDistance = 200.0f;
+	// Seconds a trail point stays visible while fading out. Set to 0 to keep points until they are overwritten, fading towards the oldest.
+	UPROPERTY(EditAnywhere, Category = "Minimap Trail", meta = (EditCondition = "bTrailEnabled", ClampMin = "0"))
+	float TrailLifetime = 10.0f;
+	// Width of the trail in pixels prior to DPI scaling
+	UPROPERTY(EditAnywhere, Category = "Minimap Trail", meta = (EditCondition = "bTrailEnabled", ClampMin = "0.1"))
+	float TrailWidth = 3.0f;
+	// Color of the trail at the icon. Its alpha fades out towards the oldest points.
+	UPROPERTY(EditAnywhere, Category = "Minimap Trail", meta = (EditCondition = "bTrailEnabled"))
+	FLinearColor TrailColor = FLinearColor(1.0f, 1.0f, 1.0f, 0.6f);
+	
 	// Must be enabled to support tooltips and mouse events (OnIconClicked, OnIconHoverStart, etc). Disable to ensure this icon doesn't block other icons' mouse interaction.
 	UPROPERTY(EditAnywhere, Category = "Minimap Mouse Interaction")
 	bool bIconInteractable = true;
@@ -319,6 +432,10 @@ protected:
 	bool bHideOwnerInsideFog = false;
 	
 private:
+	// The tracker this icon registered itself to. Cached so that moving the icon doesn't require looking up the tracker.
+	UPROPERTY(Transient)
+	UMapTrackerComponent* MapTracker = nullptr;
+
 	// Tracks per view whether the icon is currently rendered in it
 	UPROPERTY(Transient)
 	TMap<UMapViewComponent*, bool> IsRenderedPerView;
@@ -342,5 +459,9 @@ private:
 	float MaterialEffectStartTime = 0;
 	// Mouse-over state which is tracked to ensure that a 'start' event can only be followed by an 'end' event and vice versa.
 	bool bMouseOverStarted = false;
+	// Handle in the tracker's icon registry, assigned by the tracker
+	FMapIconHandle IconHandle;
+	// Recent locations, recorded while bTrailEnabled is set
+	FMapIconTrail Trail;
 	
 };
@@ -0,0 +1,159 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FMapIconRenderCache;
+class UMapTrackerComponent;
+
+// A copy of a map view's transform, so that view tests and conversions can run on any thread.
+// See UMapViewComponent::GetViewSnapshot().
+struct MINIMAPPLUGIN_API FMapViewSnapshot
+{
+	// World XY location of the view's center
+	FVector2D Location = FVector2D::ZeroVector;
+	// World XY half size of the view
+	FVector2D ScaledExtent = FVector2D::ZeroVector;
+	FTransform InverseTransform;
+	FVector2D InverseViewSize = FVector2D::ZeroVector;
+
+	// Same as UMapViewComponent::ViewContains
+	bool Contains(const FVector& WorldPos, const float WorldRadius) const
+	{
+		const float ViewRadiusSquared = FMath::Square(ScaledExtent.X + WorldRadius) + FMath::Square(ScaledExtent.Y + WorldRadius);
+		return FVector2D::DistSquared(FVector2D(WorldPos), Location) < ViewRadiusSquared;
+	}
+
+	// Same as UMapViewComponent::GetViewCoordinates for rectangular views
+	bool GetViewCoordinates(const FVector& WorldPos, float& U, float& V) const
+	{
+		const FVector LocalPos = InverseTransform.TransformPosition(WorldPos);
+		U = 0.5f + InverseViewSize.X * LocalPos.X;
+		V = 0.5f + InverseViewSize.Y * LocalPos.Y;
+		return !(U < 0 || U > 1 || V < 0 || V > 1);
+	}
+};
+
+// A fog's revealed areas as last read back from the GPU, so that fog can be sampled on any thread.
+// The buffers are owned by the fog and stay valid until its next read back, see AMapFog::GetFogSnapshot().
+struct MINIMAPPLUGIN_API FMapFogSnapshot
+{
+	FMapViewSnapshot View;
+	int32 Size = 0;
+	// Size x Size cells from 0 to 255, or packed eight cells per byte if bPackedBits. Null if not requested when taking the snapshot.
+	// Read back buffers hold the larger of a texel's R and G channels. Fogs that use the CPU backend point at their grid's layers.
+	const uint8* PermanentCells = nullptr;
+	const uint8* CurrentlyRevealingCells = nullptr;
+	bool bPackedBits = false;
+
+	// Same as AMapFog::GetFogAtLocation. Returns false if the location isn't covered by this fog or the buffer wasn't requested.
+	bool GetFogAtLocation(const FVector& WorldLocation, const bool bRequireCurrentlyRevealing, float& RevealFactor) const;
+	// Samples cells at view coordinates
+	static float SampleCells(const uint8* Cells, const int32 Size, const float U, const float V);
+	// Samples cells packed eight per byte at view coordinates, see EMapFogReadbackFormat::Bit
+	static float SampleBits(const uint8* Bits, const int32 Size, const float U, const float V);
+
+	// Number of bytes that hold NumCells cells
+	static int32 GetNumBytes(const int32 NumCells, const bool bPackedBits)
+	{
+		return bPackedBits ? (NumCells + 7) / 8 : NumCells;
+	}
+	// Stores a reveal factor from 0 to 1 in a cell
+	static void WriteCell(uint8* Cells, const int32 CellIndex, const float Reveal, const bool bPackedBits)
+	{
+		if (!bPackedBits)
+			Cells[CellIndex] = static_cast<uint8>(FMath::RoundToInt(255.0f * FMath::Clamp(Reveal, 0.0f, 1.0f)));
+		else if (Reveal >= 0.5f)
+			Cells[CellIndex >> 3] |= 1 << (CellIndex & 7);
+		else
+			Cells[CellIndex >> 3] &= ~(1 << (CellIndex & 7));
+	}
+};
+
+// Radius of the circle through an icon's corners per unit of icon size, half of the square's diagonal.
+// Not using #define here because it may interfere with end user #defines.
+static const float ICONSIZE_TO_OUTERRADIUS = 0.70710678f;
+
+// Everything icon culling reads besides the icon render cache, taken on the game thread before culling
+struct MINIMAPPLUGIN_API FMapIconCullParams
+{
+	FMapViewSnapshot View;
+	// Fogs in the tracker's order. Icons are only tested against fog if this isn't empty.
+	TArray<FMapFogSnapshot> Fogs;
+	// Converts screen space and world space icon sizes to pixels
+	float DPIScale = 1.0f;
+	float PixelToWorldRatio = 1.0f;
+	float WorldToPixelRatio = 1.0f;
+	// Whether the view is inside any background, in which case icons may be hidden by multi-level backgrounds.
+	// That test reads actors, so it's left to the caller for the icons in NeedsBackgroundLevelCheck.
+	bool bCheckBackgroundLevels = false;
+};
+
+// Output of icon culling. All values are indices into the icon render cache, in no particular order.
+struct MINIMAPPLUGIN_API FMapIconCullResult
+{
+	// Icons that passed all tests
+	TArray<int32> Visible;
+	// Icons that passed all tests, but still need the background level test
+	TArray<int32> NeedsBackgroundLevelCheck;
+	// Icons that are outside of the view
+	TArray<int32> LeftView;
+
+	void Reset()
+	{
+		Visible.Reset();
+		NeedsBackgroundLevelCheck.Reset();
+		LeftView.Reset();
+	}
+};
+
+// Filters icon candidates on visibility, size, material, view bounds and fog, optionally spread over task graph workers.
+// Workers only read the render cache and the parameters, and write to their own buffers, which are merged afterwards.
+// Keeps those buffers between calls, so that culling every frame doesn't allocate.
+class MINIMAPPLUGIN_API FMapIconCuller
+{
+public:
+	// Culls Candidates into OutResult. Uses GetDefaultNumWorkers() if NumWorkers isn't positive.
+	void Cull(const FMapIconRenderCache& Cache, const TArray<int32>& Candidates, const FMapIconCullParams& Params, int32 NumWorkers, FMapIconCullResult& OutResult);
+
+	// Spreads the candidates over the task graph, keeping enough icons per worker to be worth the scheduling
+	static int32 GetDefaultNumWorkers(const int32 NumCandidates);
+
+	// Fewest icons per worker when choosing the number of workers automatically
+	static const int32 MinIconsPerWorker = 2048;
+
+private:
+	static void CullRange(const FMapIconRenderCache& Cache, const int32* Candidates, const int32 NumCandidates, const FMapIconCullParams& Params, FMapIconCullResult& OutResult);
+
+	TArray<FMapIconCullResult> WorkerResults;
+};
+
+// A map view's culled icons, computed at most once per frame and shared by every renderer that draws the view, such as
+// split-screen minimaps and a fullscreen map following the same view. Owned by the view, see UMapViewComponent::CullIcons().
+// Renderers of different sizes share results culled for the smallest of them, which are a superset of what each would cull,
+// so renderers still do their own exact view test, clipping, placement and hover handling on top.
+struct MINIMAPPLUGIN_API FMapViewIconCulling
+{
+	// Icons from the tracker's spatial grid that overlap the view, expanded by the largest icon radius
+	TArray<int32> Candidates;
+	// Visible is sorted back to front and already excludes icons on other background levels. NeedsBackgroundLevelCheck is empty.
+	FMapIconCullResult Result;
+
+	// What the results were culled for. Tracker is only compared, never dereferenced.
+	const UMapTrackerComponent* Tracker = nullptr;
+	uint32 TrackerIconVersion = 0;
+	uint64 Frame = 0;
+	float DPIScale = 0.0f;
+	float WorldToPixelRatio = 0.0f;
+	bool bValid = false;
+
+	// Largest world to pixel ratio that renderers asked for during RequestFrame and the frame before it
+	uint64 RequestFrame = 0;
+	float MaxRequestedWorldToPixelRatio = 0.0f;
+	float PreviousMaxRequestedWorldToPixelRatio = 0.0f;
+
+	FMapIconCuller Culler;
+	// Second buffer for sorting the visible icons
+	TArray<int32> SortScratch;
+};
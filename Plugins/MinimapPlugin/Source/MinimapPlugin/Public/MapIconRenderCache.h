@@ -0,0 +1,94 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MapEnums.h"
+
+class UMapIconComponent;
+class UTexture2D;
+
+// Bit flags stored per icon in FMapIconRenderCache::Flags
+namespace EMapIconRenderFlags
+{
+	enum Type : uint8
+	{
+		Visible = 1 << 0,
+		Rotates = 1 << 1,
+		Interactable = 1 << 2,
+		ObjectiveArrowEnabled = 1 << 3,
+		ObjectiveArrowRotates = 1 << 4,
+	};
+}
+
+// Packed per-icon render data, owned and maintained by the map tracker. Every array is indexed by the icon's index in
+// UMapTrackerComponent::GetMapIcons(). Icon setters and transform updates write through to this cache, so renderers can
+// cull and sort thousands of icons by walking a few contiguous arrays instead of dereferencing every UMapIconComponent.
+struct MINIMAPPLUGIN_API FMapIconRenderCache
+{
+	// Material slot used by icons without a material
+	static const uint16 NoMaterialSlot = MAX_uint16;
+	// Category bucket of icons that aren't placed in a bucket yet
+	static const uint16 NoCategoryBucket = MAX_uint16;
+	// Draw key of icons that aren't placed in a z layer yet
+	static const uint64 NoDrawKey = MAX_uint64;
+
+	// World XY location
+	TArray<FVector2D> Locations;
+	// World Z location, only needed for multi-level backgrounds
+	TArray<float> Heights;
+	// World yaw
+	TArray<float> Yaws;
+	TArray<float> Sizes;
+	TArray<float> ObjectiveArrowSizes;
+	TArray<float> FogRevealThresholds;
+	TArray<int32> ZOrders;
+	// Back to front draw order. The upper half is the rank of the icon's z-order among all z-orders in use, the lower half
+	// is when the icon entered that z-order, so that icons with the same z-order keep their relative order between frames.
+	TArray<uint64> DrawKeys;
+	TArray<EIconSizeUnit> SizeUnits;
+	TArray<EIconFogInteraction> FogInteractions;
+	TArray<EIconBackgroundInteraction> BackgroundInteractions;
+	// Combination of EMapIconRenderFlags
+	TArray<uint8> Flags;
+	// Index into the tracker's canvas material table, or NoMaterialSlot
+	TArray<uint16> MaterialSlots;
+	TArray<uint16> ObjectiveArrowMaterialSlots;
+	// Index into the tracker's icon category buckets, or NoCategoryBucket
+	TArray<uint16> CategoryBuckets;
+	// Entry in the tracker's icon atlas, or UMapIconAtlas::NoEntry. Only maintained once the atlas is in use.
+	TArray<uint16> AtlasEntries;
+	TArray<uint16> ObjectiveArrowAtlasEntries;
+	TArray<FLinearColor> DrawColors;
+	// Index into the tracker's list of icons with a trail, or INDEX_NONE
+	TArray<int32> TrailSlots;
+	// Textures are kept alive by the icon components themselves
+	TArray<UTexture2D*> Textures;
+	TArray<UTexture2D*> ObjectiveArrowTextures;
+
+	int32 Num() const
+	{
+		return Locations.Num();
+	}
+
+	bool HasFlag(const int32 Index, const uint8 Flag) const
+	{
+		return (Flags[Index] & Flag) != 0;
+	}
+
+	// Appends an entry and returns its index. Its values must be written before use.
+	int32 AddDefaulted();
+	// Removes an entry by moving the last entry into its place
+	void RemoveAtSwap(const int32 Index);
+	void Reserve(const int32 Number);
+	void Empty();
+
+	// Writes an icon's location and yaw
+	void WriteTransform(const int32 Index, const FTransform& Transform);
+	// Writes all of an icon's render properties, except for its transform, material slots, category bucket, atlas entries and draw key
+	void WriteProperties(const int32 Index, const UMapIconComponent* MapIcon);
+
+	// Sorts icon indices back to front on their draw keys. This is a radix sort, so it takes linear time and is stable.
+	// Scratch is used as the second buffer, so that sorting every frame doesn't allocate.
+	void SortByDrawOrder(TArray<int32>& Indices, TArray<int32>& Scratch) const;
+};
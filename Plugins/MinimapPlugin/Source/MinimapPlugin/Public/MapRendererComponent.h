@@ -5,6 +5,8 @@
 #include "Components/ActorComponent.h"
 #include "Types/SlateEnums.h"
 #include "Layout/Margin.h"
+#include "Engine/Canvas.h"
+#include "CanvasItem.h"
 #include "MapEnums.h"
 #include "MapRendererComponent.generated.h"
 
@@ -14,9 +16,125 @@ class UMapIconComponent;
 class UCanvas;
 class UMaterialInterface;
 class UMaterialInstanceDynamic;
+class UTexture;
+class UTextureRenderTarget2D;
+class UFont;
+struct FMapViewIconCulling;
 
 // MapRendererComponent event signatures
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FMapClickedSignature, FVector, WorldLocation, bool, bIsLeftMouseButton);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FMapIconClusterClickedSignature, const TArray<UMapIconComponent*>&, MapIcons, bool, bIsLeftMouseButton);
+
+// An icon quad waiting to be drawn in a batch with other icons that share its material and texture. Only for internal use.
+struct FMapIconBatchItem
+{
+	int32 ZOrder;
+	UMaterialInterface* Material;
+	UTexture* Texture;
+	FCanvasUVTri Triangles[2];
+	// Offset from the icon's position to where it was drawn at the previous draw list refresh
+	FVector2D PreviousPositionDelta;
+};
+
+// Icon layers of a renderer, drawn in this order with the fog in between the first two. Only for internal use.
+namespace EMapIconDrawLayer
+{
+	enum Type : uint8
+	{
+		// Icons with EIconFogInteraction::AlwaysRenderUnderFog
+		UnderFog,
+		// All other icons
+		AboveFog,
+		// Objective arrows of icons outside of the view, on top so that they're never hidden at the map's edge
+		ObjectiveArrows,
+		Num,
+	};
+}
+
+// The draws of one icon layer, built at the renderer's icon refresh rate and drawn every frame. Only for internal use.
+struct FMapIconDrawList
+{
+	// One draw call. Kept between refreshes, so that recording and drawing the layer doesn't allocate once it has grown.
+	struct FDraw
+	{
+		FDraw()
+			: Item(FVector2D::ZeroVector, FVector2D::ZeroVector, FVector2D::ZeroVector, nullptr)
+		{
+		}
+
+		UMaterialInstanceDynamic* MaterialInstance = nullptr;
+		// Index of the draw's first icon in PreviousPositionDeltas. Each icon is two triangles of the item.
+		int32 FirstIcon = 0;
+		FCanvasTriangleItem Item;
+	};
+
+	// Icon count drawn on top of a cluster icon
+	struct FLabel
+	{
+		FVector2D Position;
+		FVector2D PreviousPositionDelta;
+		int32 Count;
+	};
+
+	void Reset()
+	{
+		NumDraws = 0;
+		PreviousPositionDeltas.Reset();
+		Labels.Reset();
+	}
+
+	// Starts a draw without triangles, reusing one from an earlier refresh if there is one
+	FDraw& AddDraw(UMaterialInstanceDynamic* MaterialInstance)
+	{
+		if (NumDraws == Draws.Num())
+			Draws.AddDefaulted();
+		FDraw& Draw = Draws[NumDraws++];
+		Draw.MaterialInstance = MaterialInstance;
+		Draw.FirstIcon = PreviousPositionDeltas.Num();
+		Draw.Item.TriangleList.Reset();
+		return Draw;
+	}
+
+	// The first NumDraws are drawn in order, one draw call each. The others are left over from earlier refreshes.
+	TArray<FDraw> Draws;
+	int32 NumDraws = 0;
+	// Per icon, the offset to where it was drawn at the previous refresh
+	TArray<FVector2D> PreviousPositionDeltas;
+	// Drawn after all draws of the layer
+	TArray<FLabel> Labels;
+};
+
+// Icons of one category that are drawn as a single icon with a count, because they are too close together at the current zoom.
+// Only for internal use.
+struct FMapIconCluster
+{
+	// Average view coordinates of the cluster's icons
+	FVector2D UV;
+	// Render cache index of the icon the cluster is drawn with, which is the top-most of its icons
+	int32 RepresentativeIndex;
+	// Range of the cluster's icons in the renderer's ClusteredIcons, in draw order
+	int32 FirstIcon;
+	int32 NumIcons;
+	float IconScale;
+	// Where the cluster was drawn at the last refresh, for hover and click tests
+	FVector2D ScreenPosition;
+	float ScreenRadius;
+};
+
+// A background quad covering the render region. Also used to detect when the cached static layer is outdated. Only for internal use.
+struct FMapBackgroundDrawItem
+{
+	UMaterialInstanceDynamic* MaterialInstance;
+	UTexture* Texture;
+	FVector2D CornerUVs[4];
+
+	bool operator==(const FMapBackgroundDrawItem& Other) const
+	{
+		return MaterialInstance == Other.MaterialInstance && Texture == Other.Texture
+			&& CornerUVs[0] == Other.CornerUVs[0] && CornerUVs[1] == Other.CornerUVs[1]
+			&& CornerUVs[2] == Other.CornerUVs[2] && CornerUVs[3] == Other.CornerUVs[3];
+	}
+};
 
 // Given a MapViewComponent, renders a map of the area represented by the map view to a HUD Canvas.
 // Add this component to your game's HUD class in case you want to render a map using the Canvas approach.
@@ -38,13 +156,29 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
 	void SetAutoLocateMapView(const EMapViewSearchOption InAutoLocateMapView);
 
-	// Should be called from within your HUD's DrawHUD
+	// Should be called from within your HUD's DrawHUD. If bRenderToTarget is enabled, draws the render target instead of rendering the map again.
 	void DrawToCanvas(UCanvas* Canvas);
 
 	// HUD clicks that are potentially map click events should be passed to this function. Will fire click events on any 
 	// icons being mouse-overed. Otherwise will fire a background click event if the cursor is on the map. 
 	// Returns true if the map consumed the click event.
 	bool HandleClick(const FVector2D& ScreenPosition, const bool bIsLeftClick);
+	// Clicks on a widget or surface showing the render target should be passed to this function, as UV coordinates in the render target.
+	// Fires a background click event if the UV coordinates are on the map. Icon click events need the hover detection that only the HUD
+	// provides, see DrawToCanvas. Returns true if the map consumed the click event.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	bool HandleRenderTargetClick(const FVector2D& UV, const bool bIsLeftMouseButton);
+
+	// Enables or disables rendering the map to a render target, see bRenderToTarget
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void SetRenderToTarget(const bool bNewRenderToTarget);
+	// Returns the render target the map is rendered to if bRenderToTarget is enabled, or null before its first update.
+	// Sample it from widgets and materials to show the map in several places while only rendering it once.
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	UTextureRenderTarget2D* GetRenderTarget() const;
+	// Renders the map to the render target right away, instead of at the next update
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void UpdateRenderTarget();
 
 	// Sets the view component which defines the location, rotation and view distance of the rendered map
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
@@ -84,6 +218,15 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	FLinearColor GetBackgroundFillColor() const;
 
+	// Forces the cached static layer to be redrawn next frame. Call this after changing the contents of a background texture,
+	// render target or material parameter while bCacheStaticLayer is enabled, since those changes aren't detected.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void InvalidateStaticLayer();
+
+	// Returns how many icons in view were left out at the last icon refresh to stay within the icon budget
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	int32 GetNumDroppedIcons() const;
+
 	// Set how the map should align horizontally in the viewport
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
 	void SetHorizontalAlignment(EHorizontalAlignment InHorizontalAlignment);
@@ -97,8 +240,17 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
 	void SetSize(const int32 Width, const int32 Height);
 
+	// Starts rendering what the tracker tracks once the tracker exists. Only for internal use.
+	void RegisterWithMapTracker(UMapTrackerComponent* Tracker);
+
 private:
+	// Searches for a map view, or waits for one to register if none is found
 	void AutoRelocateMapView();
+	UFUNCTION()
+	void OnMapViewRegistered(UMapViewComponent* RegisteredMapView);
+
+	// Ticks late in the frame only while rendering to the render target
+	void UpdateTickGroup();
 
 	// Fires any buffered hover events that were detected in the rendering thread, exploiting essential rendering computations
 	void TickHoverEvents();
@@ -116,9 +268,40 @@ private:
 	// Draws the map to the canvas
 	void RenderToCanvas(UCanvas* Canvas, const FVector2D& MapTopLeft, const FVector2D& MapSize);
 	
+	// Marks icons that are no longer among the view's icon candidates as out of view, and ends their hover
+	void UpdatePreviousIconCandidates(const TArray<int32>& IconCandidates);
+
+	// Draws the fill color and backgrounds, from the cached static layer if possible
 	void DrawBackground(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize);
+	// Collects the shown backgrounds back to front, along with the part of each background that the map view covers
+	void GatherBackgroundDrawItems(TArray<FMapBackgroundDrawItem>& OutItems);
+	void DrawBackgroundItems(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize, const TArray<FMapBackgroundDrawItem>& Items);
+	// Whether the fill color and backgrounds can currently be drawn from the static layer
+	bool CanCacheStaticLayer() const;
+	// Redraws the static layer render target if the last draw found it outdated. Called from tick, outside of any canvas.
+	void UpdateStaticLayer();
+	// Draws the render target to the HUD in place of the map
+	void DrawRenderTargetToCanvas(UCanvas* Canvas, const FVector2D& MapTopLeft, const FVector2D& MapSize);
+	// Scale applied to screen space icon sizes. Icons in the render target are sized in its pixels instead of the viewport's.
+	float GetIconDPIScale() const;
 	void DrawFog(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize);
-	void DrawIcons(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize, const bool bAboveFog);
+	// Draws the trails of all icons with bTrailEnabled that are in view, in a single draw
+	void DrawIconTrails(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize);
+	// Ranks the icons in view and marks those that don't fit in the icon budget as dropped
+	void ApplyIconBudget(const TArray<int32>& VisibleIcons);
+	// Merges icons in view that are close together on the map into clusters, for categories that cluster at the current zoom
+	void ClusterIcons(const TArray<int32>& VisibleIcons, const float DPIScale, const float WorldToPixelRatio);
+	// Positions the icons the view culled once, and records their draws in the draw list of their layer
+	void BuildIconDrawLists(const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize, const FMapViewIconCulling& IconCulling);
+	// Records the icons queued by BuildIconDrawLists when batching, one triangle list per material and texture within each z-order
+	// FirstBatchMaterialInstance is where the batches' material instances start in IconDrawListMaterialInstances.
+	void AddIconBatchesToDrawList(const FLinearColor& ClipInfo, TArray<FMapIconBatchItem>& BatchItems, const int32 FirstBatchMaterialInstance, FMapIconDrawList& OutDrawList);
+	// Rebuilds the icon draw lists if the refresh interval passed or the map moved since they were built
+	void RefreshIconDrawLists(const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize);
+	// Draws a recorded icon layer, moving icons between their previous and current refresh positions if interpolating
+	void DrawIconDrawList(UCanvas* Canvas, FMapIconDrawList& DrawList, const float InterpolationAlpha);
+	// Returns this renderer's shared material instance for a material and texture, creating it if needed
+	UMaterialInstanceDynamic* GetIconBatchMaterialInstance(UMaterialInterface* Material, UTexture* Texture);
 	void DrawBoundary(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize);
 	void DrawFrustum(UCanvas* Canvas, const FVector2D& RenderRegionTopLeft, const FVector2D& RenderRegionSize);
 
@@ -126,6 +309,10 @@ public:
 	// Event that fires when the background is clicked. When an icon is clicked, this event is not fired.
 	UPROPERTY(BlueprintAssignable, Category = "Minimap")
 	FMapClickedSignature OnMapClicked;
+	// Event that fires when a cluster icon is clicked, with all icons in the cluster. The icons' own click events don't fire.
+	// See FMapIconCategorySettings::ClusterRadius.
+	UPROPERTY(BlueprintAssignable, Category = "Minimap")
+	FMapIconClusterClickedSignature OnIconClusterClicked;
 
 protected:
 	// Whether a MapViewComponent should be found automatically in the world at game start. If disabled, call SetMapView() manually with a valid MapView.
@@ -137,9 +324,68 @@ protected:
 	// Whether the map is currently being rendered
 	UPROPERTY(EditAnywhere, Category = "Minimap")
 	bool bIsRendered = true;
+	// Whether the trails of icons with bTrailEnabled are drawn. Trails are drawn above the fog and below the icons, and only for icons
+	// that are shown in this renderer's view, so that fog and hidden categories also hide where an icon has been.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	bool bDrawIconTrails = true;
 	// Whether the player's frustum is visualized as a trapezoid. This is done by intersecting 
 	UPROPERTY(EditAnywhere, Category = "Minimap")
 	bool bDrawFrustum = false;
+	// If enabled, icons sharing a canvas material and texture are drawn as one triangle list with one material instance owned by
+	// this renderer, instead of one draw and one material instance per icon. Icon colors are passed as vertex colors, so the icon
+	// materials must multiply by VertexColor instead of using the Color parameter. Animated materials run on the world clock,
+	// since the time since an icon's material was set can't be passed per icon.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	bool bBatchIconDraws = false;
+	// If enabled along with bBatchIconDraws, icon textures are drawn from the tracker's icon atlas, so that icons with different
+	// textures but the same material are drawn in a single batch. Icon materials must not rely on their UVs spanning 0 to 1.
+	UPROPERTY(EditAnywhere, Category = "Minimap", meta = (EditCondition = "bBatchIconDraws"))
+	bool bUseIconAtlas = false;
+	// If enabled, icon culling is spread over task graph workers when there are enough icon candidates to be worth it.
+	// Renderers of the same view share their culling, so the first renderer to draw the view in a frame decides.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	bool bParallelIconCulling = true;
+	// How many times per second icons are culled, sorted and positioned. In between, the icons recorded at the last refresh are
+	// drawn again, which is much cheaper on high refresh rate displays. Hover and in-view events also update at this rate.
+	// Icons are refreshed right away whenever the map view moves, rotates or zooms, since backgrounds are always drawn live.
+	// Set to 0 to refresh every frame.
+	UPROPERTY(EditAnywhere, Category = "Minimap", meta = (ClampMin = "0"))
+	float IconRefreshRate = 0.0f;
+	// If enabled along with an icon refresh rate, moving icons glide from their previous to their latest refreshed position
+	// instead of jumping at each refresh. This shows icons one refresh interval late.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	bool bInterpolateIconPositions = false;
+	// Most icons drawn per icon refresh. When more icons are in view, the lowest ranked ones are left out until the next refresh. Icons with
+	// an objective arrow rank first, then icons of categories with a higher DrawPriority, then higher z-orders, then icons closer to the
+	// view's center. Clusters are always drawn and count as one icon each. Zero means no limit.
+	UPROPERTY(EditAnywhere, Category = "Minimap", meta = (ClampMin = "0"))
+	int32 MaxIconsPerRefresh = 0;
+	// Time budget for positioning and recording icons per icon refresh, in milliseconds. Converted into an icon limit using the average
+	// cost per icon measured at earlier refreshes, and combined with MaxIconsPerRefresh. Zero means no limit.
+	UPROPERTY(EditAnywhere, Category = "Minimap", meta = (ClampMin = "0"))
+	float IconRefreshBudgetMs = 0.0f;
+	// If enabled, the fill color and backgrounds are drawn into a render target owned by this renderer, which is only redrawn when
+	// the view moves or zooms, the render region is resized or the shown backgrounds change. Each frame then draws that render
+	// target as a single quad underneath the icons and fog. It is redrawn at the tick after the view comes to rest, and until then
+	// the backgrounds are drawn directly. Only used for rectangular maps with an opaque fill color, since the
+	// render target has no usable alpha to cut out a circle or show what's behind the map. Animated background materials freeze.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	bool bCacheStaticLayer = false;
+	// If enabled, the map is rendered to a render target owned by this renderer, which widgets, materials and in-world displays can all
+	// sample, so that one render feeds every display. DrawToCanvas then only draws the render target to the HUD. Icon sizes are in render
+	// target pixels. Canvas materials don't write usable alpha to render targets, so the render target is opaque: parts of the render
+	// target outside a circular map or outside the view's aspect ratio show RenderTargetClearColor.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	bool bRenderToTarget = false;
+	// Size of the render target in pixels
+	UPROPERTY(EditAnywhere, Category = "Minimap", meta = (EditCondition = "bRenderToTarget", ClampMin = "1"))
+	FIntPoint RenderTargetResolution = FIntPoint(512, 512);
+	// How many times per second the render target is updated. Set to 0 to update it every frame.
+	UPROPERTY(EditAnywhere, Category = "Minimap", meta = (EditCondition = "bRenderToTarget", ClampMin = "0"))
+	float RenderTargetUpdateRate = 0.0f;
+	// Color the render target is cleared to before each update
+	UPROPERTY(EditAnywhere, Category = "Minimap", meta = (EditCondition = "bRenderToTarget"))
+	FLinearColor RenderTargetClearColor = FLinearColor::Black;
 	// Affects the drawn frustum's size when bDrawFrustum is true. Distance between player camera and the floor.
 	UPROPERTY(EditAnywhere, Category = "Minimap")
 	float FrustumFloorDistance = 300.0f;
@@ -161,17 +407,25 @@ protected:
 	// The material used to fill the background of the material for regions where no background texture is rendered
 	UPROPERTY(EditAnywhere, Category = "Minimap")
 	UMaterialInterface* FillMaterial;
+	// Font of the icon count drawn on cluster icons. Uses the engine's small font if not set.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	UFont* ClusterCountFont = nullptr;
+	// Color of the icon count drawn on cluster icons
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	FLinearColor ClusterCountColor = FLinearColor::White;
 	
 private:
 	// Material instance of the background fill material
 	UPROPERTY(Transient)
 	UMaterialInstanceDynamic* FillMaterialInstance;
-	// Map tracker which will be found in the world at begin play
+	// Map tracker of the world, set once it exists
 	UPROPERTY(Transient)
 	UMapTrackerComponent* MapTracker;
 	// Map view which defines what part of the world is rendered
 	UPROPERTY(Transient)
 	UMapViewComponent* MapView;
+	// Whether a map view search is scheduled for the next tick
+	bool bMapViewSearchPending = false;
 
 	// Icons that are currently being hovered
 	UPROPERTY(Transient)
@@ -182,6 +436,72 @@ private:
 	// Icons that will fire their hover start end during the next tick. Detected during rendering pass to leverage computations.
 	UPROPERTY(Transient)
 	TArray<UMapIconComponent*> BufferedHoverEndEvents;
+	// Icons that were candidates during the previous refresh. Used to detect icons that left the view.
+	UPROPERTY(Transient)
+	TSet<UMapIconComponent*> PreviousIconCandidates;
+	// Clusters formed at the last refresh, and their icons. Objects are kept in a property, so that destroyed icons become null.
+	TArray<FMapIconCluster> IconClusters;
+	UPROPERTY(Transient)
+	TArray<UMapIconComponent*> ClusteredIcons;
+	// Per icon in view at the last refresh, the index of the cluster it is drawn in, or INDEX_NONE. Empty if nothing clustered.
+	TArray<int32> VisibleIconClusters;
+	// Cluster under the mouse at the last refresh, or INDEX_NONE
+	int32 HoveringCluster = INDEX_NONE;
+	// Per icon in view at the last refresh, whether it was left out to stay within the icon budget. Empty if nothing was dropped.
+	TBitArray<> DroppedVisibleIcons;
+	int32 NumDroppedIcons = 0;
+	// Measured cost of positioning and recording one icon, averaged over refreshes. Zero until measured.
+	float AverageIconBuildMicroseconds = 0.0f;
+	// Icons queued for batched drawing during the current BuildIconDrawLists pass, per layer
+	TArray<FMapIconBatchItem> IconBatchItems[EMapIconDrawLayer::Num];
+	// Draws per icon layer, recorded at the last refresh
+	FMapIconDrawList IconDrawLists[EMapIconDrawLayer::Num];
+	// Keeps the material instances used by the icon draw lists alive until the next refresh, even if their icons are destroyed
+	UPROPERTY(Transient)
+	TArray<UMaterialInstanceDynamic*> IconDrawListMaterialInstances;
+	// Per material instance above, added to the world time to get its Time parameter, so that animations keep running between refreshes
+	TArray<float> IconDrawListTimeOffsets;
+	// Icon triangles moved to their interpolated positions, reused between draws
+	TArray<FCanvasUVTri> IconTriangleScratch;
+	// Whether the icon draw lists can be drawn, and if so when and for what view and render region they were recorded
+	bool bIconDrawListsValid = false;
+	float LastIconRefreshTime = 0.0f;
+	FTransform LastIconRefreshViewTransform;
+	FVector2D LastIconRefreshViewExtent;
+	FVector2D LastIconRefreshRegionTopLeft;
+	FVector2D LastIconRefreshRegionSize;
+	// Whether the icons' previous positions are known for the recorded draw lists, which isn't the case if the view moved
+	bool bInterpolatingIconDrawLists = false;
+	// Screen position of each icon at the last refresh, to interpolate from at the next
+	TMap<UMapIconComponent*, FVector2D> IconScreenPositions;
+	TMap<UMapIconComponent*, FVector2D> NewIconScreenPositions;
+	// Triangles of all icon trails, kept between frames so that building and drawing them doesn't allocate. Set on first use.
+	TOptional<FCanvasTriangleItem> TrailTriangleItem;
+	// Material instances used for batched icon drawing, per canvas material and texture
+	TMap<TPair<UMaterialInterface*, UTexture*>, UMaterialInstanceDynamic*> IconBatchMaterialInstances;
+	// Keeps the batched icon material instances alive
+	UPROPERTY(Transient)
+	TArray<UMaterialInstanceDynamic*> IconBatchMaterialInstancePool;
+	// Fill color and backgrounds drawn at the render region's size, if bCacheStaticLayer is used
+	UPROPERTY(Transient)
+	UTextureRenderTarget2D* StaticLayerRenderTarget;
+	// What the static layer was last drawn with, to detect when it needs to be redrawn
+	TArray<FMapBackgroundDrawItem> StaticLayerItems;
+	FLinearColor StaticLayerFillColor;
+	bool bStaticLayerValid = false;
+	// What the last draw needed the static layer to show, if it was outdated
+	FIntPoint StaticLayerRequestedSize = FIntPoint::ZeroValue;
+	TArray<FMapBackgroundDrawItem> StaticLayerRequestedItems;
+	// The map is rendered to this if bRenderToTarget is used
+	UPROPERTY(Transient)
+	UTextureRenderTarget2D* RenderTarget = nullptr;
+	float LastRenderTargetUpdateTime = 0.0f;
+	// Whether the map is being rendered to the render target right now, as opposed to the HUD
+	bool bRenderingToTarget = false;
+	// Where DrawToCanvas last showed the render target, so that the cursor can be mapped into the render target for hover events
+	bool bRenderTargetOnCanvas = false;
+	FVector2D RenderTargetCanvasTopLeft;
+	FVector2D RenderTargetCanvasSize;
 	// The most recent canvas that was rendered to. Used to transform screen space mouse events to world space.
 	UPROPERTY(Transient)
 	UCanvas* LastCanvas;
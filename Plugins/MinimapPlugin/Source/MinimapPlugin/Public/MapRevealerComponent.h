@@ -4,10 +4,13 @@
 
 #include "Components/BoxComponent.h"
 #include "MapEnums.h"
+#include "MapSlotMap.h"
 #include "MapRevealerComponent.generated.h"
 
 class AMapFog;
+class UMapTrackerComponent;
 class UCanvas;
+struct FMapFogRevealStamp;
 
 // Minimaps can be covered in fog by adding MapFog actors. When using this feature, add MapRevealComponents 
 // to actors that can temporarily or permanently reveal areas.
@@ -47,11 +50,25 @@ public:
 
 	// Clears fog by updating a MapFog's render target
 	virtual void UpdateMapFog(AMapFog* MapFog, UCanvas* Canvas);
+	// Describes the area this revealer reveals in a MapFog's grid, for fog that uses the CPU backend. Returns false if it reveals nothing.
+	virtual bool GetFogRevealStamp(AMapFog* MapFog, FMapFogRevealStamp& OutStamp);
+
+	// Registers the revealer with the tracker once it exists, unless it already is or has ended play. Only for internal use.
+	void RegisterWithMapTracker(UMapTrackerComponent* Tracker);
 
 public:
 	// Defines the shape of the revealed area, by rendering that shape to every MapFog's fog render target.
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Minimap")
 	UMaterialInterface* RevealMaterial;
+	// Shape of the revealed area in fog that uses the CPU backend, which can't evaluate RevealMaterial
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Minimap")
+	EMapRevealShape RevealShape = EMapRevealShape::Circle;
+	// If true, terrain and geometry higher than EyeHeight hide what's behind them, in fog that uses the CPU backend with bLineOfSight
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Minimap")
+	bool bUseLineOfSight = true;
+	// Height above this component from which the revealer looks out when using line of sight
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Minimap", meta = (EditCondition = "bUseLineOfSight"))
+	float EyeHeight = 150.0f;
 	// Whether this revealer reveals temporarily, permanently or is disabled at the moment
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Minimap")
 	EMapFogRevealMode RevealMode = EMapFogRevealMode::Temporary;
@@ -66,5 +83,10 @@ public:
 private:
 	UPROPERTY(Transient)
 	UMaterialInstanceDynamic* RevealMaterialInstance;
+	// The tracker this revealer registered itself to
+	UPROPERTY(Transient)
+	UMapTrackerComponent* MapTracker = nullptr;
+	// Handle in the tracker's revealer registry, used to unregister
+	FMapRegistryHandle TrackerHandle;
 	
 };
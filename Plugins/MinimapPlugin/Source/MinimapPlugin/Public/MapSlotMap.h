@@ -0,0 +1,136 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MapSlotMap.generated.h"
+
+// Lightweight reference to an icon registered with the map tracker. Unlike an icon pointer it doesn't keep the icon
+// alive, and once the icon unregisters the handle never resolves again, not even to an icon that reuses its slot.
+// Resolve it with UMapTrackerComponent::ResolveMapIconHandle.
+USTRUCT(BlueprintType)
+struct MINIMAPPLUGIN_API FMapIconHandle
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Slot in the tracker's icon registry, or INDEX_NONE if never assigned
+	UPROPERTY(Transient)
+	int32 Index = INDEX_NONE;
+	// Incremented every time the slot is freed, so handles to a previous occupant are rejected
+	UPROPERTY(Transient)
+	int32 Generation = 0;
+
+	bool IsSet() const
+	{
+		return Index != INDEX_NONE;
+	}
+
+	bool operator==(const FMapIconHandle& Other) const
+	{
+		return Index == Other.Index && Generation == Other.Generation;
+	}
+
+	bool operator!=(const FMapIconHandle& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	friend uint32 GetTypeHash(const FMapIconHandle& Handle)
+	{
+		return HashCombine(GetTypeHash(Handle.Index), GetTypeHash(Handle.Generation));
+	}
+};
+
+// Same as FMapIconHandle, for the tracker's background, fog and revealer registries. These are only held by the
+// registered objects themselves, so they aren't exposed to blueprints.
+struct FMapRegistryHandle
+{
+	int32 Index = INDEX_NONE;
+	int32 Generation = 0;
+
+	bool IsSet() const
+	{
+		return Index != INDEX_NONE;
+	}
+};
+
+// Maps stable handles to indices in densely packed arrays that are owned by the caller. Elements are removed by
+// moving the last element into the freed index, so registering and unregistering are O(1) and the dense arrays
+// stay contiguous for iteration. Slots are recycled with an incremented generation, so stale handles fail to resolve.
+//
+// Usage: call Add() and append the element to the dense arrays. To remove, call Remove() and then RemoveAtSwap()
+// the returned index on every dense array.
+template<typename HandleType>
+class TMapSlotMap
+{
+public:
+	// Allocates a handle for an element that will be appended at dense index Num() - 1
+	HandleType Add()
+	{
+		const int32 SlotIndex = FreeSlots.Num() > 0 ? FreeSlots.Pop(false) : Slots.AddDefaulted();
+		FSlot& Slot = Slots[SlotIndex];
+		Slot.DenseIndex = DenseToSlot.Add(SlotIndex);
+
+		HandleType Handle;
+		Handle.Index = SlotIndex;
+		Handle.Generation = Slot.Generation;
+		return Handle;
+	}
+
+	// Frees a handle and returns the dense index that the caller must RemoveAtSwap, or INDEX_NONE if the handle is stale
+	int32 Remove(const HandleType& Handle)
+	{
+		const int32 DenseIndex = Find(Handle);
+		if (DenseIndex == INDEX_NONE)
+			return INDEX_NONE;
+
+		// The last element moves into the freed dense index
+		Slots[DenseToSlot.Last()].DenseIndex = DenseIndex;
+		DenseToSlot.RemoveAtSwap(DenseIndex, 1, false);
+
+		// Invalidate all outstanding handles to this slot before recycling it
+		FSlot& Slot = Slots[Handle.Index];
+		Slot.DenseIndex = INDEX_NONE;
+		Slot.Generation = (Slot.Generation + 1) & MAX_int32;
+		FreeSlots.Add(Handle.Index);
+		return DenseIndex;
+	}
+
+	// Returns the dense index a handle refers to, or INDEX_NONE if the handle is stale
+	int32 Find(const HandleType& Handle) const
+	{
+		if (!Slots.IsValidIndex(Handle.Index))
+			return INDEX_NONE;
+		const FSlot& Slot = Slots[Handle.Index];
+		return Slot.Generation == Handle.Generation ? Slot.DenseIndex : INDEX_NONE;
+	}
+
+	// Returns the handle of the element at a dense index
+	HandleType GetHandle(const int32 DenseIndex) const
+	{
+		HandleType Handle;
+		Handle.Index = DenseToSlot[DenseIndex];
+		Handle.Generation = Slots[Handle.Index].Generation;
+		return Handle;
+	}
+
+	int32 Num() const
+	{
+		return DenseToSlot.Num();
+	}
+
+private:
+	struct FSlot
+	{
+		int32 DenseIndex = INDEX_NONE;
+		int32 Generation = 0;
+	};
+
+	// Indexed by handle index
+	TArray<FSlot> Slots;
+	// Indexed by dense index
+	TArray<int32> DenseToSlot;
+	// Slots available for reuse
+	TArray<int32> FreeSlots;
+
+};
@@ -0,0 +1,204 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// A uniform 2D grid that buckets elements by their XY position. Elements are only moved between buckets when they
+// cross a cell boundary, so keeping the grid up to date is cheap for elements that move a little every frame.
+// Queries visit only the cells that overlap the queried area, so their cost scales with what is in the area rather
+// than with the total number of elements.
+template<typename ElementType>
+class TMapSpatialHash
+{
+public:
+	TMapSpatialHash(const float InCellSize = 2048.0f)
+	{
+		SetCellSize(InCellSize);
+	}
+
+	// Changes the world size of a cell. Existing elements are removed, since they would be bucketed incorrectly.
+	void SetCellSize(const float NewCellSize)
+	{
+		CellSize = FMath::Max(1.0f, NewCellSize);
+		InverseCellSize = 1.0f / CellSize;
+		Empty();
+	}
+
+	float GetCellSize() const
+	{
+		return CellSize;
+	}
+
+	// Returns the cell that contains a world position
+	FIntPoint GetCell(const FVector2D& Position) const
+	{
+		return FIntPoint(FMath::FloorToInt(Position.X * InverseCellSize), FMath::FloorToInt(Position.Y * InverseCellSize));
+	}
+
+	// Adds an element at a position. The element must not already be in the grid.
+	void Add(const ElementType& Element, const FVector2D& Position)
+	{
+		ElementCells.Add(Element, AddToCell(Element, GetCell(Position)));
+	}
+
+	// Removes an element from the grid. Returns false if the element wasn't in the grid.
+	bool Remove(const ElementType& Element)
+	{
+		FElementSlot Slot;
+		if (!ElementCells.RemoveAndCopyValue(Element, Slot))
+			return false;
+		RemoveFromCell(Slot);
+		return true;
+	}
+
+	// Replaces an element with another in the same place, for example when the index it stands for changes.
+	// NewElement must not already be in the grid. Returns false if the element wasn't in the grid.
+	bool Rename(const ElementType& Element, const ElementType& NewElement)
+	{
+		FElementSlot Slot;
+		if (!ElementCells.RemoveAndCopyValue(Element, Slot))
+			return false;
+		Cells.FindChecked(Slot.Cell)[Slot.Index] = NewElement;
+		ElementCells.Add(NewElement, Slot);
+		return true;
+	}
+
+	// Updates an element's position. Only touches the buckets when the element crossed into another cell. Returns true if the element was re-bucketed.
+	bool Move(const ElementType& Element, const FVector2D& NewPosition)
+	{
+		FElementSlot* Slot = ElementCells.Find(Element);
+		if (!Slot)
+			return false;
+
+		const FIntPoint NewCell = GetCell(NewPosition);
+		if (NewCell == Slot->Cell)
+			return false;
+
+		const FElementSlot OldSlot = *Slot;
+		*Slot = AddToCell(Element, NewCell);
+		RemoveFromCell(OldSlot);
+		return true;
+	}
+
+	bool Contains(const ElementType& Element) const
+	{
+		return ElementCells.Contains(Element);
+	}
+
+	int32 Num() const
+	{
+		return ElementCells.Num();
+	}
+
+	void Empty()
+	{
+		Cells.Empty();
+		ElementCells.Empty();
+	}
+
+	// Gathers all elements in cells that overlap an oriented box. Axes must be normalized and perpendicular.
+	// Results are candidates: elements in touched cells may themselves lie outside the box.
+	void QueryBox(const FVector2D& Center, const FVector2D& AxisX, const FVector2D& AxisY, const FVector2D& Extent, TArray<ElementType>& OutElements) const
+	{
+		// Compute the axis aligned bounds of the box to limit which cells are considered
+		const FVector2D HalfSize(FMath::Abs(AxisX.X) * Extent.X + FMath::Abs(AxisY.X) * Extent.Y, FMath::Abs(AxisX.Y) * Extent.X + FMath::Abs(AxisY.Y) * Extent.Y);
+		const FIntPoint MinCell = GetCell(Center - HalfSize);
+		const FIntPoint MaxCell = GetCell(Center + HalfSize);
+
+		// Project a cell's half size onto the box axes once, used in the separating axis test below
+		const float HalfCell = 0.5f * CellSize;
+		const float CellRadiusOnX = HalfCell * (FMath::Abs(AxisX.X) + FMath::Abs(AxisX.Y));
+		const float CellRadiusOnY = HalfCell * (FMath::Abs(AxisY.X) + FMath::Abs(AxisY.Y));
+
+		ForEachOccupiedCell(MinCell, MaxCell, [&](const FIntPoint& Cell, const TArray<ElementType>& Elements)
+		{
+			// Skip cells within the bounds that don't overlap the rotated box. The world axes
+			// are already separated by the cell range, so only the box axes need testing.
+			const FVector2D Delta = FVector2D((Cell.X + 0.5f) * CellSize, (Cell.Y + 0.5f) * CellSize) - Center;
+			if (FMath::Abs(Delta | AxisX) > Extent.X + CellRadiusOnX || FMath::Abs(Delta | AxisY) > Extent.Y + CellRadiusOnY)
+				return;
+			OutElements.Append(Elements);
+		});
+	}
+
+	// Gathers all elements in cells that overlap a circle. Results are candidates, like with QueryBox.
+	void QueryCircle(const FVector2D& Center, const float Radius, TArray<ElementType>& OutElements) const
+	{
+		const FIntPoint MinCell = GetCell(Center - FVector2D(Radius, Radius));
+		const FIntPoint MaxCell = GetCell(Center + FVector2D(Radius, Radius));
+		const float RadiusSquared = FMath::Square(Radius);
+
+		ForEachOccupiedCell(MinCell, MaxCell, [&](const FIntPoint& Cell, const TArray<ElementType>& Elements)
+		{
+			// Skip cells near the corners of the range that the circle doesn't reach
+			const FVector2D CellMin(Cell.X * CellSize, Cell.Y * CellSize);
+			const FVector2D Closest(FMath::Clamp(Center.X, CellMin.X, CellMin.X + CellSize), FMath::Clamp(Center.Y, CellMin.Y, CellMin.Y + CellSize));
+			if (FVector2D::DistSquared(Closest, Center) > RadiusSquared)
+				return;
+			OutElements.Append(Elements);
+		});
+	}
+
+private:
+	// Calls Visitor for every non-empty cell within an inclusive cell range. Iterates the range or the
+	// occupied cells, whichever is smaller, so that huge query areas on sparse grids stay cheap.
+	template<typename VisitorType>
+	void ForEachOccupiedCell(const FIntPoint& MinCell, const FIntPoint& MaxCell, VisitorType Visitor) const
+	{
+		const int64 NumCellsInRange = int64(MaxCell.X - MinCell.X + 1) * int64(MaxCell.Y - MinCell.Y + 1);
+		if (NumCellsInRange > Cells.Num())
+		{
+			for (const TPair<FIntPoint, TArray<ElementType>>& KVP : Cells)
+				if (KVP.Key.X >= MinCell.X && KVP.Key.X <= MaxCell.X && KVP.Key.Y >= MinCell.Y && KVP.Key.Y <= MaxCell.Y)
+					Visitor(KVP.Key, KVP.Value);
+		}
+		else
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+				{
+					const FIntPoint Cell(X, Y);
+					if (const TArray<ElementType>* Elements = Cells.Find(Cell))
+						Visitor(Cell, *Elements);
+				}
+			}
+		}
+	}
+
+	// Where an element is kept: its cell, and its index in that cell's elements
+	struct FElementSlot
+	{
+		FIntPoint Cell;
+		int32 Index;
+	};
+
+	FElementSlot AddToCell(const ElementType& Element, const FIntPoint& Cell)
+	{
+		FElementSlot Slot;
+		Slot.Cell = Cell;
+		Slot.Index = Cells.FindOrAdd(Cell).Add(Element);
+		return Slot;
+	}
+
+	// Removes the element at a slot without searching the cell, by moving the cell's last element into the slot
+	void RemoveFromCell(const FElementSlot& Slot)
+	{
+		TArray<ElementType>& Elements = Cells.FindChecked(Slot.Cell);
+		Elements.RemoveAtSwap(Slot.Index, 1, false);
+		if (Slot.Index < Elements.Num())
+			ElementCells.FindChecked(Elements[Slot.Index]).Index = Slot.Index;
+		else if (Elements.Num() == 0)
+			Cells.Remove(Slot.Cell);
+	}
+
+	float CellSize;
+	float InverseCellSize;
+
+	// Elements per occupied cell. Empty cells are removed.
+	TMap<FIntPoint, TArray<ElementType>> Cells;
+	// Where each element is currently bucketed
+	TMap<ElementType, FElementSlot> ElementCells;
+
+};
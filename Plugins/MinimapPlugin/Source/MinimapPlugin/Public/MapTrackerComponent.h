@@ -3,22 +3,98 @@
 #pragma once
 
 #include "Components/ActorComponent.h"
+#include "MapEnums.h"
+#include "MapSpatialHash.h"
+#include "MapIconRenderCache.h"
+#include "MapSlotMap.h"
 #include "MapTrackerComponent.generated.h"
 
 class UMapIconComponent;
 class UMapRevealerComponent;
+class UMapViewComponent;
 class AMapBackground;
 class AMapFog;
+class UMaterialInterface;
+class UMapIconAtlas;
 
 // MapTrackerComponent event signatures
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapIconRegisteredSignature, UMapIconComponent*, MapIcon);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapIconUnregisteredSignature, UMapIconComponent*, MapIcon);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FMapIconsChangedSignature, const TArray<UMapIconComponent*>&, AddedMapIcons, const TArray<UMapIconComponent*>&, RemovedMapIcons);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapBackgroundRegisteredSignature, AMapBackground*, MapBackground);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapBackgroundUnregisteredSignature, AMapBackground*, MapBackground);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapFogRegisteredSignature, AMapFog*, MapFog);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapFogUnregisteredSignature, AMapFog*, MapFog);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapRevealerRegisteredSignature, UMapRevealerComponent*, MapRevealer);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapRevealerUnregisteredSignature, UMapRevealerComponent*, MapRevealer);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapViewRegisteredSignature, UMapViewComponent*, MapView);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapViewUnregisteredSignature, UMapViewComponent*, MapView);
+
+// Culling and clustering settings for the icons of one category. See UMapTrackerComponent::SetIconCategorySettings().
+USTRUCT(BlueprintType)
+struct FMapIconCategorySettings
+{
+	GENERATED_USTRUCT_BODY()
+
+	// World size of the spatial grid cells that this category's icons are bucketed in. Sparse categories benefit from larger cells.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap")
+	float GridCellSize = 4096.0f;
+	// This category's icons are skipped entirely by views that are zoomed out further than this view extent, in world units. Zero means no limit.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap")
+	float MaxViewExtent = 0.0f;
+	// Icons of this category that are roughly this many pixels apart or closer on the map are drawn as a single cluster icon with a count.
+	// Renderers report clicks on a cluster with all of its icons. Zero disables clustering.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap", meta = (ClampMin = "0"))
+	float ClusterRadius = 0.0f;
+	// Icons are only clustered by views that are zoomed out further than this view extent, in world units
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap", meta = (ClampMin = "0"))
+	float MinClusterViewExtent = 0.0f;
+	// Fewest icons that form a cluster. Fewer icons close together are drawn as usual.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap", meta = (ClampMin = "2"))
+	int32 MinClusterSize = 3;
+	// Size of a cluster icon relative to the icon it's drawn with, which is the top-most of its icons
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap", meta = (ClampMin = "0"))
+	float ClusterIconScale = 1.5f;
+	// When a renderer has more icons in view than its icon budget allows, icons of categories with a higher draw priority are kept first.
+	// See UMapRendererComponent::MaxIconsPerRefresh.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap")
+	float DrawPriority = 0.0f;
+
+};
+
+// Restricts which icons the tracker's spatial queries return
+USTRUCT(BlueprintType)
+struct FMapIconQueryFilter
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Only icons of these categories are returned. Leave empty to include all categories.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap")
+	TArray<FName> IconCategories;
+	// Whether hidden icons are left out
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap")
+	bool bOnlyVisibleIcons = false;
+	// If set, only icons that are currently rendered in this view are returned
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Minimap")
+	UMapViewComponent* RenderedInView = nullptr;
+
+	// Optional custom test from C++. Only called for icons that pass all other tests.
+	TFunction<bool(const UMapIconComponent*)> Predicate;
+
+};
+
+// Registered icons of one category. Only for internal use.
+struct FMapIconCategoryBucket
+{
+	FName IconCategory;
+	FMapIconCategorySettings Settings;
+	// Indices of the category's icons bucketed by XY location
+	TMapSpatialHash<int32> Grid;
+	// Indices of the category's icons that have their objective arrow enabled. These are rendered even when far outside a view.
+	TArray<int32> ObjectiveArrowIconIndices;
+	// Where each of those icons is in ObjectiveArrowIconIndices, so that it can be removed or renumbered without searching
+	TMap<int32, int32> ObjectiveArrowIconSlots;
+};
 
 // This component keeps track of all objects that can appear on a map. This component is automatically 
 // created on demand, so you should not create it. If you want to access all tracked objects, get a 
@@ -30,27 +106,102 @@ class MINIMAPPLUGIN_API UMapTrackerComponent : public UActorComponent
 
 public:	
 	UMapTrackerComponent();
+
+	// Begin UActorComponent interface
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// End UActorComponent interface
 	
-	// Registers an icon. Only for internal use.
+	// Registers an icon and assigns it a handle. Only for internal use.
 	void RegisterMapIcon(UMapIconComponent* MapIcon);
-	// Unregisters an icon. Only for internal use.
+	// Unregisters an icon and invalidates its handle. Only for internal use.
 	void UnregisterMapIcon(UMapIconComponent* MapIcon);
+	// Registers many icons at once, for example right after spawning an army. Icons that are already registered are skipped,
+	// so the icons registering themselves on BeginPlay afterwards is harmless.
+	void RegisterMapIcons(const TArray<UMapIconComponent*>& NewMapIcons);
+	// Unregisters many icons at once. Icons that aren't registered are skipped.
+	void UnregisterMapIcons(const TArray<UMapIconComponent*>& OldMapIcons);
 	// Returns all icons currently registered.
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	const TArray<UMapIconComponent*>& GetMapIcons() const;
+	// Returns the icon a handle refers to, or null if that icon has unregistered since
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	UMapIconComponent* ResolveMapIconHandle(const FMapIconHandle& Handle) const;
+	// Returns packed render data of all registered icons, indexed the same as GetMapIcons()
+	const FMapIconRenderCache& GetIconRenderCache() const;
+	// Changes whenever icons register, unregister, move or change properties, so that results derived from the render cache can be reused until then
+	uint32 GetIconRenderCacheVersion() const;
+	// Returns the registered icons that have their trail enabled, in no particular order
+	const TArray<UMapIconComponent*>& GetTrailMapIcons() const;
+	// Returns the canvas material stored in a render cache material slot
+	UMaterialInterface* GetIconCanvasMaterial(const uint16 MaterialSlot) const;
+	// Returns the atlas that icon textures are packed in for batched drawing. On first use it is created and the textures of all
+	// registered icons are packed, after which icons pack their textures as they register or change texture.
+	UMapIconAtlas* GetIconAtlas();
+	// Writes an icon's new transform to the render cache and re-buckets it in the spatial grid. Only for internal use.
+	void UpdateMapIconLocation(UMapIconComponent* MapIcon);
+	// Writes an icon's changed properties to the render cache. Only for internal use.
+	void UpdateMapIconProperties(UMapIconComponent* MapIcon);
+
+	// Sets the world size of the spatial grid cells that icons are bucketed in, for categories without their own settings. Rebuilds their grids.
+	// Use cells roughly the size of a typical minimap view: too small and queries visit many cells, too large and cells contain many icons outside the view.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void SetIconGridCellSize(const float NewIconGridCellSize);
+	// Returns the world size of the spatial grid cells that icons are bucketed in, for categories without their own settings
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	float GetIconGridCellSize() const;
+	// Gives an icon category its own culling and clustering settings. Rebuilds that category's grid.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void SetIconCategorySettings(FName IconCategory, const FMapIconCategorySettings& Settings);
+	// Returns the culling and clustering settings used for an icon category
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	FMapIconCategorySettings GetIconCategorySettings(FName IconCategory) const;
+	// Returns the number of icon category buckets. Only for internal use.
+	int32 GetNumIconCategoryBuckets() const;
+	// Returns the settings of the icon category bucket stored in the render cache. Only for internal use.
+	const FMapIconCategorySettings& GetIconCategoryBucketSettings(const uint16 Bucket) const;
+	// Gathers icons that possibly appear in a view, using the spatial grids. Icons within Margin world units outside the view's box are included.
+	// Icons with an enabled objective arrow are always included, since they are shown at the map's edge when outside the view.
+	// Categories that are hidden in the view are skipped as a whole.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void GetIconsOverlappingView(UMapViewComponent* MapView, TArray<UMapIconComponent*>& OutMapIcons, const float Margin = 0.0f) const;
+	// Same as GetIconsOverlappingView, but outputs indices into GetMapIcons() and GetIconRenderCache()
+	void GetIconIndicesOverlappingView(UMapViewComponent* MapView, TArray<int32>& OutIndices, const float Margin = 0.0f) const;
+	// Gathers icons within a distance of a location, measured on the XY plane
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void GetIconsInRadius(const FVector& Center, const float Radius, const FMapIconQueryFilter& Filter, TArray<UMapIconComponent*>& OutMapIcons) const;
+	// Gathers the icons closest to a location, measured on the XY plane, sorted from nearest to farthest. A MaxDistance of zero means no limit.
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void GetNearestIcons(const FVector& Location, const int32 Count, const FMapIconQueryFilter& Filter, TArray<UMapIconComponent*>& OutMapIcons, const float MaxDistance = 0.0f) const;
+	// Gathers icons inside a box on the XY plane, rotated by Yaw degrees around its center
+	UFUNCTION(BlueprintCallable, Category = "Minimap")
+	void GetIconsInBox(const FVector& Center, const FVector2D& Extent, const float Yaw, const FMapIconQueryFilter& Filter, TArray<UMapIconComponent*>& OutMapIcons) const;
+	// Same as GetIconsInRadius, but outputs indices into GetMapIcons() and GetIconRenderCache()
+	void GetIconIndicesInRadius(const FVector2D& Center, const float Radius, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices) const;
+	// Same as GetNearestIcons, but outputs indices into GetMapIcons() and GetIconRenderCache()
+	void GetNearestIconIndices(const FVector2D& Location, const int32 Count, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices, const float MaxDistance = 0.0f) const;
+	// Same as GetIconsInBox, but outputs indices into GetMapIcons() and GetIconRenderCache()
+	void GetIconIndicesInBox(const FVector2D& Center, const FVector2D& Extent, const float Yaw, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices) const;
+	// Returns the largest icon size of all registered icons, in the given unit. Used to determine how far outside a view icons may still be visible.
+	float GetMaxIconSize(const EIconSizeUnit SizeUnit) const;
 
 	// Registers a map background. Only for internal use.
-	void RegisterMapBackground(AMapBackground* MapBackground);
+	FMapRegistryHandle RegisterMapBackground(AMapBackground* MapBackground);
 	// Unregisters a map background. Only for internal use.
-	void UnregisterMapBackground(AMapBackground* MapBackground);
+	void UnregisterMapBackground(const FMapRegistryHandle& Handle);
 	// Returns all map volumes currently registered.
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	const TArray<AMapBackground*>& GetMapBackgrounds() const;
+	// Returns all registered backgrounds sorted back to front on their z-order, with a consistent order among equal z-orders.
+	// Only resorted after backgrounds register, unregister or change their z-order.
+	const TArray<AMapBackground*>& GetMapBackgroundsInDrawOrder();
+	// Called by backgrounds when their z-order changes. Only for internal use.
+	void MarkMapBackgroundDrawOrderDirty();
 	
-	// Registers a map background. Only for internal use.
-	void RegisterMapFog(AMapFog* MapFog);
-	// Unregisters a map background. Only for internal use.
-	void UnregisterMapFog(AMapFog* MapFog);
+	// Registers a map fog. Only for internal use.
+	FMapRegistryHandle RegisterMapFog(AMapFog* MapFog);
+	// Unregisters a map fog. Only for internal use.
+	void UnregisterMapFog(const FMapRegistryHandle& Handle);
 	// Returns all map volumes currently registered.
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	const TArray<AMapFog*>& GetMapFogs() const;
@@ -62,13 +213,51 @@ public:
 	float GetFogRevealedFactor(const FVector& WorldLocation, const bool bRequireCurrentlyRevealing, bool& bIsInsideFogVolume) const;
 	
 	// Registers a map revealer. Only for internal use.
-	void RegisterMapRevealer(UMapRevealerComponent* MapRevealer);
+	FMapRegistryHandle RegisterMapRevealer(UMapRevealerComponent* MapRevealer);
 	// Unregisters a map revealer. Only for internal use.
-	void UnregisterMapRevealer(UMapRevealerComponent* MapRevealer);
+	void UnregisterMapRevealer(const FMapRegistryHandle& Handle);
 	// Returns all map revealers currently registered.
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	const TArray<UMapRevealerComponent*>& GetMapRevealers() const;
 
+	// Registers a map view. Only for internal use.
+	FMapRegistryHandle RegisterMapView(UMapViewComponent* MapView);
+	// Unregisters a map view. Only for internal use.
+	void UnregisterMapView(const FMapRegistryHandle& Handle);
+	// Returns all map views currently registered.
+	UFUNCTION(BlueprintPure, Category = "Minimap")
+	const TArray<UMapViewComponent*>& GetMapViews() const;
+
+private:
+	// Removes an icon whose slot was just freed, by moving the last icon and its render cache entry into its place
+	void RemoveMapIconAt(const int32 Index);
+	// Adds an icon to or removes it from TrailMapIcons in constant time. Does nothing if it already is or isn't listed.
+	void SetMapIconTrailListed(const int32 Index, const bool bListed);
+	// Returns the slot of a canvas material in IconCanvasMaterials, adding it if needed
+	uint16 GetIconCanvasMaterialSlot(UMaterialInterface* Material);
+	// Fires OnMapIconsChanged with the icons registered and unregistered since the last call, if any
+	void BroadcastMapIconsChanged();
+	// Gathers icons within a radius that pass a filter. Returns how many icons were visited, to detect whether all icons were considered.
+	int32 GatherIconIndicesInRadius(const FVector2D& Center, const float Radius, const FMapIconQueryFilter& Filter, TArray<int32>& OutIndices) const;
+	// Calls Visitor for the category bucket of every category that passes a filter
+	void ForEachFilteredIconCategoryBucket(const FMapIconQueryFilter& Filter, TFunctionRef<void(const FMapIconCategoryBucket&)> Visitor) const;
+	// Tests an icon against a filter's tests other than its categories
+	bool PassesIconQueryFilter(const int32 Index, const FMapIconQueryFilter& Filter) const;
+	// Outputs the icons at the given indices
+	void GetMapIconsAtIndices(const TArray<int32>& Indices, TArray<UMapIconComponent*>& OutMapIcons) const;
+	// Returns the index of a category's bucket, adding the bucket if needed
+	uint16 FindOrAddIconCategoryBucket(FName IconCategory);
+	// Places an icon in the grid or objective arrow list of its category bucket, depending on its render cache entry
+	void AddToIconCategoryBucket(const int32 Index);
+	// Removes an icon from its category bucket, if it is in one
+	void RemoveFromIconCategoryBucket(const int32 Index);
+	// Applies a bucket's settings and re-adds its icons
+	void RebuildIconCategoryBucket(const uint16 Bucket);
+	// Packs an icon's textures into the icon atlas and writes their entries to the render cache
+	void WriteIconAtlasEntries(const int32 Index, const UMapIconComponent* MapIcon);
+	// Moves an icon to the back of the z layer of its z-order by writing a new draw key to the render cache
+	void AssignIconDrawKey(const int32 Index);
+
 public:
 	// Event that fires when a new icon registers itself
 	UPROPERTY(BlueprintAssignable, Category = "Minimap")
@@ -76,6 +265,11 @@ public:
 	// Event that fires when an icon unregisters itself
 	UPROPERTY(BlueprintAssignable, Category = "Minimap")
 	FMapIconUnregisteredSignature OnMapIconUnregistered;
+	// Event that fires at most once per frame, at the end of the frame, with all icons that registered and unregistered during
+	// that frame. Icons that registered and unregistered within the same frame are left out. Prefer this over the per-icon
+	// events when reacting to large numbers of icons spawning or dying at once.
+	UPROPERTY(BlueprintAssignable, Category = "Minimap")
+	FMapIconsChangedSignature OnMapIconsChanged;
 	// Event that fires when a new background source registers itself
 	UPROPERTY(BlueprintAssignable, Category = "Minimap")
 	FMapBackgroundRegisteredSignature OnMapBackgroundRegistered;
@@ -94,19 +288,78 @@ public:
 	// Event that fires when a map revealer unregisters itself
 	UPROPERTY(BlueprintAssignable, Category = "Minimap")
 	FMapRevealerUnregisteredSignature OnMapRevealerUnregistered;
+	// Event that fires when a map view registers itself
+	UPROPERTY(BlueprintAssignable, Category = "Minimap")
+	FMapViewRegisteredSignature OnMapViewRegistered;
+	// Event that fires when a map view unregisters itself
+	UPROPERTY(BlueprintAssignable, Category = "Minimap")
+	FMapViewUnregisteredSignature OnMapViewUnregistered;
+
+protected:
+	// World size of the spatial grid cells that icons are bucketed in, for categories without their own settings
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	float IconGridCellSize = 4096.0f;
+	// Culling settings per icon category. Categories not listed here use IconGridCellSize and are never skipped based on zoom.
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	TMap<FName, FMapIconCategorySettings> IconCategorySettings;
+	// Whether the icon textures shipped with the plugin are packed into the icon atlas as soon as it is created
+	UPROPERTY(EditAnywhere, Category = "Minimap")
+	bool bPackPluginIconsIntoAtlas = true;
 
 private:
-	// Registered icons
+	// Registered icons, densely packed. Their order changes when icons unregister.
 	UPROPERTY(Transient)
 	TArray<UMapIconComponent*> MapIcons;
+	// Registered icons with their trail enabled, in no particular order. The render cache keeps each icon's position in this list.
+	UPROPERTY(Transient)
+	TArray<UMapIconComponent*> TrailMapIcons;
+	// Icons registered and unregistered since OnMapIconsChanged last fired
+	UPROPERTY(Transient)
+	TSet<UMapIconComponent*> PendingAddedMapIcons;
+	UPROPERTY(Transient)
+	TSet<UMapIconComponent*> PendingRemovedMapIcons;
+	// Distinct canvas materials used by registered icons. Icons refer to these by slot in the render cache.
+	UPROPERTY(Transient)
+	TArray<UMaterialInterface*> IconCanvasMaterials;
 	// Registered background sources
 	UPROPERTY(Transient)
 	TArray<AMapBackground*> MapBackgrounds;
+	// Registered background sources in draw order, rebuilt on demand when bMapBackgroundDrawOrderDirty is set
+	UPROPERTY(Transient)
+	TArray<AMapBackground*> MapBackgroundsInDrawOrder;
+	bool bMapBackgroundDrawOrderDirty = false;
 	// Registered fog sources
 	UPROPERTY(Transient)
 	TArray<AMapFog*> MapFogs;
-	// Registered icons
+	// Registered revealers
 	UPROPERTY(Transient)
 	TArray<UMapRevealerComponent*> MapRevealers;
+	// Registered views
+	UPROPERTY(Transient)
+	TArray<UMapViewComponent*> MapViews;
+
+	// Map handles to indices in the registries above
+	TMapSlotMap<FMapIconHandle> IconSlots;
+	TMapSlotMap<FMapRegistryHandle> BackgroundSlots;
+	TMapSlotMap<FMapRegistryHandle> FogSlots;
+	TMapSlotMap<FMapRegistryHandle> RevealerSlots;
+	TMapSlotMap<FMapRegistryHandle> ViewSlots;
+
+	// Packed render data of registered icons, indexed the same as MapIcons
+	FMapIconRenderCache IconRenderCache;
+	uint32 IconRenderCacheVersion = 0;
+	// Created by the first renderer that draws from it
+	UPROPERTY(Transient)
+	UMapIconAtlas* IconAtlas = nullptr;
+	// Registered icons per category, so that hidden categories can be skipped without visiting their icons.
+	// Icons refer to these by index in the render cache.
+	TArray<FMapIconCategoryBucket> IconCategoryBuckets;
+	TMap<FName, uint16> IconCategoryBucketIndices;
+	// Distinct icon z-orders in use, ascending. An icon's z layer is its z-order's index in here.
+	TArray<int32> IconZLayers;
+	// Increases every time an icon enters a z layer, which orders icons within their layer
+	uint32 NextIconDrawSequence = 0;
+	// Largest registered icon size per EIconSizeUnit. Only grows, which is conservative for culling.
+	float MaxIconSize[2] = { 0.0f, 0.0f };
 	
 };
@@ -0,0 +1,53 @@
+// Journeyman's Minimap by ZKShao.
+
+#pragma once
+
+#include "Subsystems/WorldSubsystem.h"
+#include "MapTrackerSubsystem.generated.h"
+
+class AGameStateBase;
+class UMapTrackerComponent;
+
+// Called with the map tracker once it exists
+DECLARE_DELEGATE_OneParam(FMapTrackerReadyDelegate, UMapTrackerComponent*);
+
+// Holds on to the world's map tracker, so finding it doesn't require searching the GameState's components every time.
+// The tracker lives on the GameState and thus doesn't exist before the GameState does. Objects that start play before
+// that can ask to be called back once it exists, instead of never being tracked. Every world has its own subsystem,
+// so PIE instances and seamless travel never share a tracker.
+UCLASS()
+class MINIMAPPLUGIN_API UMapTrackerSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Begin USubsystem interface
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// End USubsystem interface
+
+	// Returns the world's map tracker, creating it if needed. Returns null before the GameState exists and on dedicated servers.
+	UMapTrackerComponent* GetMapTracker()
+	{
+		return MapTracker ? MapTracker : FindOrCreateMapTracker();
+	}
+	// Calls back right away if the map tracker exists, or else as soon as the GameState is set. Never calls back on dedicated servers.
+	void CallWhenMapTrackerReady(const FMapTrackerReadyDelegate& Callback);
+	// Forgets a tracker whose GameState is going away. Only for internal use.
+	void NotifyMapTrackerEndPlay(UMapTrackerComponent* EndingMapTracker);
+
+private:
+	UMapTrackerComponent* FindOrCreateMapTracker();
+	void OnGameStateSet(AGameStateBase* GameState);
+	// Connects map objects on actors that began play in a previous world and were carried over by seamless travel
+	void ReconnectTravelledMapObjects(UMapTrackerComponent* Tracker);
+
+	UPROPERTY(Transient)
+	UMapTrackerComponent* MapTracker = nullptr;
+
+	// Callbacks waiting for the GameState to be set
+	TArray<FMapTrackerReadyDelegate> PendingCallbacks;
+	FDelegateHandle GameStateSetHandle;
+
+};
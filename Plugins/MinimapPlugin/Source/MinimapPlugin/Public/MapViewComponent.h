@@ -4,6 +4,8 @@
 
 #include "Components/BoxComponent.h"
 #include "MapEnums.h"
+#include "MapSlotMap.h"
+#include "MapIconCulling.h"
 #include "MapViewComponent.generated.h"
 
 // MapViewComponent event signatures
@@ -13,6 +15,7 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FMapViewDestroyedSignature, UMapView
 
 class UMapIconComponent;
 class AMapBackground;
+class UMapTrackerComponent;
 
 // Represents a world area to render to a map, in terms of a location, rotation and XY view size.
 // Add this to any character or other actor which serves as a center point for a map or minimap. 
@@ -69,6 +72,8 @@ public:
 	// Convert world position to view position, where the boundaries represented by view size correspond to 0.0 and 1.0
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
 	bool GetViewCoordinates(const FVector& WorldPos, bool bForceRectangular, float& U, float& V);
+	// Copies the view's transform, for view tests and conversions on other threads
+	void GetViewSnapshot(FMapViewSnapshot& OutSnapshot);
 	// Convert world yaw to view yaw
 	UFUNCTION(BlueprintCallable, Category = "Minimap")
 	void GetViewYaw(const float WorldYaw, float& Yaw);
@@ -85,6 +90,14 @@ public:
 	// Computes whether an icon is considered on the same level, to be rendered
 	UFUNCTION(BlueprintPure, Category = "Minimap")
 	bool IsSameBackgroundLevel(const UMapIconComponent* MapIcon);
+	// Same as above, for an icon at a location with a background interaction. Used by renderers reading the icon render cache.
+	bool IsSameBackgroundLevel(const FVector& MapIconPos, const EIconBackgroundInteraction BackgroundInteraction);
+
+	// Registers the view with the tracker and follows its multi-level backgrounds, unless already registered or play has ended. Only for internal use.
+	void RegisterWithMapTracker(UMapTrackerComponent* Tracker);
+	// Culls the tracker's icons for this view and sorts the visible ones back to front. Renderers of the same view share the results
+	// within a frame as long as they cover the renderer's icon sizes in world units, given by WorldToPixelRatio. Only for internal use.
+	const FMapViewIconCulling& CullIcons(UMapTrackerComponent* Tracker, const float DPIScale, const float WorldToPixelRatio, const bool bParallel);
 
 private:
 	UFUNCTION()
@@ -98,6 +111,8 @@ private:
 	void UpdateTransformCache();
 	// Recomputes the map view's height level on all tracked multi level backgrounds
 	void UpdateBackgroundCache();
+	// Takes snapshots of the fogs that culling the candidates needs to sample
+	void GatherFogSnapshots(UMapTrackerComponent* Tracker, TArray<FMapFogSnapshot>& OutFogs);
 	
 public:
 	// Event that fires when visible icon categories change
@@ -132,6 +147,12 @@ public:
 	float BackgoundLevelCacheLifetime = 0.05f;
 	
 private:
+	// The tracker this view registered itself to
+	UPROPERTY(Transient)
+	UMapTrackerComponent* MapTracker = nullptr;
+	// Handle in the tracker's view registry, used to unregister
+	FMapRegistryHandle TrackerHandle;
+
 	// Precomputed values to efficiently perform transformations which potentially are done many times per rendered frame,
 	// such as transforming world coordinates to minimap coordinates. These precomputed values are updated when a change in 
 	// view transformation is detected.
@@ -157,5 +178,8 @@ private:
 	TMap<AMapBackground*, int32> PositionOnMultiLevelBackgrounds;
 
 	TSet<FName> HiddenIconCategories;
+
+	// Icons culled for this view during the last frame that a renderer drew it
+	FMapViewIconCulling IconCulling;
 	
 };
@@ -3,8 +3,10 @@
 #pragma once
 
 #include "Modules/ModuleManager.h"
+#include "Stats/Stats.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(MinimapLog, Log, All);
+DECLARE_STATS_GROUP(TEXT("Minimap"), STATGROUP_Minimap, STATCAT_Advanced);
 
 class IMinimapPlugin : public IModuleInterface
 {